@@ -44,9 +44,11 @@ engine.tick:bind(function(dt)
         cam:moveUp(moveSpeed * dt)
     end
 
+    -- The camera goes on the global material, shaders read it from the per-frame uniform block
+    cam:use()
+
     local params = Material.new()
     params:setMatrix4("transform", math.scale{0.002, 0.002, 0.002})
-    cam:use(params)
 
     obj:draw(params)
 end)
@@ -5,8 +5,12 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+};
+
 uniform mat4 transform;
 
 out vec3 outNormal;
@@ -49,8 +53,6 @@ material:setVec3('lightColor', {1, 1, 1})
 material:setVec3('lightDirection', {1, -1, 0.6})
 material:setFloat('lightAmbience', 0.8)
 material:setFloat('minBrightness', 0.15)
-material:setMatrix4('projection', Matrix4x4.new())
-material:setMatrix4('view', Matrix4x4.new())
 material:setMatrix4('transform', Matrix4x4.new())
 
 return material
\ No newline at end of file
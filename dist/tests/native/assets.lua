@@ -31,6 +31,91 @@ test.test('loadModel', function()
     end
 end)
 
+test.test('loadModel materials', function()
+    local model = assets.loadModel('assets/models/teapot.obj')
+    test.assert_not_equal(model, nil)
+    test.expect(model:getMaterialCount() > 0)
+
+    for _,component in ipairs(model:getMeshes()) do
+        test.expect_not_equal(model:getMaterial(component.materialIndex + 1), nil)
+    end
+end)
+
+test.test('optimizeModel', function()
+    local model = assets.loadModel('assets/models/teapot.obj', { optimize = false })
+    test.assert_not_equal(model, nil)
+
+    local stats = assets.optimizeModel(model)
+    test.expect(stats.triangleCount > 0)
+    test.expect(stats.vertexCountAfter <= stats.vertexCountBefore)
+    test.expect(stats.acmrAfter <= stats.acmrBefore)
+    test.expect(stats.acmrAfter < 1.5)
+
+    local total = 0
+    for _,component in ipairs(model:getMeshes()) do
+        total = total + #component.mesh:getIndices() / 3
+    end
+    test.expect_equal(total, stats.triangleCount)
+
+    -- Already optimized meshes don't get any worse
+    local again = assets.optimizeModel(model)
+    test.expect_equal(again.vertexCountBefore, again.vertexCountAfter)
+    test.expect(again.acmrAfter <= stats.acmrAfter + 0.05)
+end)
+
+test.test('generateLods', function()
+    local model = assets.loadModel('assets/models/teapot.obj')
+    test.assert_not_equal(model, nil)
+    test.expect(assets.generateLods(model) > 0)
+
+    local mesh = model:getMeshes()[1].mesh
+    test.assert(mesh:getLodCount() > 1)
+    test.expect_equal(mesh:getLodError(0), 0)
+    test.expect_equal(mesh:getLodIndexCount(0), mesh:getIndexCount())
+    for level = 1, mesh:getLodCount() - 1 do
+        test.expect(mesh:getLodIndexCount(level) < mesh:getLodIndexCount(level - 1))
+        test.expect(mesh:getLodError(level) >= mesh:getLodError(level - 1))
+    end
+
+    assets.saveModel('assets/models/test.wmdl', model, true)
+    for _,lazy in ipairs({ false, true }) do
+        local mesh2 = assets.loadModel('assets/models/test.wmdl', lazy):getMeshes()[1].mesh
+        test.expect_equal(mesh2:getLodCount(), mesh:getLodCount())
+        for level = 1, mesh:getLodCount() - 1 do
+            test.expect_equal(mesh2:getLodIndexCount(level), mesh:getLodIndexCount(level))
+            test.expect_equal(mesh2:getLodError(level), mesh:getLodError(level))
+        end
+    end
+
+    -- Changing the mesh drops levels that no longer match it
+    mesh:setIndices(mesh:getIndices())
+    test.expect_equal(mesh:getLodCount(), 1)
+end)
+
+test.test('buildMeshlets', function()
+    local model = assets.loadModel('assets/models/teapot.obj')
+    test.assert_not_equal(model, nil)
+
+    local mesh = model:getMeshes()[1].mesh
+    local indexCount = mesh:getIndexCount()
+    test.expect(assets.buildMeshlets(model) > 0)
+    test.expect(mesh:getMeshletCount() >= indexCount / 3 / 124)
+    test.expect_equal(mesh:getIndexCount(), indexCount)
+
+    assets.saveModel('assets/models/test.wmdl', model, true)
+    for _,lazy in ipairs({ false, true }) do
+        local mesh2 = assets.loadModel('assets/models/test.wmdl', lazy):getMeshes()[1].mesh
+        test.expect_equal(mesh2:getMeshletCount(), mesh:getMeshletCount())
+    end
+
+    test.expect_equal(model:getMeshletCulling(), true)
+    model:setMeshletCulling(false)
+    test.expect_equal(model:getMeshletCulling(), false)
+
+    mesh:setIndices(mesh:getIndices())
+    test.expect_equal(mesh:getMeshletCount(), 0)
+end)
+
 test.test('saveModel', function()
     local model = assets.loadModel('assets/models/teapot.obj')
     test.assert_not_equal(model, nil)
@@ -44,6 +129,278 @@ test.test('saveModel', function()
     model2 = assets.loadModel('assets/models/test.wmdl')
 
     test.expect_equal(model:getMeshCount(), model2:getMeshCount())
+
+    assets.saveModel('assets/models/test.wmdl', model, { compress = true, shuffle = false })
+    model2 = assets.loadModel('assets/models/test.wmdl')
+
+    test.expect_equal(model:getMeshCount(), model2:getMeshCount())
+end)
+
+test.test('saveModel quantized', function()
+    local model = assets.loadModel('assets/models/teapot.obj')
+    test.assert_not_equal(model, nil)
+
+    local err = assets.getQuantizationError(model)
+    test.expect(err.position < 0.01)
+    test.expect(err.normal < 0.1)
+
+    local mesh = model:getMeshes()[1].mesh
+    test.expect_equal(mesh:getVertexFormat(), 'float')
+    mesh:setVertexFormat('packed')
+
+    assets.saveModel('assets/models/test.wmdl', model, { quantize = true })
+    local model2 = assets.loadModel('assets/models/test.wmdl')
+    test.assert_not_equal(model2, nil)
+
+    test.expect_equal(model:getMeshCount(), model2:getMeshCount())
+    test.expect_equal(model2:getMeshes()[1].mesh:getVertexFormat(), 'packed')
+    test.expect_equal(#model2:getMeshes()[1].mesh:getVertices(), #mesh:getVertices())
+end)
+
+test.test('loadModel lazy', function()
+    local model = assets.loadModel('assets/models/teapot.obj')
+    test.assert_not_equal(model, nil)
+
+    assets.saveModel('assets/models/test.wmdl', model, true)
+    local lazy = assets.loadModel('assets/models/test.wmdl', true)
+    test.assert_not_equal(lazy, nil)
+
+    test.expect_equal(lazy:getMeshCount(), model:getMeshCount())
+    local components = model:getMeshes()
+    local lazyComponents = lazy:getMeshes()
+    for i,component in ipairs(lazyComponents) do
+        local mesh = component.mesh
+        test.expect_equal(mesh:isLoaded(), false)
+        test.expect_equal(mesh:getVertexCount(), #components[i].mesh:getVertices())
+        test.expect_equal(mesh:getIndexCount(), #components[i].mesh:getIndices())
+        test.expect_equal(#mesh:getIndices(), #components[i].mesh:getIndices())
+        test.expect_equal(mesh:isLoaded(), true)
+    end
+end)
+
+test.test('loadModel lazy failure', function()
+    local model = assets.loadModel('assets/models/cube.obj')
+    test.assert_not_equal(model, nil)
+    local mesh = model:getMeshes()[1].mesh
+    assets.saveModel('assets/models/damaged.wmdl', model, false)
+
+    local function uint32(n)
+        return string.char(n % 256, math.floor(n / 256) % 256, math.floor(n / 65536) % 256,
+                           math.floor(n / 16777216) % 256)
+    end
+
+    -- The mesh's data starts with its vertex and index counts, after the table that has them as well
+    local f = io.open('assets/models/damaged.wmdl', 'rb')
+    local data = f:read('*a')
+    f:close()
+
+    local counts = uint32(mesh:getVertexCount()) .. uint32(mesh:getIndexCount())
+    local at = data:find(counts, 1, true)
+    while at ~= nil and data:find(counts, at + 1, true) ~= nil do
+        at = data:find(counts, at + 1, true)
+    end
+    test.assert_not_equal(at, nil)
+
+    f = io.open('assets/models/damaged.wmdl', 'wb')
+    f:write(data:sub(1, at + 3) .. uint32(mesh:getIndexCount() + 1) .. data:sub(at + 8))
+    f:close()
+
+    -- The damage only shows once the mesh is loaded, which leaves it empty
+    local lazy = assets.loadModel('assets/models/damaged.wmdl', true)
+    test.assert_not_equal(lazy, nil)
+
+    local lazyMesh = lazy:getMeshes()[1].mesh
+    test.expect_equal(lazyMesh:getVertexCount(), mesh:getVertexCount())
+    test.expect_equal(lazyMesh:hasLoadFailed(), false)
+    lazyMesh:load()
+    test.expect_equal(lazyMesh:isLoaded(), true)
+    test.expect_equal(lazyMesh:hasLoadFailed(), true)
+    test.expect_equal(lazyMesh:getVertexCount(), 0)
+    os.remove('assets/models/damaged.wmdl')
+end)
+
+test.test('bounds', function()
+    local model = assets.loadModel('assets/models/teapot.obj')
+    test.assert_not_equal(model, nil)
+
+    local bounds = model:getBounds()
+    test.assert_not_equal(bounds, nil)
+    for _,component in ipairs(model:getMeshes()) do
+        local meshBounds = component.mesh:getBounds()
+        for i = 1, 3 do
+            test.expect(meshBounds.min:get(i) >= bounds.min:get(i))
+            test.expect(meshBounds.max:get(i) <= bounds.max:get(i))
+        end
+        test.expect(meshBounds.radius <= bounds.radius)
+    end
+
+    -- Lazily loaded meshes know their bounds without being loaded
+    assets.saveModel('assets/models/test.wmdl', model, true)
+    local lazy = assets.loadModel('assets/models/test.wmdl', true)
+    local lazyBounds = lazy:getBounds()
+    test.expect_equal(lazyBounds.min, bounds.min)
+    test.expect_equal(lazyBounds.max, bounds.max)
+    test.expect_num_equal(lazyBounds.radius, bounds.radius, 0.00001)
+    for _,component in ipairs(lazy:getMeshes()) do
+        test.expect_equal(component.mesh:isLoaded(), false)
+    end
+end)
+
+test.test('loadModelAsync', function()
+    local request = assets.loadModelAsync('assets/models/teapot.wmdl')
+    test.assert_not_equal(request, nil)
+    test.expect_equal(request:getPath(), 'assets/models/teapot.wmdl')
+
+    local model = request:wait()
+    test.assert_not_equal(model, nil)
+    test.expect_equal(request:getStatus(), 'ready')
+    test.expect_equal(request:isDone(), true)
+    test.expect_equal(model:getMeshCount(), 2)
+    test.expect_equal(request:getModel():getMeshCount(), 2)
+
+    local missing = assets.loadModelAsync('assets/models/missing.wmdl')
+    test.expect_equal(missing:wait(), nil)
+    test.expect_equal(missing:getStatus(), 'failed')
+end)
+
+test.test('loadModelAsync options', function()
+    local expected = assets.loadModel('assets/models/teapot.obj', { optimize = false })
+    local model = assets.loadModelAsync('assets/models/teapot.obj', { optimize = false }):wait()
+    test.assert_not_equal(model, nil)
+    test.expect_equal(model:getMeshCount(), expected:getMeshCount())
+    for i,component in ipairs(model:getMeshes()) do
+        test.expect_equal(#component.mesh:getVertices(), #expected:getMeshes()[i].mesh:getVertices())
+    end
+
+    local lazy = assets.loadModelAsync('assets/models/teapot.wmdl', { lazy = true }):wait()
+    test.assert_not_equal(lazy, nil)
+    for _,component in ipairs(lazy:getMeshes()) do
+        test.expect_equal(component.mesh:isLoaded(), false)
+    end
+end)
+
+test.test('loadModelAsync reads', function()
+    assets.prefetch({ 'assets/models/teapot.wmdl', 'assets/models/cube.wmdl' })
+
+    local stats = assets.getFileSystemStats()
+    local first = assets.loadModelAsync('assets/models/teapot.wmdl')
+    local second = assets.loadModelAsync('assets/models/teapot.wmdl')
+    test.assert_not_equal(first:wait(), nil)
+    test.assert_not_equal(second:wait(), nil)
+
+    -- The files are read ahead of the loads, which then pick those reads up instead of reading them again
+    local after = assets.getFileSystemStats()
+    test.expect(after.requests >= stats.requests + 4)
+    test.expect(after.coalesced >= stats.coalesced + 2)
+    test.expect(after.bytesRead > stats.bytesRead)
+end)
+
+test.test('prefetch manifest', function()
+    assets.startPrefetchRecording()
+    test.assert_not_equal(assets.loadModel('assets/models/cube.wmdl'), nil)
+    test.assert_not_equal(assets.loadModel('assets/models/teapot.wmdl'), nil)
+    test.assert_not_equal(assets.loadModel('assets/models/cube.wmdl'), nil)
+    test.assert(assets.stopPrefetchRecording('assets/test.prefetch'))
+
+    local lines = {}
+    for line in io.lines('assets/test.prefetch') do
+        table.insert(lines, line)
+    end
+
+    -- Every file once, in the order it was first read (textures the models use may be in there too)
+    test.expect_equal(lines[1], 'wake-prefetch 1')
+    local cube, teapot
+    for i = 2, #lines do
+        if lines[i]:find('assets/models/cube.wmdl', 1, true) then
+            test.expect_equal(cube, nil)
+            cube = i
+        elseif lines[i]:find('assets/models/teapot.wmdl', 1, true) then
+            test.expect_equal(teapot, nil)
+            teapot = i
+        end
+    end
+    test.assert(cube ~= nil and teapot ~= nil)
+    test.expect(cube < teapot)
+
+    test.expect_equal(assets.replayPrefetch('assets/test.prefetch'), #lines - 1)
+    test.expect_equal(assets.replayPrefetch('assets/missing.prefetch'), 0)
+    os.remove('assets/test.prefetch')
+end)
+
+test.test('saveModel embedded textures', function()
+    local model = assets.loadModel('assets/models/teapot.obj')
+    test.assert_not_equal(model, nil)
+
+    local texture = assets.loadTexture('assets/textures/default.png')
+    test.assert_not_equal(texture, nil)
+    test.expect_equal(texture:getLevelCount(), 1)
+    model:getMaterial(1).material:setTexture('diffuse', texture)
+
+    assets.saveModel('assets/models/test.wmdl', model, { embedTextures = true })
+    local model2 = assets.loadModel('assets/models/test.wmdl')
+    test.assert_not_equal(model2, nil)
+
+    local embedded = model2:getMaterial(1).material:getTexture('diffuse')
+    test.assert_not_equal(embedded, nil)
+
+    local w, h = embedded:getSize()
+    test.expect_equal(w, 128)
+    test.expect_equal(h, 128)
+    test.expect_equal(embedded:getLevelCount(), 8)
+    test.expect_equal(embedded:getPath(), 'assets/textures/default.png')
+    os.remove('assets/models/test.wmdl')
+end)
+
+test.test('cook', function()
+    local f = io.open('assets/cook_test.txt', 'w')
+    f:write('models/cube.obj\nmodels/teapot.wmdl\n')
+    f:close()
+
+    local summary = assets.cook('assets/cook_test.txt', 'assets/cook_test', { force = true })
+    test.expect_equal(summary.inputCount, 2)
+    test.expect_equal(summary.failedCount, 0)
+    test.expect_equal(summary.cookedCount, 2)
+    test.expect(summary.bytesWritten > 0)
+
+    local model = assets.loadModel('assets/cook_test/models/teapot.wmdl')
+    test.assert_not_equal(model, nil)
+    test.expect_equal(model:getMeshCount(), 2)
+    test.expect_not_equal(assets.loadModel('assets/cook_test/models/cube.obj.wmdl'), nil)
+
+    -- Nothing changed, so everything comes from the cache the second time
+    local again = assets.cook('assets/cook_test.txt', 'assets/cook_test')
+    test.expect_equal(again.inputCount, 2)
+    test.expect_equal(again.cachedCount, 2)
+    test.expect_equal(again.cookedCount, 0)
+
+    os.remove('assets/cook_test.txt')
+    os.remove('assets/cook_test/models/cube.obj.wmdl')
+    os.remove('assets/cook_test/models/teapot.wmdl')
+    os.remove('assets/cook_test/models')
+    os.remove('assets/cook_test/.cookcache')
+    os.remove('assets/cook_test')
+end)
+
+test.test('cook output collisions', function()
+    local f = io.open('assets/cook_collisions.txt', 'w')
+    f:write('models/cube.obj\nmodels/cube.wmdl\nmodels/teapot.obj\nmodels/./teapot.obj\n')
+    f:close()
+
+    local summary = assets.cook('assets/cook_collisions.txt', 'assets/cook_collisions')
+    os.remove('assets/cook_collisions.txt')
+
+    -- cube.obj keeps its extension so it doesn't overwrite cube.wmdl, but the teapot listed twice isn't cooked at all
+    test.expect_equal(summary.cookedCount, 2)
+    test.expect_equal(summary.failedCount, 2)
+    test.expect_equal(summary.failed[1], 'models/teapot.obj')
+    test.expect_not_equal(assets.loadModel('assets/cook_collisions/models/cube.obj.wmdl'), nil)
+    test.expect_not_equal(assets.loadModel('assets/cook_collisions/models/cube.wmdl'), nil)
+
+    os.remove('assets/cook_collisions/models/cube.obj.wmdl')
+    os.remove('assets/cook_collisions/models/cube.wmdl')
+    os.remove('assets/cook_collisions/models')
+    os.remove('assets/cook_collisions/.cookcache')
+    os.remove('assets/cook_collisions')
 end)
 
 test.test('loadTexture', function()
@@ -54,13 +411,56 @@ test.test('loadTexture', function()
     test.expect_equal(w, 128)
     test.expect_equal(h, 128)
     test.expect_equal(texture:getComponentsPerPixel(), 4)
+    test.expect_equal(texture:getLevelCount(), 1)
     test.expect_equal(texture:getPath(), 'assets/textures/default.png')
     test.expect_equal(tostring(texture), 'Texture[128,128,4]')
 
+    local stats = assets.getTextureCacheStats()
+    local again = assets.loadTexture('./assets//textures/default.png')
+    test.assert_not_equal(again, nil)
+    test.expect_equal(assets.getTextureCacheStats().hits, stats.hits + 1)
+    test.expect_equal(assets.getTextureCacheStats().misses, stats.misses)
+
     local c = Texture.new(texture)
     test.expect_equal(w, 128)
     test.expect_equal(h, 128)
     test.expect_equal(texture:getComponentsPerPixel(), 4)
     test.expect_equal(texture:getPath(), 'assets/textures/default.png')
     test.expect_equal(tostring(texture), 'Texture[128,128,4]')
-end)
\ No newline at end of file
+end)
+
+test.test('packArchive', function()
+    local model = assets.loadModel('assets/models/cube.obj')
+    test.assert_not_equal(model, nil)
+    assets.saveModel('assets/models/test.wmdl', model, true)
+
+    local f = io.open('assets/test_module.lua', 'w')
+    f:write('return 42\n')
+    f:close()
+
+    f = io.open('assets/test_archive.txt', 'w')
+    f:write('models/test.wmdl\n# comment\ntest_module.lua\n')
+    f:close()
+
+    test.assert(assets.packArchive('assets/test_archive.txt', 'assets/test.warc', { prefix = 'assets' }))
+    os.remove('assets/models/test.wmdl')
+    os.remove('assets/test_module.lua')
+    os.remove('assets/test_archive.txt')
+
+    test.assert(assets.mountArchive('assets/test.warc'))
+    local packed = assets.loadModel('assets/models/test.wmdl', true)
+    test.assert_not_equal(packed, nil)
+    test.expect_equal(packed:getMeshCount(), model:getMeshCount())
+
+    local path = package.path
+    package.path = 'assets/?.lua'
+    test.expect_equal(require('test_module'), 42)
+    package.path = path
+    package.loaded['test_module'] = nil
+
+    -- Lazily loaded meshes keep reading from the archive after it is unmounted
+    assets.unmountArchives()
+    test.expect_equal(#packed:getMeshes()[1].mesh:getIndices(), #model:getMeshes()[1].mesh:getIndices())
+    test.expect_equal(assets.loadModel('assets/models/test.wmdl'), nil)
+    os.remove('assets/test.warc')
+end)
@@ -1,6 +1,13 @@
 local test = require('test')
 local Material = Material
 local assets = assets
+local engine = engine
+local Mesh = Mesh
+local Model = Model
+local Shader = Shader
+local Vertex = Vertex
+local ipairs = ipairs
+local math = math
 
 test.suite('Material Library')
 
@@ -44,4 +51,146 @@ end)
 
 test.test('global', function()
     test.expect_not_equal(Material.getGlobal(), nil)
-end)
\ No newline at end of file
+end)
+
+test.test('render queue', function()
+    local lighting = require('materials.demo_lighting')
+    local tinted = lighting:clone()
+    tinted:setVec3('lightColor', {1, 0, 0})
+    local other = Material.new()
+    other:setShader(Shader.new('', ''))
+
+    local mesh = Mesh.new({Vertex.new{0, 0, 0}, Vertex.new{1, 0, 0}, Vertex.new{0, 1, 0}}, {0, 1, 2})
+    local model = Model.new()
+    model:addMaterial('lighting', lighting)
+    model:addMaterial('other', other)
+    model:addMaterial('tinted', tinted)
+    for _, index in ipairs{1, 2, 3, 1, 2} do
+        model:addMesh(mesh, index)
+    end
+
+    engine.flushDraws()
+    engine.resetRenderStats()
+    model:draw()
+    model:draw()
+    engine.flushDraws()
+
+    local stats = engine.getRenderStats()
+    test.expect_equal(stats.draws, 10)
+    test.expect_equal(stats.shaderChanges, 2)
+    test.expect_equal(stats.textureChanges, 2)
+    test.expect_equal(stats.batches, 3)
+    test.expect_equal(stats.stateChanges, 7)
+
+    engine.resetRenderStats()
+    engine.flushDraws()
+    test.expect_equal(engine.getRenderStats().draws, 0)
+end)
+
+test.test('render queue parameters', function()
+    local shared = Material.new()
+    shared:setShader(Shader.new('', ''))
+    shared:setVec3('tint', {1, 1, 1})
+
+    local mesh = Mesh.new({Vertex.new{0, 0, 0}, Vertex.new{1, 0, 0}, Vertex.new{0, 1, 0}}, {0, 1, 2})
+    local first = Model.new()
+    first:addMaterial('shared', shared)
+    first:addMesh(mesh, 1)
+    local second = Model.new()
+    second:addMaterial('shared', shared)
+    second:addMesh(mesh, 1)
+
+    local plain = Material.new()
+    local tinted = Material.new()
+    tinted:setVec3('tint', {1, 0, 0})
+
+    -- The second model doesn't set the tint, so the material's own is set again instead of keeping the first's
+    engine.flushDraws()
+    engine.resetRenderStats()
+    first:draw(tinted)
+    second:draw(plain)
+    engine.flushDraws()
+    test.expect_equal(engine.getRenderStats().draws, 2)
+    test.expect_equal(engine.getRenderStats().batches, 2)
+
+    engine.resetRenderStats()
+    first:draw(plain)
+    second:draw(tinted)
+    engine.flushDraws()
+    test.expect_equal(engine.getRenderStats().batches, 1)
+end)
+
+test.test('render queue global changes', function()
+    local material = Material.new()
+    material:setShader(Shader.new('', ''))
+
+    local model = Model.new()
+    model:addMaterial('material', material)
+    model:addMesh(Mesh.new({Vertex.new{0, 0, 0}, Vertex.new{1, 0, 0}, Vertex.new{0, 1, 0}}, {0, 1, 2}), 1)
+
+    local global = Material.getGlobal()
+    engine.flushDraws()
+    engine.resetRenderStats()
+    local uploads = engine.getRenderStats().frameUploads
+
+    -- Changing the view draws the first model with the old one before the second is queued with the new one
+    global:setMatrix4('view', math.scale{2, 2, 2})
+    model:draw()
+    global:setMatrix4('view', math.scale{3, 3, 3})
+    test.expect_equal(engine.getRenderStats().draws, 1)
+    model:draw()
+    engine.flushDraws()
+
+    -- Both flushes count towards the stats
+    test.expect_equal(engine.getRenderStats().draws, 2)
+    test.expect_equal(engine.getRenderStats().frameUploads, uploads + 2)
+    global:removeParameter('view')
+end)
+
+test.test('redundant binds', function()
+    local shader = Shader.new('', '')
+    Shader.reset()
+    local stats = engine.getGLStats()
+
+    -- Shaders don't compile outside of the normal engine mode, so this is the program reset() just made current
+    shader:use()
+    shader:use()
+    test.expect_equal(engine.getGLStats().issued, stats.issued)
+    test.expect_equal(engine.getGLStats().skipped, stats.skipped + 2)
+end)
+
+test.test('frame uniforms', function()
+    local global = Material.getGlobal()
+    global:setMatrix4('view', math.scale{2, 3, 4})
+    engine.flushDraws()
+    local uploads = engine.getRenderStats().frameUploads
+
+    -- Nothing changed, so the buffer isn't uploaded again
+    engine.flushDraws()
+    test.expect_equal(engine.getRenderStats().frameUploads, uploads)
+
+    global:setMatrix4('view', math.scale{4, 3, 2})
+    engine.flushDraws()
+    test.expect_equal(engine.getRenderStats().frameUploads, uploads + 1)
+
+    global:removeParameter('view')
+end)
+
+test.test('parameter storage', function()
+    local mat = Material.new()
+    mat:setFloat('b', 1.5)
+    mat:setInt('a', 2)
+    mat:setFloat('c', 3.5)
+
+    -- Changing the type of a parameter moves it, the others keep their values
+    mat:setFloat('a', 4.5)
+    mat:removeParameter('b')
+    test.expect_equal(mat:getParameterCount(), 2)
+    test.expect_equal(mat:getParameter('a'), 4.5)
+    test.expect_equal(mat:getParameter('b'), nil)
+    test.expect_equal(mat:getParameter('c'), 3.5)
+
+    local parameters = mat:getParameters()
+    test.expect_equal(parameters.a, 4.5)
+    test.expect_equal(parameters.c, 3.5)
+end)
@@ -1,6 +1,7 @@
 local test = require('test')
 local Vertex = Vertex
 local Mesh = Mesh
+local Vector3 = Vector3
 local tostring = tostring
 
 test.suite('Mesh Library')
@@ -75,6 +76,24 @@ test.test('setters', function()
     test.expect_equal(m:getIndices()[3], 3)
 end)
 
+test.test('bounds', function()
+    local m = Mesh.new()
+    test.expect_equal(m:getBounds(), nil)
+
+    m = Mesh.new{Vertex.new{1, 2, 3}, Vertex.new{-1, 6, 3}, Vertex.new{0, 4, -1}}
+    local bounds = m:getBounds()
+    test.assert_not_equal(bounds, nil)
+    test.expect_equal(bounds.min, Vector3.new(-1, 2, -1))
+    test.expect_equal(bounds.max, Vector3.new(1, 6, 3))
+    test.expect_equal(bounds.center, Vector3.new(0, 4, 1))
+    test.expect_num_equal(bounds.radius, 3, 0.00001)
+
+    m:setVertices{Vertex.new{0, 0, 0}, Vertex.new{0, 0, 2}}
+    bounds = m:getBounds()
+    test.expect_equal(bounds.center, Vector3.new(0, 0, 1))
+    test.expect_num_equal(bounds.radius, 1, 0.00001)
+end)
+
 test.test('tostring', function()
     local m = Mesh.new({Vertex.new{1, 2, 3}, Vertex.new{4, 5, 6}}, {1, 2, 3})
     test.expect_equal(tostring(m), "Mesh[2,3]")
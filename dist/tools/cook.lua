@@ -0,0 +1,61 @@
+function hook_engine_tool()
+    local args = wake.getArguments()
+    if #args < 2 or #args > 5 then
+        print("Usage: cook <input_directory_or_manifest> <output_directory> [force=false] [quantize=false] " ..
+              "[meshlets=false]")
+        print("Description: Converts every model in a directory, or listed in a manifest file, into the")
+        print("             wake model format at the same relative path in the output directory, with")
+        print("             .wmdl added to the names of models in other formats.")
+        print("             Models are converted in parallel, optimized, given levels of detail,")
+        print("             compressed, and have their textures embedded.")
+        print()
+        print("             A manifest lists one path per line, relative to the manifest.")
+        print()
+        print("             Models that haven't changed since they were last cooked, along with the")
+        print("             textures they use, are skipped. force cooks everything again.")
+        print()
+        print("             quantize stores vertices in a lossy format about half the size.")
+        print()
+        print("             meshlets splits meshes into small clusters of triangles that are culled")
+        print("             individually.")
+        return false
+    end
+
+    local force = false
+    if #args >= 3 then
+        force = args[3] == "true"
+    end
+
+    local quantize = false
+    if #args >= 4 then
+        quantize = args[4] == "true"
+    end
+
+    local meshlets = false
+    if #args >= 5 then
+        meshlets = args[5] == "true"
+    end
+
+    print("Cooking " .. args[1] .. " into " .. args[2])
+    local summary = assets.cook(args[1], args[2], {
+        force = force,
+        quantize = quantize,
+        meshlets = meshlets
+    })
+
+    for _, path in ipairs(summary.failed) do
+        print("Unable to cook " .. path)
+    end
+
+    local megabytes = summary.bytesRead / (1024 * 1024)
+    print("Cooked " .. summary.cookedCount .. " of " .. summary.inputCount .. " models, " ..
+          summary.cachedCount .. " up to date, " .. summary.failedCount .. " failed")
+    print(string.format("\tTime: %.2f s", summary.seconds))
+    print(string.format("\tRead: %.2f MB, written: %.2f MB", megabytes, summary.bytesWritten / (1024 * 1024)))
+    if summary.seconds > 0 then
+        print(string.format("\tThroughput: %.2f MB/s, %.1f models/s", megabytes / summary.seconds,
+                            summary.cookedCount / summary.seconds))
+    end
+
+    return summary.failedCount == 0
+end
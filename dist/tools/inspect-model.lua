@@ -9,7 +9,8 @@ function hook_engine_tool()
     local inputPath = args[1]
 
     print("Loading input from " .. inputPath)
-    local input = assets.loadModel(inputPath)
+    -- Only the counts are needed, so don't bother reading any geometry
+    local input = assets.loadModel(inputPath, true)
     if input == nil then
         print("Unable to load input model.")
         return false
@@ -41,8 +42,8 @@ function hook_engine_tool()
     for _, c in ipairs(meshes) do
         local mesh = c.mesh
         if mesh ~= nil then
-            indices = indices + #mesh:getIndices()
-            vertices = vertices + #mesh:getVertices()
+            indices = indices + mesh:getIndexCount()
+            vertices = vertices + mesh:getVertexCount()
         end
     end
 
@@ -62,7 +62,8 @@ function hook_engine_tool()
     local input_model = args[1]
     local command = args[2]
 
-    local model = assets.loadModel(input_model)
+    -- Mesh data is only read back in when the model is saved
+    local model = assets.loadModel(input_model, true)
     if model == nil then
         print("Unable to load model.")
         return false
@@ -0,0 +1,32 @@
+function hook_engine_tool()
+    local args = wake.getArguments()
+    if #args < 2 or #args > 4 then
+        print("Usage: pack <input_directory_or_manifest> <output_archive> [prefix=] [compile_scripts=true]")
+        print("Description: Packs every file in a directory, or listed in a manifest file, into a single")
+        print("             archive for shipped builds. Run the engine with --archive <output_archive>")
+        print("             to load models, textures and scripts out of it instead of the file system.")
+        print()
+        print("             Files are stored under their path relative to the directory or manifest,")
+        print("             with prefix in front of it.")
+        print()
+        print("             compile_scripts stores Lua scripts precompiled, so they aren't parsed")
+        print("             at startup. The archive then only works with the same engine build.")
+        return false
+    end
+
+    local prefix = ''
+    if #args >= 3 then
+        prefix = args[3]
+    end
+
+    local compileScripts = true
+    if #args >= 4 then
+        compileScripts = args[4] == "true"
+    end
+
+    print("Packing " .. args[1] .. " into " .. args[2])
+    return assets.packArchive(args[1], args[2], {
+        prefix = prefix,
+        compileScripts = compileScripts
+    })
+end
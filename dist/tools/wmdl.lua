@@ -1,34 +1,125 @@
 function hook_engine_tool()
     local args = wake.getArguments()
-    if #args ~= 2 and #args ~= 3 then
-        print("Usage: wmdl <input_model> <output_model> [compress=true]")
+    if #args < 2 or #args > 9 then
+        print("Usage: wmdl <input_model> <output_model> [compress=true] [shuffle=true] [quantize=false] " ..
+              "[embed_textures=false] [optimize=true] [lods=true] [meshlets=false]")
         print("Description: Converts models into the wake model format. The wake model format")
         print("             is faster for the engine to load than most formats, and is")
         print("             compressed in order to save space. This may also be used to")
         print("             upgrade old model files into a newer format.")
+        print()
+        print("             shuffle byte-shuffles vertex data before compressing it, which")
+        print("             usually makes the output smaller. It has no effect without compression.")
+        print()
+        print("             quantize stores vertices in a lossy format about half the size, and")
+        print("             makes meshes upload packed vertices. The largest error is reported.")
+        print()
+        print("             embed_textures stores the model's textures with full mip chains")
+        print("             inside the model, so loading it doesn't need to decode any images.")
+        print()
+        print("             optimize welds identical vertices and reorders triangles and vertices")
+        print("             for the GPU's vertex cache and overdraw. The ACMR (vertex shader runs")
+        print("             per triangle) before and after is reported.")
+        print()
+        print("             lods generates simplified levels of detail for every mesh, which are")
+        print("             drawn instead of the full mesh when it is far away.")
+        print()
+        print("             meshlets splits meshes into small clusters of triangles that are culled")
+        print("             individually when they are out of view or facing away from the camera.")
         return false
     end
 
     local inputPath = args[1]
     local outputPath = args[2]
     local compress = true
-    if #args == 3 then
+    if #args >= 3 then
         compress = args[3] == "true"
     end
 
+    local shuffle = true
+    if #args >= 4 then
+        shuffle = args[4] == "true"
+    end
+
+    local quantize = false
+    if #args >= 5 then
+        quantize = args[5] == "true"
+    end
+
+    local embedTextures = false
+    if #args >= 6 then
+        embedTextures = args[6] == "true"
+    end
+
+    local optimize = true
+    if #args >= 7 then
+        optimize = args[7] == "true"
+    end
+
+    local lods = true
+    if #args >= 8 then
+        lods = args[8] == "true"
+    end
+
+    local meshlets = false
+    if #args >= 9 then
+        meshlets = args[9] == "true"
+    end
+
     print("Loading input from " .. inputPath)
-    local input = assets.loadModel(inputPath)
+    local input = assets.loadModel(inputPath, { optimize = false })
     if input == nil then
         print("Unable to load input model.")
         return false
     end
 
+    if optimize then
+        local stats = assets.optimizeModel(input)
+        print("Optimized meshes:")
+        print("\tVertices: " .. stats.vertexCountBefore .. " -> " .. stats.vertexCountAfter)
+        print("\tTriangles: " .. stats.triangleCount)
+        print(string.format("\tACMR: %.3f -> %.3f", stats.acmrBefore, stats.acmrAfter))
+    end
+
+    if meshlets then
+        print("Built " .. assets.buildMeshlets(input) .. " meshlets")
+    end
+
+    if lods then
+        local levelCount = assets.generateLods(input)
+        print("Generated " .. levelCount .. " levels of detail:")
+        for i, c in ipairs(input:getMeshes()) do
+            for level = 1, c.mesh:getLodCount() - 1 do
+                print(string.format("\tMesh %d, level %d: %d -> %d triangles, error %.5f", i, level,
+                                    c.mesh:getIndexCount() / 3, c.mesh:getLodIndexCount(level) / 3,
+                                    c.mesh:getLodError(level)))
+            end
+        end
+    end
+
+    if quantize then
+        local err = assets.getQuantizationError(input)
+        print("Quantizing vertices, max error:")
+        print("\tPosition: " .. err.position)
+        print("\tNormal: " .. err.normal .. " degrees")
+        print("\tTexCoords: " .. err.texCoords)
+
+        for _, c in ipairs(input:getMeshes()) do
+            c.mesh:setVertexFormat("packed")
+        end
+    end
+
     if compress then
         print("Saving output with compression to " .. outputPath)
     else
         print("Saving output to " .. outputPath)
     end
-    local result = assets.saveModel(outputPath, input, compress)
+    local result = assets.saveModel(outputPath, input, {
+        compress = compress,
+        shuffle = shuffle,
+        quantize = quantize,
+        embedTextures = embedTextures
+    })
     if not result then
         print("Unable to save output model.")
         return false
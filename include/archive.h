@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "engineptr.h"
+#include "mappedfile.h"
+#include "util.h"
+
+#define W_ARCHIVE_CODE "WARC"
+#define W_ARCHIVE_VERSION 1
+
+// Entries start on a multiple of this, so every entry begins on its own page and is paged in independently
+#define W_ARCHIVE_ALIGNMENT 4096
+
+namespace wake
+{
+    // Read-only collection of files packed into one file for shipped builds. An archive is memory mapped once, and the
+    // files in it are served as views into that mapping (see MappedFile::view). Finding a file is a hash lookup, so
+    // loading assets and scripts doesn't need an open() or stat() per candidate path.
+    //
+    // Layout:
+    //   header   code, u32 version, u32 alignment, u32 entry count, u32 slot count, u32 flags (none yet),
+    //            u64 names offset, u64 names size
+    //   slots    u32 per slot, either 0 or 1 + the index of an entry. The slot count is a power of two, at least twice
+    //            the entry count. Entries are found by linear probing from their path's hash.
+    //   entries  u64 path hash, u64 offset, u64 size, u32 name offset, u32 name length
+    //   names    the paths of the entries, normalized (see normalizePath in fileutil.h) and not terminated
+    //   data     the contents of each entry, each one starting at a multiple of the alignment
+    //
+    // Paths are hashed with hashBytes after normalization.
+    class Archive;
+
+    typedef SharedPtr<Archive> ArchivePtr;
+
+    class Archive
+    {
+    public:
+        static ArchivePtr open(const char* path);
+
+    public:
+        // Returns a view of the file stored under path, or null if the archive doesn't have it.
+        MappedFilePtr find(const std::string& path) const;
+
+        bool contains(const std::string& path) const;
+
+        size_t getEntryCount() const;
+
+        std::string getEntryPath(size_t index) const;
+
+        const std::string& getPath() const;
+
+    private:
+        Archive();
+
+        Archive(const Archive& other) = delete;
+
+        Archive& operator=(const Archive& other) = delete;
+
+        // Index of the entry for an already normalized path, or the entry count if there isn't one.
+        size_t findEntry(const std::string& path) const;
+
+        MappedFilePtr file;
+
+        uint32 entryCount = 0;
+        uint32 slotCount = 0;
+        const char* slots = nullptr;
+        const char* entries = nullptr;
+        const char* names = nullptr;
+    };
+
+    struct ArchiveOptions
+    {
+        // Prepended to the path of every entry, so a subdirectory can be packed under the path it is loaded from.
+        std::string prefix;
+
+        // Store Lua scripts as precompiled bytecode, which skips parsing them at startup. Bytecode only loads in engine
+        // builds with the same Lua version and word size as the one that packed it.
+        bool compileScripts = true;
+    };
+
+    // Packs every file under a directory, or listed in a manifest (see cooker.h), into an archive at outputPath. Entries
+    // are stored under their path relative to the directory or manifest.
+    bool packArchive(const std::string& input, const std::string& outputPath,
+                     const ArchiveOptions& options = ArchiveOptions());
+
+    // Mounted archives are searched before the file system by openAssetFile and the script manager, most recently
+    // mounted first. Mounting and lookups may happen on any thread.
+    bool mountArchive(const char* path);
+
+    void unmountArchives();
+
+    std::vector<ArchivePtr> getMountedArchives();
+
+    // Returns path from the first mounted archive that has it, or null.
+    MappedFilePtr findArchiveFile(const std::string& path);
+
+    // Opens path from the mounted archives, or from disk if none of them have it. Loaders go through the VFS (see vfs.h),
+    // which reads files with this.
+    MappedFilePtr openAssetFile(const char* path);
+}
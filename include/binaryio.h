@@ -0,0 +1,149 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstring>
+#include <string>
+
+#include "util.h"
+
+namespace wake
+{
+    // Bounds-checked cursor over a block of memory. Reads copy directly out of the buffer; array reads are checked
+    // once for the whole array and then done as a single block copy. Any read past the end of the buffer throws.
+    class BinaryReader
+    {
+    public:
+        BinaryReader(const char* data, size_t size);
+
+        virtual ~BinaryReader();
+
+        const char* getData() const;
+
+        size_t getSize() const;
+
+        size_t getPosition() const;
+
+        size_t getRemaining() const;
+
+        void seek(size_t position);
+
+        // Returns a pointer to the next count * elementSize bytes and advances past them.
+        const char* readBytes(size_t count, size_t elementSize = 1);
+
+        // Skips forward to the next multiple of alignment (relative to the start of the buffer).
+        void readPadding(size_t alignment);
+
+        template<typename T>
+        void readArray(T* out, size_t count)
+        {
+            const char* bytes = readBytes(count, sizeof(T));
+            memcpy(out, bytes, count * sizeof(T));
+        }
+
+        uint8 readUInt8();
+
+        uint32 readUInt32();
+
+        int32 readInt32();
+
+        uint64 readUInt64();
+
+        float readFloat();
+
+        std::string readString();
+
+        glm::vec2 readVec2();
+
+        glm::vec3 readVec3();
+
+        glm::vec4 readVec4();
+
+        glm::mat4 readMatrix4();
+
+    protected:
+        // Called before the bytes in [begin, end) are handed out. Readers over a buffer that is still being filled in
+        // (by background or on-demand decompression, for example) override this to make sure that range is available.
+        virtual void require(size_t begin, size_t end);
+
+    private:
+        template<typename T>
+        T readValue()
+        {
+            T val;
+            memcpy(&val, readBytes(sizeof(T)), sizeof(T));
+            return val;
+        }
+
+        const char* data;
+        size_t size;
+        size_t position = 0;
+    };
+
+    // Appends binary data to an in-memory buffer. Values are written with plain memory copies instead of going through
+    // a std::ostream, and arrays are written as a single block.
+    //
+    // By default everything stays in the buffer. Writers with a flush size hand the buffer to flush() every time it
+    // reaches that many bytes, so subclasses can stream the data out while keeping memory use bounded.
+    class BinaryWriter
+    {
+    public:
+        BinaryWriter(size_t flushSize = 0);
+
+        virtual ~BinaryWriter();
+
+        // Data that hasn't been flushed yet.
+        std::string& getBuffer();
+
+        // Total number of bytes written, including anything already flushed.
+        size_t getPosition() const;
+
+        void writeBytes(const void* bytes, size_t size);
+
+        // Appends size bytes for the caller to fill in. The pointer is only valid until the next write. Streaming
+        // writers grow past their flush size by up to size bytes, so callers should keep allocations small.
+        char* allocateBytes(size_t size);
+
+        // Writes zeroes up to the next multiple of alignment (relative to the start of the buffer).
+        void writePadding(size_t alignment);
+
+        template<typename T>
+        void writeArray(const T* values, size_t count)
+        {
+            writeBytes(values, count * sizeof(T));
+        }
+
+        void writeUInt8(uint8 val);
+
+        void writeUInt32(uint32 val);
+
+        void writeInt32(int32 val);
+
+        void writeUInt64(uint64 val);
+
+        void writeFloat(float val);
+
+        void writeString(const std::string& val);
+
+        void writeVec2(const glm::vec2& val);
+
+        void writeVec3(const glm::vec3& val);
+
+        void writeVec4(const glm::vec4& val);
+
+        void writeMatrix4(const glm::mat4& val);
+
+    protected:
+        // Called with exactly flushSize bytes whenever that many are buffered.
+        virtual void flush(const char* data, size_t size);
+
+        // Passes whatever is left in the buffer (possibly nothing) to flush().
+        void flushRemaining();
+
+    private:
+        void flushFull();
+
+        std::string buffer;
+        size_t flushSize;
+        size_t flushed = 0;
+    };
+}
\ No newline at end of file
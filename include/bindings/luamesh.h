@@ -20,6 +20,9 @@ namespace wake
 
     void pushValue(lua_State* L, const Vertex& value);
 
+    // Pushes a table with min, max and center (vec3) and radius, or nil for empty bounds
+    void pushValue(lua_State* L, const Bounds& value);
+
     MeshPtr luaW_checkmesh(lua_State* L, int narg);
 
     Vertex* luaW_checkvertex(lua_State* L, int narg);
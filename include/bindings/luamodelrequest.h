@@ -0,0 +1,19 @@
+#pragma once
+
+#include "modelloader.h"
+#include "luautil.h"
+#include "pushvalue.h"
+
+#define W_MT_MODEL_REQUEST ("wake.ModelRequest")
+
+namespace wake
+{
+    namespace binding
+    {
+        int luaopen_modelrequest(lua_State* L);
+    }
+
+    void pushValue(lua_State* L, ModelRequestPtr value);
+
+    ModelRequestPtr luaW_checkmodelrequest(lua_State* L, int narg);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+
+namespace wake
+{
+    // Axis aligned bounding box and bounding sphere of a set of points, used to cull and sort meshes and models without
+    // looking at their vertices.
+    struct Bounds
+    {
+        glm::vec3 minimum = glm::vec3(0.0f);
+        glm::vec3 maximum = glm::vec3(0.0f);
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+
+        // Bounds of nothing at all. Merging them with other bounds has no effect.
+        bool empty = true;
+    };
+
+    // Reads count positions (three floats each) stride bytes apart. The sphere is centered on the box and just large
+    // enough to hold every point, which is a little looser than the smallest enclosing sphere but takes only two
+    // passes.
+    //
+    // Uses SSE2 where it is available, in which case 16 bytes are read at every position, so stride must be at least
+    // that large (it is for wake::Vertex).
+    Bounds computeBounds(const void* positions, size_t count, size_t stride);
+
+    // The box around both boxes and a sphere around both spheres.
+    Bounds mergeBounds(const Bounds& a, const Bounds& b);
+
+    // Planes (normal, distance) facing into a view frustum. Points p inside it have dot(normal, p) + distance >= 0 for
+    // every plane.
+    struct Frustum
+    {
+        glm::vec4 planes[6];
+    };
+
+    // The frustum matrix (e.g. projection * view * transform) maps onto the screen, in the space it maps from.
+    Frustum getFrustum(const glm::mat4& matrix);
+
+    bool isSphereVisible(const Frustum& frustum, const glm::vec3& center, float radius);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+namespace wake
+{
+    // Byte shuffle filter for arrays of fixed-size elements. Shuffling transposes the array so that byte j of every
+    // element is stored contiguously (out[j * count + i] = in[i * elementSize + j]). For arrays of structs made of
+    // floats this both de-interleaves the members and groups the sign/exponent bytes of each member together, which
+    // gives general purpose compressors like Snappy far more repeats to work with.
+    //
+    // Elements whose size is a multiple of 4 are transposed 16 at a time with SSE2 where it is available.
+    void shuffleBytes(const void* in, void* out, size_t count, size_t elementSize);
+
+    // Reverses shuffleBytes. in and out must not overlap.
+    void unshuffleBytes(const void* in, void* out, size_t count, size_t elementSize);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "util.h"
+#include "wmdl.h"
+
+// Bump whenever the cooker or anything it runs (importing, mesh optimization, ...) changes its output, so that every
+// cached result is cooked again.
+#define W_COOKER_VERSION 3
+
+namespace wake
+{
+    // Batch conversion of source models into WMDL files.
+    //
+    // The inputs are either every model under a directory or the files listed in a manifest (one path per line,
+    // relative to the manifest, '#' starts a comment). Each one is written to the output directory at the same relative
+    // path, with .wmdl added to its name unless it is a WMDL file already (so models/cube.obj becomes
+    // models/cube.obj.wmdl). Inputs that would be written to the same output fail without being cooked. Models are
+    // loaded, optimized and saved concurrently on the thread pool, with their textures embedded unless the save options
+    // say otherwise.
+    //
+    // A cache database in the output directory records, for every output, the hash of its input's contents and of the
+    // textures it used, along with the cooker version and options. Inputs that match their record and whose output
+    // still exists are skipped, so cooking again after changing a single file only redoes that file.
+
+    struct CookOptions
+    {
+        CookOptions()
+        {
+            save.embedTextures = true;
+        }
+
+        WMDLSaveOptions save;
+
+        // Run the mesh optimization pipeline (see meshopt.h) on models imported through assimp.
+        bool optimize = true;
+
+        // Generate levels of detail for every mesh (see meshopt.h), replacing any the input already had.
+        bool lods = true;
+
+        // Split every mesh into meshlets for finer grained culling (see meshopt.h).
+        bool meshlets = false;
+
+        // Cook every input, ignoring the cache.
+        bool force = false;
+
+        // Where the cache database lives, defaults to .cookcache in the output directory.
+        std::string cachePath;
+    };
+
+    struct CookSummary
+    {
+        size_t inputCount = 0;
+        size_t cookedCount = 0;
+        size_t cachedCount = 0;
+        size_t failedCount = 0;
+
+        // Size of the inputs that were cooked (not cached) and of what was written for them.
+        uint64 bytesRead = 0;
+        uint64 bytesWritten = 0;
+
+        double seconds = 0.0;
+
+        std::vector<std::string> failed;
+    };
+
+    // Lists the inputs for a directory or manifest, relative to root (which is set to the directory the paths are
+    // relative to). Returns false if input can't be read.
+    bool findCookInputs(const std::string& input, std::string& root, std::vector<std::string>& inputs);
+
+    CookSummary cookAssets(const std::string& input, const std::string& outputDirectory,
+                           const CookOptions& options = CookOptions());
+}
@@ -8,4 +8,8 @@ namespace wake
     // This is typedef'd as it may be replaced with a custom implementation in the future.
     template<typename T>
     using SharedPtr = std::shared_ptr<T>;
+
+    // Non-owning reference to an object held by a SharedPtr.
+    template<typename T>
+    using WeakPtr = std::weak_ptr<T>;
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace wake
+{
+    // Lexically normalizes a path: backslashes become slashes, and empty, "." and "dir/.." components are removed.
+    std::string normalizePath(const std::string& path);
+
+    bool isDirectory(const std::string& path);
+
+    // Appends every file under root (recursively) to files, as paths relative to root. Entries are sorted by name, so
+    // the listing is the same on every file system.
+    void listFiles(const std::string& root, std::vector<std::string>& files);
+
+    // Reads a manifest listing one path per line ('#' starts a comment). root is set to the directory of the manifest,
+    // which the paths are relative to. Returns false if the manifest can't be opened.
+    bool readManifest(const std::string& path, std::string& root, std::vector<std::string>& files);
+
+    // Moves a file over another one, replacing it.
+    bool replaceFile(const std::string& from, const std::string& to);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+
+#include "glutil.h"
+#include "util.h"
+
+#define W_FRAME_UNIFORMS (wake::FrameUniforms::get())
+
+// Name of the uniform block shaders declare to read the per-frame parameters, and the binding point it is bound to
+#define W_FRAME_BLOCK_NAME "Frame"
+#define W_FRAME_BLOCK_BINDING 0
+
+namespace wake
+{
+    // Uniform buffer holding the global material parameters that are the same for every draw in a frame. Shaders that
+    // declare the block below get them from the buffer, and Material::use no longer sets them on each shader with
+    // separate glUniform calls:
+    //
+    //   layout (std140) uniform Frame
+    //   {
+    //       mat4 projection;
+    //       mat4 view;
+    //   };
+    //
+    // The values are taken from the global material by name (see Material::getGlobalMaterial), so setting them there
+    // works the same whether a shader declares the block or plain uniforms. Shaders with the block can't have them
+    // overridden per material or per draw. The render queue updates the buffer before each flush, and Material::use for
+    // draws outside of it, but it is only uploaded when a value changed since the last upload.
+    //
+    // Outside of EngineMode::Normal the values are packed and uploads counted, but nothing reaches GL. Only used from
+    // the main thread.
+    class FrameUniforms
+    {
+    public:
+        static FrameUniforms& get();
+
+    public:
+        // Whether a parameter is a member of the block, in which case shaders that declare it read it from there.
+        static bool isMember(const std::string& name);
+
+        // Packs the global material's values and uploads them if any of them changed.
+        void update();
+
+        // Number of times the buffer was uploaded.
+        uint64 getUploadCount() const;
+
+    private:
+        FrameUniforms();
+
+        FrameUniforms(const FrameUniforms& other) = delete;
+
+        FrameUniforms& operator=(const FrameUniforms& other) = delete;
+
+        // std140 layout of the block
+        struct Block
+        {
+            GLfloat projection[16];
+            GLfloat view[16];
+        };
+
+        Block block;
+        bool uploaded = false;
+        GLuint buffer = 0;
+        uint64 uploadCount = 0;
+    };
+}
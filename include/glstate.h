@@ -0,0 +1,86 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "glutil.h"
+#include "util.h"
+
+#define W_GL_STATE (wake::GLState::get())
+
+// Texture units whose bindings are tracked, binds to units past these always reach GL
+#define W_GL_STATE_TEXTURE_UNITS 32
+
+namespace wake
+{
+    // Shadow of the GL bindings the engine changes while drawing: the current program, vertex array, array, element and
+    // uniform buffers, the active texture unit and the 2D texture bound to each unit. Binding something that is bound
+    // already is skipped, so the render code can bind whatever it needs before every draw without paying for it.
+    //
+    // The element buffer binding belongs to the vertex array it was bound with, so it is remembered per vertex array.
+    // Deleting objects through here keeps the shadow in sync with the bindings GL drops. Anything that changes these
+    // bindings behind its back must call invalidate() afterwards.
+    //
+    // Outside of EngineMode::Normal the bindings are tracked and counted, but nothing reaches GL. Only used from the
+    // main thread.
+    class GLState
+    {
+    public:
+        static GLState& get();
+
+    public:
+        void useProgram(GLuint program);
+
+        void bindVertexArray(GLuint vertexArray);
+
+        void bindBuffer(GLenum target, GLuint buffer);
+
+        // Binds a buffer to an indexed binding point, which always reaches GL, and to the target's general binding.
+        void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+        // Takes the index of the unit, not GL_TEXTURE0 + index.
+        void activeTexture(GLenum unit);
+
+        // Binds a GL_TEXTURE_2D texture, the only kind there is, to the active unit.
+        void bindTexture(GLuint texture);
+
+        void deleteProgram(GLuint program);
+
+        void deleteVertexArray(GLuint vertexArray);
+
+        void deleteBuffer(GLuint buffer);
+
+        void deleteTexture(GLuint texture);
+
+        // Forgets every binding, so the next bind of each reaches GL.
+        void invalidate();
+
+        // Number of binds that reached GL and that were skipped because they changed nothing.
+        uint64 getIssuedCount() const;
+
+        uint64 getSkippedCount() const;
+
+        void resetStats();
+
+    private:
+        GLState();
+
+        GLState(const GLState& other) = delete;
+
+        GLState& operator=(const GLState& other) = delete;
+
+        // Counts a bind, returns whether it has to reach GL
+        bool change(GLuint& current, GLuint value);
+
+        GLuint program;
+        GLuint vertexArray;
+        GLuint arrayBuffer;
+        GLuint uniformBuffer;
+        GLuint activeUnit;
+        GLuint textures[W_GL_STATE_TEXTURE_UNITS];
+
+        std::unordered_map<GLuint, GLuint> elementBuffers;
+
+        uint64 issuedCount = 0;
+        uint64 skippedCount = 0;
+    };
+}
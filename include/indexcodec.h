@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "util.h"
+
+namespace wake
+{
+    // Compact encodings for triangle index lists, used by WMDL.
+    //
+    // Besides plain 16-bit indices, a list can be delta coded: each index is stored as the difference from the previous
+    // one, zigzag encoded so that small negative differences stay small, and then written as a LEB128 varint. Meshes
+    // that have been optimized for the vertex cache reference nearby vertices, so most indices end up as a single byte.
+    //
+    // Decoding uses SSE2 where it is available: 16-bit indices are widened 8 at a time, and runs of single-byte varints
+    // are unzigzagged and prefix summed 16 at a time.
+
+    uint32 getMaxIndex(const uint32* indices, size_t count);
+
+    void narrowIndices(const uint32* indices, size_t count, uint16* out);
+
+    void widenIndices(const uint16* indices, size_t count, uint32* out);
+
+    // Number of bytes encodeIndexDeltas would write for the whole list.
+    size_t getIndexDeltaSize(const uint32* indices, size_t count);
+
+    // Appends the delta coded indices to out. Lists can be encoded in pieces by passing the last index of the previous
+    // piece as previous.
+    void encodeIndexDeltas(const uint32* indices, size_t count, std::string& out, uint32 previous = 0);
+
+    // Decodes exactly count indices from data. Returns false if the data is truncated or malformed.
+    bool decodeIndexDeltas(const char* data, size_t size, uint32* out, size_t count);
+}
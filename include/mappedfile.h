@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "engineptr.h"
+#include "util.h"
+
+namespace wake
+{
+    class MappedFile;
+
+    typedef SharedPtr<MappedFile> MappedFilePtr;
+
+    // Read-only view of the contents of a file. Where the platform supports it the file is memory mapped, so its data
+    // is paged in on demand and never copied onto the heap. Otherwise the whole file is read into memory once.
+    class MappedFile
+    {
+    public:
+        static MappedFilePtr open(const char* path);
+
+        // A view of size bytes at offset into file, under its own path. The view keeps file open for as long as it
+        // lives. Returns null if the range is out of bounds.
+        static MappedFilePtr view(const MappedFilePtr& file, size_t offset, size_t size, const std::string& path);
+
+    public:
+        ~MappedFile();
+
+        const char* getData() const;
+
+        size_t getSize() const;
+
+        const std::string& getPath() const;
+
+        bool isMapped() const;
+
+        // Hints that the contents will be needed soon, so the OS can start reading them in the background.
+        void prefetch() const;
+
+        // Makes sure the contents are in memory, reading them in on the calling thread if they aren't yet. Afterwards
+        // accessing the data won't stall on the disk (unless the OS runs low on memory and evicts it again).
+        void pageIn() const;
+
+    private:
+        MappedFile();
+
+        MappedFile(const MappedFile& other) = delete;
+
+        MappedFile& operator=(const MappedFile& other) = delete;
+
+        const char* data = nullptr;
+        size_t size = 0;
+        std::string path;
+
+        bool mapped = false;
+        std::vector<char> buffer;
+
+        // The file a view was made from.
+        MappedFilePtr owner;
+
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#endif
+    };
+}
\ No newline at end of file
@@ -16,8 +16,8 @@
 namespace wake
 {
     // TODO: Support for all matrix types
-    // TODO: Don't use a union, having a single parameter always contain at least the size of a mat4 is incredibly
-    //       inefficient.
+    // A single parameter value as it is passed in and out of a material. Materials don't store these, they keep only as
+    // many bytes as each type needs (see MaterialParameters).
     struct MaterialParameter
     {
         static MaterialParameter NullParameter;
@@ -25,8 +25,7 @@ namespace wake
         MaterialParameter()
         {
             type = Null;
-            i = 0;
-            uniform = Uniform();
+            m4 = glm::mat4(0.0f);
         }
 
         void setUniform(Uniform& uniform) const;
@@ -58,8 +57,56 @@ namespace wake
 
             glm::mat4 m4;
         };
+    };
+
+    // Parameters packed back to back into one buffer, each taking only the size of its type, with a small index of
+    // entries sorted by name. The names share one string, so a parameter costs its value plus a 12 byte entry and its
+    // name. Values are made of 4 byte components and stay aligned to 4 bytes.
+    class MaterialParameters
+    {
+    public:
+        struct Entry
+        {
+            uint32 nameOffset;
+            uint32 valueOffset;
+            uint16 nameLength;
+            uint8 type;
+        };
+
+        static size_t getValueSize(uint8 type);
+
+    public:
+        // Returns whether the layout changed, which is when the parameter is new or changed type. Setting a Null
+        // parameter removes it.
+        bool set(const std::string& name, const MaterialParameter& param);
+
+        // Returns whether there was a parameter to remove.
+        bool remove(const std::string& name);
+
+        // Index of a parameter, or the parameter count if there isn't one.
+        size_t find(const std::string& name) const;
+
+        size_t getCount() const;
+
+        std::string getName(size_t index) const;
+
+        const Entry& getEntry(size_t index) const;
+
+        MaterialParameter get(size_t index) const;
+
+        // Returns MaterialParameter::NullParameter if there isn't one.
+        MaterialParameter get(const std::string& name) const;
+
+        // Packed values, which the entries' value offsets point into.
+        const char* getValues() const;
 
-        Uniform uniform;
+    private:
+        // Index of the first entry whose name isn't less than name
+        size_t lowerBound(const std::string& name) const;
+
+        std::vector<Entry> entries;
+        std::string names;
+        std::vector<char> values;
     };
 
     struct MaterialTexParameter
@@ -67,11 +114,9 @@ namespace wake
         MaterialTexParameter()
         {
             texture = nullptr;
-            uniform = Uniform();
         }
 
         TexturePtr texture;
-        Uniform uniform;
     };
 
     typedef SharedPtr<class Material> MaterialPtr;
@@ -131,27 +176,75 @@ namespace wake
 
         void removeParameter(const std::string& name);
 
-        const MaterialParameter& getParameter(const std::string& name) const;
+        MaterialParameter getParameter(const std::string& name) const;
 
-        const std::map<std::string, MaterialParameter>& getParameters() const;
+        const MaterialParameters& getParameters() const;
 
         size_t getParameterCount() const;
 
         void copyFrom(MaterialPtr other);
 
+        // Makes the shader current and sets the material's textures and parameters on it.
         void use();
 
+        // The parts of use() after making the shader current, for callers that already did (see RenderQueue). They
+        // only affect the current program, so they must come after the shader's use().
+        void bindTextures();
+
+        void applyParameters();
+
+        // Makes the next use() compile the material again, e.g. after its shader was changed behind its back.
         void resetUniformCache();
 
     private:
+        // Uniform a parameter is uploaded to, and where its value is in the packed values
+        struct UniformRecord
+        {
+            GLint location;
+            uint8 type;
+            uint32 offset;
+        };
+
+        struct TextureRecord
+        {
+            GLint location;
+            uint32 unit;
+            TexturePtr texture;
+        };
+
+        static void setUniformValue(const UniformRecord& record, const char* values);
+
+        // Sets a parameter, only recompiling if it is new or changed type
+        void storeParameter(const std::string& name, const MaterialParameter& param);
+
+        void layoutChanged();
+
+        // Called before the shader, a texture or a parameter changes, so draws queued with the old values are drawn first
+        void changing();
+
+        // Builds the compiled form of the material if anything it depends on changed since it was last built. Every
+        // uniform and texture the shader has is resolved to a record up front, so using the material is a loop over
+        // the records without any lookups. Records point straight into the packed parameter values, globals into the
+        // global material's.
+        void compile();
+
         std::string typeName = "default";
 
         ShaderPtr shader;
         std::map<std::string, MaterialTexParameter> textures;
-        std::map<std::string, MaterialParameter> parameters;
+        MaterialParameters parameters;
+
+        // Compiled form
+        std::vector<UniformRecord> uniformRecords;
+        std::vector<UniformRecord> globalRecords;
+        std::vector<TextureRecord> textureRecords;
+        std::map<std::string, GLint> tempLocations;
 
-        std::map<std::string, Uniform> globalCache;
+        bool needsCompile = true;
 
-        bool needsUniformUpdates = false;
+        // Bumped whenever a parameter is added, removed or changes type, so materials can tell when the global
+        // material's values moved
+        uint32 layoutVersion = 0;
+        uint32 compiledGlobalLayout = ~0u;
     };
 }
\ No newline at end of file
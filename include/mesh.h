@@ -1,10 +1,13 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <functional>
 #include <vector>
 
+#include "bounds.h"
 #include "glutil.h"
 #include "engineptr.h"
+#include "util.h"
 
 namespace wake
 {
@@ -35,6 +38,56 @@ namespace wake
         glm::vec2 texCoords;
     };
 
+    // WMDL stores vertices as a raw array of this struct, so its layout must stay tightly packed.
+    static_assert(sizeof(Vertex) == 8 * sizeof(float), "wake::Vertex must be tightly packed");
+
+    // Layout of the vertex data uploaded to OpenGL. Every format feeds the same attribute locations (0 = position,
+    // 1 = normal, 2 = texCoords) with the same types as seen by shaders, so materials work with any of them. The
+    // vertices kept on the CPU side are always full wake::Vertex values.
+    enum class VertexFormat
+    {
+        // 32 bytes, wake::Vertex as-is.
+        Float = 0,
+
+        // 20 bytes: float position, normal packed into a normalized 10/10/10/2 integer, half float texCoords.
+        Packed = 1,
+
+        // 16 bytes: half float position (padded to 4 components), normal and texCoords as in Packed. Positions only
+        // keep 11 bits of precision, so this is meant for meshes that are small or close to the origin.
+        PackedHalf = 2
+    };
+
+    // A simplified version of a mesh, drawn in place of the full mesh when it is far enough away. Its indices reference
+    // the mesh's vertices. error is how far the level's surface may be from the full mesh, in the same units as the
+    // vertex positions.
+    struct MeshLod
+    {
+        std::vector<GLuint> indices;
+        float error = 0.0f;
+    };
+
+    // A cluster of nearby triangles that is culled as a whole: a range of the mesh's indices along with a bounding
+    // sphere and a cone around the normals of all of its triangles.
+    struct Meshlet
+    {
+        uint32 indexOffset = 0;
+        uint32 indexCount = 0;
+
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+
+        // Every triangle faces away from cameras where
+        // dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius. A cutoff of 1 never culls
+        // anything.
+        glm::vec3 coneAxis = glm::vec3(0.0f);
+        float coneCutoff = 1.0f;
+    };
+
+    // Fills in the vertices, indices, levels of detail and meshlets of a deferred mesh. Returns false if the data can't
+    // be loaded, which leaves the mesh empty (see Mesh::hasLoadFailed).
+    typedef std::function<bool(std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+                               std::vector<MeshLod>& lods, std::vector<Meshlet>& meshlets)> MeshLoader;
+
     class Mesh
     {
     public:
@@ -45,12 +98,36 @@ namespace wake
 
         Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
 
+        Mesh(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount);
+
+        Mesh(std::vector<Vertex>&& vertices, std::vector<GLuint>&& indices,
+             VertexFormat vertexFormat = VertexFormat::Float, std::vector<MeshLod>&& lods = std::vector<MeshLod>(),
+             std::vector<Meshlet>&& meshlets = std::vector<Meshlet>());
+
+        // Deferred mesh: the loader is called to fill in the data the first time it is queried or drawn. The counts
+        // are what the loader is expected to produce, and are reported by getVertexCount/getIndexCount until then.
+        // Bounds that aren't empty are reported by getBounds until then as well, otherwise it loads the mesh.
+        Mesh(size_t vertexCount, size_t indexCount, const MeshLoader& loader,
+             VertexFormat vertexFormat = VertexFormat::Float, const Bounds& bounds = Bounds());
+
         Mesh(const Mesh& other);
 
         ~Mesh();
 
         Mesh& operator=(const Mesh& other);
 
+        bool isLoaded() const;
+
+        // Runs the loader of a deferred mesh. Does nothing if the mesh is already loaded.
+        void load();
+
+        // Whether the loader of a deferred mesh failed, in which case the mesh is loaded but empty.
+        bool hasLoadFailed() const;
+
+        size_t getVertexCount() const;
+
+        size_t getIndexCount() const;
+
         const std::vector<Vertex>& getVertices() const;
 
         void setVertices(const std::vector<Vertex>& vertices, bool updateIndices = false);
@@ -59,21 +136,85 @@ namespace wake
 
         void setIndices(const std::vector<GLuint>& indices);
 
-        void draw();
+        // Bounds of all of the mesh's vertices, kept up to date whenever they change.
+        const Bounds& getBounds() const;
+
+        // Number of levels of detail, including the full mesh as level 0.
+        size_t getLodCount() const;
+
+        // Level 0 is the full mesh, so its error is always 0.
+        const std::vector<GLuint>& getLodIndices(size_t level) const;
+
+        float getLodError(size_t level) const;
+
+        // Replaces the levels after the full mesh, ordered from most to least detailed. setVertices and setIndices
+        // clear them, since they no longer match the mesh afterwards.
+        void setLods(const std::vector<MeshLod>& lods);
+
+        const std::vector<Meshlet>& getMeshlets() const;
+
+        // Replaces the indices with the same triangles ordered so that each meshlet is a contiguous range of them (see
+        // buildMeshlets in meshopt.h). Levels of detail are kept. setVertices and setIndices clear the meshlets.
+        void setMeshlets(const std::vector<GLuint>& indices, const std::vector<Meshlet>& meshlets);
+
+        // The most simplified level whose error, seen through modelView and projection, covers at most threshold of
+        // the screen's height. Meshes without levels of detail, or that the camera is inside of, always use level 0.
+        size_t selectLod(const glm::mat4& modelView, const glm::mat4& projection, float threshold) const;
+
+        VertexFormat getVertexFormat() const;
+
+        // Changes how the vertices are stored on the GPU, re-uploading them if needed.
+        void setVertexFormat(VertexFormat format);
+
+        // Whether the mesh has its OpenGL objects. Meshes created while uploads are deferred (see setDeferUploads)
+        // don't until upload() is called.
+        bool isUploaded() const;
+
+        // Creates the OpenGL objects of a mesh created while uploads were deferred and uploads its data. Must be called
+        // on the main thread. draw() does this on its own if needed.
+        void upload();
+
+        void draw(size_t level = 0);
+
+        // Draws the full mesh, leaving out meshlets outside of frustum and, if cullBackfaces is set, meshlets facing
+        // away from cameraPosition. Both are in the mesh's own space. Returns the number of triangles left, which is
+        // worked out (but nothing is drawn) outside of EngineMode::Normal as well. Meshes without meshlets are drawn
+        // in full.
+        size_t drawMeshlets(const Frustum& frustum, const glm::vec3& cameraPosition, bool cullBackfaces);
 
     private:
         std::vector<Vertex> vertices;
         std::vector<GLuint> indices;
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+        Bounds bounds;
+
+        // Ranges of the element buffer that drawMeshlets draws, kept around so they don't have to be reallocated
+        std::vector<GLsizei> drawCounts;
+        std::vector<const GLvoid*> drawOffsets;
+
+        MeshLoader loader;
+        size_t deferredVertexCount = 0;
+        size_t deferredIndexCount = 0;
+        bool loadFailed = false;
+
+        VertexFormat vertexFormat = VertexFormat::Float;
 
         GLuint vao = 0;
         GLuint vbo = 0;
         GLuint ebo = 0;
 
+        void ensureLoaded() const;
+
         void initializeData();
 
+        void updateVertexAttributes();
+
         void updateVertexBuffer();
 
         void updateElementBuffer();
+
+        void updateBounds();
     };
 
     typedef SharedPtr<Mesh> MeshPtr;
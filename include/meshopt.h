@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.h"
+#include "model.h"
+#include "util.h"
+
+// Size of the FIFO vertex cache that meshes are optimized for and that ACMR is measured against. Most GPUs have a
+// post-transform cache of at least this many entries.
+#define W_VERTEX_CACHE_SIZE ((size_t) 16)
+
+// Default meshlet limits, small enough for culling to be fine grained and for a meshlet to fit a mesh shader workgroup.
+#define W_MESHLET_MAX_VERTICES ((size_t) 64)
+#define W_MESHLET_MAX_TRIANGLES ((size_t) 124)
+
+namespace wake
+{
+    // Offline mesh optimizations for indexed triangle lists, run when importing models and converting them to WMDL.
+    //
+    // The full pipeline (optimizeMesh) runs these in order:
+    // - weldVertices merges vertices that are bit-for-bit identical
+    // - optimizeVertexCache reorders triangles for the post-transform vertex cache (Forsyth's algorithm)
+    // - optimizeOverdraw splits that order into clusters wherever doing so doesn't hurt the cache much, and sorts the
+    //   clusters so the ones facing outwards from the middle of the mesh are drawn first
+    // - optimizeVertexFetch reorders vertices in the order they are first used and drops unused ones
+    //
+    // simplifyMesh and generateLods build the levels of detail stored alongside a mesh (see Mesh::setLods), and
+    // buildMeshlets splits a mesh into the meshlets Model::draw culls (see Mesh::setMeshlets).
+    //
+    // Their effect is measured as ACMR (average cache miss ratio): vertex shader invocations per triangle with a
+    // W_VERTEX_CACHE_SIZE entry FIFO cache. 3 is the worst case, well optimized meshes get close to 0.5-0.7.
+
+    struct MeshOptimizationOptions
+    {
+        bool weld = true;
+
+        bool vertexCache = true;
+
+        // How much worse than the vertex cache optimized order the cache hit rate may get when splitting triangles
+        // into clusters for overdraw, 1.05 allows 5%. Has no effect unless vertexCache is also set.
+        bool overdraw = true;
+        float overdrawThreshold = 1.05f;
+
+        bool vertexFetch = true;
+    };
+
+    struct LodOptions
+    {
+        // Target error of every level after the full mesh, relative to the mesh's radius. At most this many levels are
+        // generated, fewer if a level can't be made small enough to be worth it.
+        std::vector<float> errors = {0.01f, 0.025f, 0.05f, 0.1f};
+
+        // Each level aims for this fraction of the triangles of the previous one.
+        float reduction = 0.5f;
+    };
+
+    struct MeshOptimizationStats
+    {
+        size_t vertexCountBefore = 0;
+        size_t vertexCountAfter = 0;
+        size_t triangleCount = 0;
+        float acmrBefore = 0.0f;
+        float acmrAfter = 0.0f;
+    };
+
+    float getACMR(const GLuint* indices, size_t indexCount, size_t vertexCount,
+                  size_t cacheSize = W_VERTEX_CACHE_SIZE);
+
+    // Returns the number of vertices left.
+    size_t weldVertices(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+    void optimizeVertexCache(GLuint* indices, size_t indexCount, size_t vertexCount);
+
+    // Expects triangles that have already been optimized for the vertex cache.
+    void optimizeOverdraw(GLuint* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+                          float threshold);
+
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+    // Quadric error edge collapse simplification. Collapses edges until there are at most targetIndexCount indices or
+    // any further collapse would move the surface by more than targetError, relative to the radius of the mesh's
+    // bounding box. Vertices that share a position (seams, or meshes without shared vertices) collapse together, and
+    // each moved corner takes on the vertex at its new position with the closest normal and texCoords. Open borders
+    // only collapse along themselves and non-manifold edges are kept. The result references the same vertices as the
+    // input; resultError is set to the largest error introduced, relative to the radius as well.
+    std::vector<GLuint> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                                     size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+    // Simplifies the mesh once per entry in options.errors. Each level is simplified from the full mesh and optimized
+    // for the vertex cache, and its error is stored in the same units as the vertex positions.
+    std::vector<MeshLod> generateLods(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                                      const LodOptions& options = LodOptions());
+
+    // Replaces the levels of detail of every mesh of the model. Returns the number of levels generated in total.
+    size_t generateLods(ModelPtr model, const LodOptions& options = LodOptions());
+
+    // Splits the triangles into meshlets of at most maxVertices vertices and maxTriangles triangles and reorders the
+    // indices so every meshlet is a contiguous range of them. Each meshlet grows from a seed triangle by adding the
+    // neighbouring triangle (by position, so seams don't split meshlets) that adds the fewest vertices and has the
+    // normal closest to the meshlet's, which keeps meshlets compact and their normal cones narrow.
+    std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+                                       size_t maxVertices = W_MESHLET_MAX_VERTICES,
+                                       size_t maxTriangles = W_MESHLET_MAX_TRIANGLES);
+
+    // Replaces the meshlets of every mesh of the model. Returns the number of meshlets built in total.
+    size_t buildMeshlets(ModelPtr model, size_t maxVertices = W_MESHLET_MAX_VERTICES,
+                         size_t maxTriangles = W_MESHLET_MAX_TRIANGLES);
+
+    MeshOptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+                                       const MeshOptimizationOptions& options = MeshOptimizationOptions());
+
+    // Optimizes every mesh of the model in place. The ACMR in the result is averaged over all triangles.
+    MeshOptimizationStats optimizeModel(ModelPtr model,
+                                        const MeshOptimizationOptions& options = MeshOptimizationOptions());
+}
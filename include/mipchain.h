@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+#include "util.h"
+
+namespace wake
+{
+    // CPU generated mip chains for RGBA8 textures. A chain is stored as every level back to back, largest first, with
+    // each level tightly packed. Each level halves the size of the previous one (rounding down, but never below 1) and
+    // is a box filter of it; odd rows or columns fold into the last texel.
+
+    // Number of levels in a full chain down to 1x1.
+    int getMipLevelCount(int width, int height);
+
+    // Size in bytes of the first levelCount levels of a chain.
+    size_t getMipChainSize(int width, int height, int levelCount);
+
+    // Fills in levels 1 to levelCount - 1 of chain, which must already contain level 0.
+    void generateMipChain(uint8* chain, int width, int height, int levelCount);
+}
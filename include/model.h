@@ -32,7 +32,6 @@ namespace wake
         std::string path;
     };
 
-    // TODO: Sort components by material (and shader?) and draw them in batches
     class Model
     {
     public:
@@ -116,13 +115,39 @@ namespace wake
 
         bool removeMesh(int32 index);
 
+        // Bounds of every mesh together. Deferred meshes that don't know their bounds yet are loaded.
+        Bounds getBounds() const;
+
+        // Whether draw leaves out meshlets that are outside of the view or facing away from the camera (see
+        // Mesh::drawMeshlets). Enabled by default, it only affects meshes that have meshlets.
+        bool getMeshletCulling() const;
+
+        void setMeshletCulling(bool enabled);
+
+        // How much of the screen's height a mesh's simplification error may cover before a more detailed level of
+        // detail is drawn (see Mesh::selectLod).
+        float getLodThreshold() const;
+
+        void setLodThreshold(float threshold);
+
         // TODO: Pass a list (map?) of parameters instead of a Material, this is a bit hacky.
+        // Levels of detail are picked and meshes and meshlets outside of the view culled using the "projection", "view"
+        // and "transform" parameters, taken from parameterData or the global material. Without all three, meshes are
+        // always drawn in full. If any of the model's shaders reads the Frame block (see FrameUniforms), projection and
+        // view always come from the global material, like they do for that shader.
+        //
+        // Meshes are submitted to the render queue rather than drawn right away, so they are batched with every other
+        // model drawn in the frame (see RenderQueue), and anything drawn directly in the meantime ends up beneath them.
+        // They are still drawn with the camera, global material and materials as they are now: changing one of those
+        // while its draws are queued makes the queue draw them first.
         void draw(MaterialPtr parameterData);
 
     private:
         std::vector<MaterialInfo> materials;
         std::vector<MeshInfo> meshes;
         ModelMetadata metadata;
+        float lodThreshold = 0.001f;
+        bool meshletCulling = true;
     };
 
     typedef SharedPtr<Model> ModelPtr;
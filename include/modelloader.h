@@ -0,0 +1,120 @@
+#pragma once
+
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "model.h"
+#include "event.h"
+#include "threadpool.h"
+
+#define W_MODEL_LOADER (wake::ModelLoader::get())
+
+namespace wake
+{
+    // Loads a model from any format supported by assimp. Unless optimize is false, every mesh goes through optimizeMesh
+    // (see meshopt.h) before it is created.
+    ModelPtr loadAssimpModel(const char* path, bool optimize = true);
+
+    // Loads a WMDL file (see wmdl.h) or, for any other extension, goes through assimp. lazy only applies to WMDL files,
+    // optimize only to the others.
+    ModelPtr loadModel(const char* path, bool lazy = false, bool optimize = true);
+
+    class ModelRequest;
+
+    typedef SharedPtr<ModelRequest> ModelRequestPtr;
+
+    // Handle to a model that is being loaded by the ModelLoader.
+    class ModelRequest
+    {
+    public:
+        enum class Status
+        {
+            Loading, // Reading and decoding the file on the thread pool
+            Uploading, // Sending meshes and textures to OpenGL on the main thread
+            Ready,
+            Failed
+        };
+
+    public:
+        ModelRequest(const std::string& path, bool lazy, bool optimize = true);
+
+        const std::string& getPath() const;
+
+        bool isLazy() const;
+
+        bool isOptimized() const;
+
+        Status getStatus() const;
+
+        // Whether the request is either Ready or Failed.
+        bool isDone() const;
+
+        // The loaded model once the request is Ready, null until then.
+        ModelPtr getModel() const;
+
+    private:
+        friend class ModelLoader;
+
+        std::string path;
+        bool lazy;
+        bool optimize;
+        Status status = Status::Loading;
+
+        // Only the request's own load runs on the main thread when finish() has to wait for it
+        TaskGroup tasks;
+        std::future<ModelPtr> result;
+        ModelPtr model;
+
+        // Meshes and textures that still need to be uploaded, in order
+        std::vector<MeshPtr> meshes;
+        std::vector<TexturePtr> textures;
+        size_t uploaded = 0;
+    };
+
+    // Loads models without blocking the main thread. File IO, decompression and parsing run on the thread pool with
+    // uploads deferred (see setDeferUploads), and the OpenGL uploads are then done on the main thread a few at a time
+    // by update(), which Engine::run calls once per frame.
+    class ModelLoader
+    {
+    public:
+        static ModelLoader& get();
+
+    public:
+        // Called from update() once for every request that finished, whether it succeeded or not (and including
+        // requests that were finished early with finish()).
+        Event<ModelRequestPtr> LoadedEvent;
+
+        // lazy and optimize work like they do for loadModel.
+        ModelRequestPtr loadAsync(const std::string& path, bool lazy = false, bool optimize = true);
+
+        // Moves pending requests along, spending at most roughly budget seconds on uploads (at least one upload is done
+        // per call, so a tiny budget still makes progress).
+        void update(double budget);
+
+        // Blocks until the request is done, doing all of its remaining uploads right away.
+        void finish(ModelRequestPtr request);
+
+        size_t getPendingCount() const;
+
+        // Time update() may spend on uploads every frame, in seconds.
+        double getUploadBudget() const;
+
+        void setUploadBudget(double budget);
+
+    private:
+        ModelLoader();
+
+        ModelLoader(const ModelLoader& other) = delete;
+
+        ModelLoader& operator=(const ModelLoader& other) = delete;
+
+        // Returns true once the request is done. Waits for the file to load if block is set, otherwise gives up as
+        // soon as something isn't ready or the deadline passes.
+        bool advance(ModelRequestPtr request, double deadline, bool block);
+
+        std::deque<ModelRequestPtr> pending;
+        double uploadBudget = 0.002;
+    };
+}
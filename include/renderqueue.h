@@ -0,0 +1,143 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "material.h"
+#include "mesh.h"
+#include "shader.h"
+#include "util.h"
+
+#define W_RENDER_QUEUE (wake::RenderQueue::get())
+
+namespace wake
+{
+    // What the render queue drew since its stats were last reset, which Engine::run does at the start of every frame. A
+    // frame that changes the global material or a queued material between draws is flushed more than once (see
+    // RenderQueue), the stats add all of them up.
+    struct RenderStats
+    {
+        uint32 draws = 0;
+
+        // Runs of draws that share a shader, textures and material, which had their material set once for the run. A run
+        // also ends where a draw's parameters (see Model::draw) leave out one of the draw before's, so the material's
+        // value is set again.
+        uint32 batches = 0;
+
+        uint32 shaderChanges = 0;
+        uint32 textureChanges = 0;
+
+        // Shaders, texture sets and materials set, together.
+        uint32 getStateChanges() const
+        {
+            return shaderChanges + textureChanges + batches;
+        }
+    };
+
+    // Collects the draws of a frame so meshes that share state are drawn together, wherever they come from.
+    //
+    // Every draw is given a 64 bit key, from most to least significant: shader, texture set, material and mesh. The ids
+    // in the key are handed out in the order things are first submitted each frame. A texture set is the textures of a
+    // material along with the names they are bound to, so materials that only differ in their parameters share one.
+    // Flushing sorts the draws by their key and only switches the shader, binds textures or applies a material's
+    // parameters when they differ from the draw before. The key only decides the order: if a frame has more of
+    // something than its field holds, the extra ones share the last id and are sorted less well, but still drawn
+    // correctly.
+    //
+    // Draws are submitted in groups, each with the per-draw parameters (such as "transform") that are applied on top of
+    // the material and the frustum its meshlets are culled against (see Model::draw). Parameters are copied when the
+    // group begins, so the material they came from may be changed or reused for the next group right away.
+    //
+    // Queued draws are drawn with the values the global material (including the camera's "projection" and "view") and
+    // their own material had when they were submitted. Changing either of them while it has queued draws flushes the
+    // queue before the change is made (see materialChanging), so drawing with two cameras in one frame, or changing a
+    // material between draws, costs a flush each time rather than drawing everything with the last values.
+    //
+    // The engine flushes the queue once per frame, after the late tick. Outside of EngineMode::Normal nothing is drawn
+    // and no state is set, but the draws are still sorted and counted. Only used from the main thread.
+    class RenderQueue
+    {
+    public:
+        static RenderQueue& get();
+
+    public:
+        void beginGroup(MaterialPtr parameterData, const Frustum& frustum, const glm::vec3& cameraPosition,
+                        bool cullBackfaces);
+
+        // Queues a draw of one level of detail of a mesh in the current group. With meshlets set, the full mesh is
+        // drawn through Mesh::drawMeshlets instead, culled against the group's frustum.
+        void submit(MeshPtr mesh, MaterialPtr material, size_t level, bool meshlets);
+
+        size_t getPendingCount() const;
+
+        // Draws everything submitted since the last flush and empties the queue.
+        void flush();
+
+        // Throws away everything submitted since the last flush without drawing it.
+        void clear();
+
+        const RenderStats& getStats() const;
+
+        void resetStats();
+
+        // Called by a material right before it changes. Draws queued with it, or with anything if it is the global
+        // material, are drawn first so they keep the values they were submitted with.
+        void materialChanging(const Material* material);
+
+    private:
+        RenderQueue();
+
+        RenderQueue(const RenderQueue& other) = delete;
+
+        RenderQueue& operator=(const RenderQueue& other) = delete;
+
+        typedef std::vector<std::pair<std::string, const Texture*>> TextureSet;
+
+        struct DrawGroup
+        {
+            MaterialParameters parameters;
+            Frustum frustum;
+            glm::vec3 cameraPosition;
+            bool cullBackfaces;
+        };
+
+        struct DrawItem
+        {
+            MeshPtr mesh;
+            MaterialPtr material;
+            ShaderPtr shader;
+            uint32 textureSet;
+            uint32 group;
+            uint32 level;
+            bool meshlets;
+        };
+
+        // Ids a material contributes to the key, worked out the first time it is submitted in a frame
+        struct MaterialKey
+        {
+            uint64 key;
+            uint32 textureSet;
+        };
+
+        // Draws what is queued so far, keeping the current group for the draws that follow
+        void flushPending();
+
+        std::vector<DrawGroup> groups;
+        std::vector<DrawItem> items;
+
+        // Sort keys along with the index of their draw, which also keeps draws with the same key in submission order
+        std::vector<std::pair<uint64, uint32>> order;
+
+        std::unordered_map<const Shader*, uint32> shaderIds;
+        std::map<TextureSet, uint32> textureSetIds;
+        std::unordered_map<const Material*, MaterialKey> materialKeys;
+        std::unordered_map<const Mesh*, uint32> meshIds;
+
+        RenderStats stats;
+    };
+}
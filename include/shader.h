@@ -98,6 +98,9 @@ namespace wake
 
         void use();
 
+        // Whether the shader declares the per-frame uniform block (see FrameUniforms).
+        bool hasFrameBlock() const;
+
         GLuint getProgram() const;
 
         GLuint getVertexShader() const;
@@ -110,6 +113,7 @@ namespace wake
         GLuint shaderProgram;
         GLuint vertexShader;
         GLuint fragmentShader;
+        bool frameBlock = false;
 
         Shader(GLuint shaderProgram, GLuint vertexShader, GLuint fragmentShader);
     };
@@ -15,11 +15,20 @@ namespace wake
     class Texture
     {
     public:
+        // Loads a texture through the texture cache (see texturecache.h), so loading the same file again returns the
+        // same texture for as long as it is in use.
         static TexturePtr load(const char* path);
 
+        // Decodes an image file that is already in memory. Doesn't go through the texture cache.
+        static TexturePtr decode(const unsigned char* data, size_t size, const std::string& path);
+
     public:
         Texture(unsigned char* data, int width, int height, int comp, const std::string& path);
 
+        // Takes a complete mip chain (see mipchain.h) and uploads every level as is instead of generating them. comp
+        // is the component count of the original image, the data is always RGBA.
+        Texture(unsigned char* data, int width, int height, int comp, int levelCount, const std::string& path);
+
         Texture();
 
         Texture(const Texture& other);
@@ -36,8 +45,19 @@ namespace wake
 
         int getComponentsPerPixel() const;
 
+        // Number of mip levels in getData(), 1 unless the texture was created from a mip chain.
+        int getLevelCount() const;
+
         const std::string& getPath() const;
 
+        // Whether the texture has been sent to OpenGL. Textures created while uploads are deferred (see
+        // setDeferUploads) aren't until upload() is called.
+        bool isUploaded() const;
+
+        // Uploads a texture created while uploads were deferred. Must be called on the main thread. bind() does this
+        // on its own if needed.
+        void upload();
+
         void bind();
 
         void generateMipMaps();
@@ -47,10 +67,13 @@ namespace wake
     private:
         void initializeData();
 
+        size_t getDataSize() const;
+
         unsigned char* data;
         int width;
         int height;
         int comp;
+        int levelCount = 1;
         std::string path;
 
         GLuint texture = 0;
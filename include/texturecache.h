@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "texture.h"
+#include "util.h"
+
+#define W_TEXTURE_CACHE (wake::TextureCache::get())
+
+namespace wake
+{
+    // Deduplicates textures loaded through Texture::load. Entries are keyed by normalized path and only hold weak
+    // references, so a texture is freed as soon as nothing else uses it and is reloaded the next time it is asked for.
+    //
+    // With content hashing enabled, files are also hashed before they are decoded, so the same image stored under
+    // different paths is only decoded (and kept in VRAM) once.
+    //
+    // The cache may be used from any thread. Concurrent loads of the same texture decode it once and share the result.
+    class TextureCache
+    {
+    public:
+        static TextureCache& get();
+
+    public:
+        TexturePtr load(const std::string& path);
+
+        // Returns the cached texture for path, or null if it isn't loaded. Doesn't count as a hit or a miss.
+        TexturePtr find(const std::string& path);
+
+        // Adds a texture that was created some other way (embedded in a WMDL file, for example) under its path.
+        void insert(TexturePtr texture);
+
+        bool getHashContents() const;
+
+        void setHashContents(bool hash);
+
+        uint64 getHits() const;
+
+        uint64 getMisses() const;
+
+        // Number of cached textures that are still alive.
+        size_t getSize() const;
+
+        void resetStats();
+
+        void clear();
+
+    private:
+        TextureCache();
+
+        TextureCache(const TextureCache& other) = delete;
+
+        TextureCache& operator=(const TextureCache& other) = delete;
+
+        TexturePtr findLocked(const std::string& key);
+
+        std::unordered_map<std::string, WeakPtr<Texture>> entries;
+        std::unordered_map<uint64, WeakPtr<Texture>> contents;
+
+        // Paths currently being decoded by some thread, others asking for them wait on the condition
+        std::unordered_set<std::string> loading;
+        std::condition_variable loaded;
+
+        mutable std::mutex mutex;
+        bool hashContents = false;
+        uint64 hits = 0;
+        uint64 misses = 0;
+    };
+}
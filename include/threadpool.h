@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#define W_THREAD_POOL (wake::ThreadPool::get())
+
+namespace wake
+{
+    // Fixed-size pool of worker threads that run tasks in the order they are submitted.
+    //
+    // Tasks that wait on other tasks must submit those through a TaskGroup and wait on them there, which runs the
+    // group's tasks on the waiting thread while no worker is free for them, so nested waits can't starve the pool.
+    class ThreadPool
+    {
+    public:
+        // Shared pool with one worker per hardware thread.
+        static ThreadPool& get();
+
+        // A queued task, run by whichever thread claims it first.
+        class Job
+        {
+        public:
+            Job(std::function<void()> run)
+                    : run(std::move(run))
+            {
+            }
+
+            // Runs the task unless another thread claimed it already. Returns whether it ran.
+            bool claimAndRun()
+            {
+                if (claimed.exchange(true))
+                    return false;
+
+                // Let go of whatever the task holds on to as soon as it is done
+                std::function<void()> task = std::move(run);
+                task();
+                return true;
+            }
+
+        private:
+            std::function<void()> run;
+            std::atomic<bool> claimed{false};
+        };
+
+        typedef std::shared_ptr<Job> JobPtr;
+
+        template<typename F>
+        static std::pair<JobPtr, std::future<typename std::result_of<F()>::type>> makeJob(F func)
+        {
+            typedef typename std::result_of<F()>::type Result;
+
+            auto task = std::make_shared<std::packaged_task<Result()>>(func);
+            std::future<Result> result = task->get_future();
+            return std::make_pair(std::make_shared<Job>([task]() { (*task)(); }), std::move(result));
+        }
+
+    public:
+        ThreadPool(size_t threadCount);
+
+        ~ThreadPool();
+
+        size_t getThreadCount() const;
+
+        template<typename F>
+        std::future<typename std::result_of<F()>::type> submit(F func)
+        {
+            auto job = makeJob(func);
+            enqueue(job.first);
+            return std::move(job.second);
+        }
+
+        void enqueue(JobPtr job);
+
+    private:
+        ThreadPool(const ThreadPool& other) = delete;
+
+        ThreadPool& operator=(const ThreadPool& other) = delete;
+
+        void workerLoop();
+
+        std::vector<std::thread> workers;
+        std::queue<JobPtr> tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping = false;
+    };
+
+    // Tasks submitted to a pool together, such as the chunks of one file. Waiting on one of them runs the group's own
+    // queued tasks on the calling thread until it is ready, but never anything else in the pool, so a load on the main
+    // thread doesn't end up running somebody else's background import. Only used from the thread that created it.
+    class TaskGroup
+    {
+    public:
+        TaskGroup(ThreadPool& pool = W_THREAD_POOL);
+
+        template<typename F>
+        std::future<typename std::result_of<F()>::type> submit(F func)
+        {
+            auto job = ThreadPool::makeJob(func);
+            jobs.push_back(job.first);
+            pool.enqueue(job.first);
+            return std::move(job.second);
+        }
+
+        template<typename T>
+        T wait(std::future<T>& future)
+        {
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                if (!runPendingTask())
+                {
+                    future.wait_for(std::chrono::milliseconds(1));
+                }
+            }
+
+            return future.get();
+        }
+
+        // Runs one of the group's tasks that no worker has started yet. Returns false if there aren't any.
+        bool runPendingTask();
+
+    private:
+        TaskGroup(const TaskGroup& other) = delete;
+
+        TaskGroup& operator=(const TaskGroup& other) = delete;
+
+        ThreadPool& pool;
+        std::deque<ThreadPool::JobPtr> jobs;
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace wake
@@ -13,4 +14,16 @@ namespace wake
     typedef int16_t int16;
     typedef int32_t int32;
     typedef int64_t int64;
+
+    // 64-bit FNV-1a
+    inline uint64 hashBytes(const char* data, size_t size, uint64 hash = 14695981039346656037ull)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= (uint8) data[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "util.h"
+
+namespace wake
+{
+    // Compact, lossy storage format for wake::Vertex used by WMDL:
+    // - positions as snorm16 relative to the center and half-extents of the mesh's bounding box
+    // - normals octahedral-encoded into two snorm16 values
+    // - texCoords as unorm16 relative to the range of texCoords used by the mesh
+    struct QuantizedVertex
+    {
+        int16 position[3];
+        int16 normal[2];
+        uint16 texCoords[2];
+        uint16 reserved;
+    };
+
+    static_assert(sizeof(QuantizedVertex) == 16, "wake::QuantizedVertex must be tightly packed");
+
+    // Per-mesh ranges the quantized values are relative to.
+    struct VertexQuantization
+    {
+        glm::vec3 positionCenter;
+        glm::vec3 positionExtent;
+        glm::vec2 texCoordMin;
+        glm::vec2 texCoordExtent;
+    };
+
+    // Largest difference between a set of vertices and their quantized round trip. The normal error is in degrees.
+    struct QuantizationError
+    {
+        float position = 0.0f;
+        float normal = 0.0f;
+        float texCoords = 0.0f;
+    };
+
+    VertexQuantization getVertexQuantization(const Vertex* vertices, size_t count);
+
+    void quantizeVertices(const Vertex* vertices, size_t count, const VertexQuantization& quantization,
+                          QuantizedVertex* out);
+
+    void dequantizeVertices(const QuantizedVertex* vertices, size_t count, const VertexQuantization& quantization,
+                            Vertex* out);
+
+    QuantizationError measureQuantizationError(const Vertex* vertices, size_t count);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "engineptr.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+#include "util.h"
+
+#define W_VFS (wake::VirtualFileSystem::get())
+
+// Number of threads that read files for asynchronous requests. Reads mostly wait on the disk, so these are kept apart
+// from the thread pool that decodes.
+#define W_VFS_IO_THREADS 4
+
+namespace wake
+{
+    class ReadRequest;
+
+    typedef SharedPtr<ReadRequest> ReadRequestPtr;
+
+    // Handle to a file being read by the VirtualFileSystem.
+    class ReadRequest
+    {
+    public:
+        ReadRequest(const std::string& path);
+
+        ~ReadRequest();
+
+        const std::string& getPath() const;
+
+        bool isDone() const;
+
+        // Blocks until the file has been read, returns null if it couldn't be opened.
+        MappedFilePtr wait() const;
+
+    private:
+        friend class VirtualFileSystem;
+
+        ReadRequest(const ReadRequest& other) = delete;
+
+        ReadRequest& operator=(const ReadRequest& other) = delete;
+
+        std::string path;
+        std::string key;
+        std::shared_future<MappedFilePtr> result;
+    };
+
+    // The one place asset loaders get files from. Files are looked up in the mounted archives first and then on disk
+    // (see archive.h), and always handed out as MappedFiles.
+    //
+    // readAsync queues a file on a pool of I/O threads, which open it and page all of it in. Loaders that know what
+    // they'll need can issue every read up front and decode each file as soon as it arrives, while the rest are still
+    // coming off the disk. While a request for a file is alive, every other read of that file (synchronous or not)
+    // shares its result instead of reading it again. readBatch issues its reads sorted by path, which for archives
+    // packed from a directory is the order the files are stored in.
+    //
+    // prefetch is a read-ahead hint: the OS starts reading the file into its cache in the background, but nothing is
+    // kept around and nobody waits for it.
+    //
+    // To speed up cold starts, a session can be recorded into a prefetch manifest that lists every file read in the
+    // order it was first needed, with the time since recording started and its size. Replaying the manifest on the
+    // next launch prefetches those files in the same order, so they are mostly in the OS cache by the time the loaders
+    // ask for them. The manifest is a text file:
+    //   wake-prefetch 1
+    //   <seconds> <size> <path>
+    //   ...
+    // Replaying only needs the paths, the times and sizes are there to show what startup spent its time loading.
+    //
+    // Everything may be used from any thread.
+    class VirtualFileSystem
+    {
+    public:
+        static VirtualFileSystem& get();
+
+    public:
+        // Opens a file on the calling thread, or waits for the read already in flight for it.
+        MappedFilePtr read(const std::string& path);
+
+        ReadRequestPtr readAsync(const std::string& path);
+
+        std::vector<ReadRequestPtr> readBatch(const std::vector<std::string>& paths);
+
+        void prefetch(const std::string& path);
+
+        // Number of read and readAsync calls, how many of them were served by a request that already existed, and the
+        // size of the files the I/O threads have read.
+        uint64 getRequestCount() const;
+
+        uint64 getCoalescedCount() const;
+
+        uint64 getBytesRead() const;
+
+        void resetStats();
+
+        // Records the first read of every file from now on. Restarting clears what was recorded.
+        void startRecording();
+
+        // Stops recording and writes the files read to a prefetch manifest. Returns false if it can't be written.
+        bool stopRecording(const std::string& manifestPath);
+
+        bool isRecording() const;
+
+        // Prefetches every file in a manifest in the background, in order. Returns the number of files, or 0 if the
+        // manifest can't be read.
+        size_t replay(const std::string& manifestPath);
+
+    private:
+        friend class ReadRequest;
+
+        VirtualFileSystem();
+
+        VirtualFileSystem(const VirtualFileSystem& other) = delete;
+
+        VirtualFileSystem& operator=(const VirtualFileSystem& other) = delete;
+
+        // Removes a request that is being destroyed, unless it has been replaced already.
+        void release(const std::string& key);
+
+        // Adds a file to the recording if this is its first read.
+        void record(const std::string& key, uint64 size);
+
+        struct RecordedRead
+        {
+            std::string path;
+            double seconds;
+            uint64 size;
+        };
+
+        std::mutex mutex;
+        std::unordered_map<std::string, std::weak_ptr<ReadRequest>> requests;
+
+        std::atomic<uint64> requestCount;
+        std::atomic<uint64> coalescedCount;
+        std::atomic<uint64> bytesRead;
+
+        std::atomic<bool> recording;
+        std::mutex recordMutex;
+        std::chrono::steady_clock::time_point recordingStart;
+        std::vector<RecordedRead> recorded;
+        std::unordered_set<std::string> recordedPaths;
+
+        // Last, so the I/O threads are stopped before anything they use is destroyed
+        ThreadPool io;
+    };
+}
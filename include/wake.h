@@ -22,6 +22,32 @@ namespace wake
 
     EngineMode getEngineMode();
 
+    // While set, meshes and textures created on the calling thread leave OpenGL alone until their upload() is called
+    // (or they are first drawn or bound) on the main thread. This is what lets models be loaded on worker threads.
+    void setDeferUploads(bool defer);
+
+    bool getDeferUploads();
+
+    // Defers uploads on the current thread for as long as it is alive. The previous setting is restored afterwards,
+    // since waiting on the thread pool may run a load inside of another task.
+    class DeferUploadsScope
+    {
+    public:
+        DeferUploadsScope()
+                : previous(getDeferUploads())
+        {
+            setDeferUploads(true);
+        }
+
+        ~DeferUploadsScope()
+        {
+            setDeferUploads(previous);
+        }
+
+    private:
+        bool previous;
+    };
+
     void setEngineArguments(const std::vector<std::string>& args);
 
     const std::vector<std::string>& getEngineArguments();
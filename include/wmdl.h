@@ -20,18 +20,105 @@
 // algorithm currently supported. It is highly recommended to use compression (the default), as it tends to heavily
 // reduce the file size and in many cases is faster to read than with uncompressed files (disk IO tends to slow things
 // down more than decompression, so compressed files tend to be faster to load).
+//
+// Since version 7 the payload starts at W_MDL_PAYLOAD_OFFSET and each mesh stores its vertices and indices as raw,
+// fixed-layout blobs (an array of wake::Vertex followed by an array of uint32 indices), each aligned to W_MDL_ALIGNMENT
+// bytes relative to the start of the payload. Uncompressed files are memory mapped when loaded, and each blob is copied
+// (or since version 9, decoded) from the mapping into the mesh's own arrays without reading the payload into a buffer
+// first.
+//
+// Version 8 adds chunked compression (W_MDL_FLAG_CHUNKED). Instead of compressing the payload as a single snappy
+// stream, it is split into W_MDL_CHUNK_SIZE blocks that are compressed independently and preceded by a block index.
+// Blocks are compressed and decompressed on the thread pool, and the loader starts parsing as soon as the first blocks
+// are ready instead of waiting for the whole payload to be decompressed.
+//
+// Version 9 adds a table of contents to the mesh section that records the material index and the offset/size of every
+// mesh's data within the payload. Meshes can be decoded independently of each other, so loadWMDL decodes them on the
+// thread pool and only constructs (and uploads) the wake::Mesh objects on the calling thread.
+//
+// Version 10 also stores the vertex and index counts of every mesh in the table of contents. This lets loadWMDL load a
+// model lazily: only the header, materials and mesh table are read, and each mesh decodes its data (decompressing just
+// the chunks it needs) the first time it is drawn or its data is queried. Older files are always loaded in full.
+//
+// Version 11 adds the byte shuffle filter (W_MDL_FLAG_SHUFFLE, see byteshuffle.h). When it is set, the vertex array of
+// every mesh is stored transposed so that each byte of each wake::Vertex member is grouped together, which compresses
+// much better than interleaved floats. The filter is lossless and only used together with compression.
+//
+// Version 12 records how each mesh's vertices are encoded in the mesh table. Vertices are either stored as full
+// wake::Vertex values (W_MDL_VERTEX_FLOAT) or quantized (W_MDL_VERTEX_QUANTIZED, see vertexquantization.h), which is
+// lossy but half the size. The table also keeps the wake::VertexFormat each mesh uploads its vertices in.
+//
+// Version 13 adds compact index encodings (see indexcodec.h), also recorded per mesh in the table: indices may be
+// stored as uint32 (W_MDL_INDEX_UINT32), as uint16 when every index fits (W_MDL_INDEX_UINT16), or delta coded as
+// zigzag varints preceded by their size in bytes (W_MDL_INDEX_DELTA). saveWMDL picks whichever is smallest.
+//
+// Version 14 shuffles vertex arrays in blocks of W_MDL_SHUFFLE_BLOCK_SIZE bytes instead of as a whole, so saveWMDL can
+// stream the payload to disk (compressing it a chunk at a time) without ever holding all of it in memory. The file is
+// written next to the destination and only moved into place once it is complete.
+//
+// Version 15 starts the payload with a texture section that may embed cooked textures: each one stores its original
+// path, size and pixel format (currently always W_MDL_TEXTURE_RGBA8) followed by its complete mip chain (see
+// mipchain.h), aligned to W_MDL_ALIGNMENT. Materials refer to embedded textures by their index in the section, and
+// only fall back to loading the texture from its path when it isn't embedded. Loading a model with embedded textures
+// needs no image decoding, and like the rest of the payload the textures are compressed with Snappy.
+//
+// Version 16 stores the levels of detail of every mesh (see wake::MeshLod) after its indices: their count, then the
+// error, index count and index encoding of each level, then each level's indices, encoded like the mesh's own.
+//
+// Version 17 adds every mesh's bounds (see bounds.h) to the mesh table, so lazily loaded meshes and models can be
+// culled and sorted before any of their vertices are decoded. Meshes from older files compute their bounds when loaded.
+//
+// Version 18 stores every mesh's meshlets (see wake::Meshlet) after its levels of detail: their count followed by the
+// index range, bounding sphere and normal cone of each one.
 
 #define W_MDL_CODE "WMDL3"
 #define W_MDL_MIN_VERSION ((wake::uint32) 3)
-#define W_MDL_MAX_VERSION ((wake::uint32) 6)
-#define W_MDL_VERSION ((wake::uint32) 6)
+#define W_MDL_MAX_VERSION ((wake::uint32) 18)
+#define W_MDL_VERSION ((wake::uint32) 18)
+
+#define W_MDL_ALIGNMENT ((size_t) 16)
+#define W_MDL_PAYLOAD_OFFSET ((size_t) 32)
+#define W_MDL_CHUNK_SIZE ((size_t) 256 * 1024)
+#define W_MDL_SHUFFLE_BLOCK_SIZE ((size_t) 64 * 1024)
 
 #define W_MDL_FLAG_NONE ((wake::uint64) 0)
 #define W_MDL_FLAG_COMPRESS ((wake::uint64) (1 << 0))
+#define W_MDL_FLAG_CHUNKED ((wake::uint64) (1 << 1))
+#define W_MDL_FLAG_SHUFFLE ((wake::uint64) (1 << 2))
+
+#define W_MDL_VERTEX_FLOAT ((wake::uint8) 0)
+#define W_MDL_VERTEX_QUANTIZED ((wake::uint8) 1)
+
+#define W_MDL_INDEX_UINT32 ((wake::uint8) 0)
+#define W_MDL_INDEX_UINT16 ((wake::uint8) 1)
+#define W_MDL_INDEX_DELTA ((wake::uint8) 2)
+
+#define W_MDL_TEXTURE_RGBA8 ((wake::uint8) 0)
 
 namespace wake
 {
+    struct WMDLSaveOptions
+    {
+        bool compress = true;
+
+        // Byte shuffle vertex data before compressing it. Has no effect if compress is false.
+        bool shuffle = true;
+
+        // Store vertices quantized (see vertexquantization.h). This is lossy, measureQuantizationError reports by how
+        // much.
+        bool quantize = false;
+
+        // Store indices as uint16 or delta coded when that is smaller than plain uint32 indices. This is lossless.
+        bool compactIndices = true;
+
+        // Embed every texture used by the model's materials along with a full mip chain, instead of just its path.
+        bool embedTextures = false;
+    };
+
+    bool saveWMDL(const char* path, ModelPtr model, const WMDLSaveOptions& options);
+
     bool saveWMDL(const char* path, ModelPtr model, bool compress = true);
 
-    ModelPtr loadWMDL(const char* path);
+    // If lazy is set, mesh data is left on disk (or in the mapping) until each mesh is first used.
+    ModelPtr loadWMDL(const char* path, bool lazy = false);
 }
\ No newline at end of file
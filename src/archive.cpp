@@ -0,0 +1,470 @@
+#include "archive.h"
+#include "binaryio.h"
+#include "fileutil.h"
+#include "luautil.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <unordered_set>
+
+#define W_ARCHIVE_ENTRY_SIZE 32
+
+namespace wake
+{
+    namespace
+    {
+        struct ArchiveEntry
+        {
+            uint64 hash = 0;
+            uint64 offset = 0;
+            uint64 size = 0;
+            uint32 nameOffset = 0;
+            uint32 nameLength = 0;
+        };
+
+        struct PackedFile
+        {
+            std::string path;
+            MappedFilePtr file;
+
+            // Precompiled script, replaces the contents of file when it isn't empty
+            std::string compiled;
+
+            const char* getData() const
+            {
+                return compiled.empty() ? file->getData() : compiled.data();
+            }
+
+            size_t getSize() const
+            {
+                return compiled.empty() ? file->getSize() : compiled.size();
+            }
+        };
+    }
+
+    // The index is read in place, and nothing in the mapping is guaranteed to be aligned
+    static uint32 readSlot(const char* slots, uint32 slot)
+    {
+        uint32 value;
+        memcpy(&value, slots + slot * sizeof(uint32), sizeof(uint32));
+        return value;
+    }
+
+    static ArchiveEntry readEntry(const char* entries, size_t index)
+    {
+        const char* data = entries + index * W_ARCHIVE_ENTRY_SIZE;
+
+        ArchiveEntry entry;
+        memcpy(&entry.hash, data, sizeof(uint64));
+        memcpy(&entry.offset, data + 8, sizeof(uint64));
+        memcpy(&entry.size, data + 16, sizeof(uint64));
+        memcpy(&entry.nameOffset, data + 24, sizeof(uint32));
+        memcpy(&entry.nameLength, data + 28, sizeof(uint32));
+        return entry;
+    }
+
+    ArchivePtr Archive::open(const char* path)
+    {
+        MappedFilePtr file = MappedFile::open(path);
+        if (file.get() == nullptr)
+        {
+            std::cout << "Archive::open error: unable to open \"" << path << "\"" << std::endl;
+            return ArchivePtr(nullptr);
+        }
+
+        ArchivePtr archive(new Archive());
+        archive->file = file;
+
+        try
+        {
+            BinaryReader f(file->getData(), file->getSize());
+
+            size_t codeLength = strlen(W_ARCHIVE_CODE);
+            std::string code(f.readBytes(codeLength), codeLength);
+            if (code != W_ARCHIVE_CODE)
+            {
+                std::cout << "Archive::open error: \"" << path << "\" has a bad header, expected " << W_ARCHIVE_CODE <<
+                ", got " << code << std::endl;
+                return ArchivePtr(nullptr);
+            }
+
+            uint32 version = f.readUInt32();
+            if (version != W_ARCHIVE_VERSION)
+            {
+                std::cout << "Archive::open error: \"" << path << "\" is version " << version << ", expected " <<
+                W_ARCHIVE_VERSION << std::endl;
+                return ArchivePtr(nullptr);
+            }
+
+            // The alignment and flags only matter when packing
+            f.readUInt32();
+            archive->entryCount = f.readUInt32();
+            archive->slotCount = f.readUInt32();
+            f.readUInt32();
+
+            uint64 namesOffset = f.readUInt64();
+            uint64 namesSize = f.readUInt64();
+
+            uint32 slotCount = archive->slotCount;
+            if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0 || slotCount < (uint64) archive->entryCount * 2)
+            {
+                std::cout << "Archive::open error: \"" << path << "\" has " << slotCount << " slots for " <<
+                archive->entryCount << " entries" << std::endl;
+                return ArchivePtr(nullptr);
+            }
+
+            archive->slots = f.readBytes(slotCount, sizeof(uint32));
+            archive->entries = f.readBytes(archive->entryCount, W_ARCHIVE_ENTRY_SIZE);
+
+            if (namesOffset > file->getSize() || namesSize > file->getSize() - namesOffset)
+            {
+                std::cout << "Archive::open error: \"" << path << "\" is truncated" << std::endl;
+                return ArchivePtr(nullptr);
+            }
+
+            f.seek((size_t) namesOffset);
+            archive->names = f.readBytes((size_t) namesSize);
+
+            // Check everything the lookups rely on once, so they don't have to
+            for (uint32 slot = 0; slot < slotCount; ++slot)
+            {
+                if (readSlot(archive->slots, slot) > archive->entryCount)
+                {
+                    std::cout << "Archive::open error: \"" << path << "\" has a corrupt index" << std::endl;
+                    return ArchivePtr(nullptr);
+                }
+            }
+
+            for (size_t i = 0; i < archive->entryCount; ++i)
+            {
+                ArchiveEntry entry = readEntry(archive->entries, i);
+                if ((uint64) entry.nameOffset + entry.nameLength > namesSize || entry.offset > file->getSize() ||
+                    entry.size > file->getSize() - entry.offset)
+                {
+                    std::cout << "Archive::open error: entry " << i << " of \"" << path << "\" is out of bounds" <<
+                    std::endl;
+                    return ArchivePtr(nullptr);
+                }
+            }
+        }
+        catch (std::exception& e)
+        {
+            std::cout << "Archive::open error: \"" << path << "\" is truncated" << std::endl;
+            return ArchivePtr(nullptr);
+        }
+
+        return archive;
+    }
+
+    Archive::Archive()
+    {
+    }
+
+    MappedFilePtr Archive::find(const std::string& path) const
+    {
+        size_t index = findEntry(normalizePath(path));
+        if (index == entryCount)
+            return MappedFilePtr(nullptr);
+
+        ArchiveEntry entry = readEntry(entries, index);
+        return MappedFile::view(file, (size_t) entry.offset, (size_t) entry.size, path);
+    }
+
+    bool Archive::contains(const std::string& path) const
+    {
+        return findEntry(normalizePath(path)) != entryCount;
+    }
+
+    size_t Archive::getEntryCount() const
+    {
+        return entryCount;
+    }
+
+    std::string Archive::getEntryPath(size_t index) const
+    {
+        if (index >= entryCount)
+            return "";
+
+        ArchiveEntry entry = readEntry(entries, index);
+        return std::string(names + entry.nameOffset, entry.nameLength);
+    }
+
+    const std::string& Archive::getPath() const
+    {
+        return file->getPath();
+    }
+
+    size_t Archive::findEntry(const std::string& path) const
+    {
+        uint64 hash = hashBytes(path.data(), path.size());
+        uint32 mask = slotCount - 1;
+        uint32 slot = (uint32) hash & mask;
+
+        // There is always an empty slot, but a corrupt index shouldn't be able to loop forever
+        for (uint32 probes = 0; probes < slotCount; ++probes, slot = (slot + 1) & mask)
+        {
+            uint32 value = readSlot(slots, slot);
+            if (value == 0)
+                break;
+
+            ArchiveEntry entry = readEntry(entries, value - 1);
+            if (entry.hash == hash && entry.nameLength == path.size() &&
+                memcmp(names + entry.nameOffset, path.data(), path.size()) == 0)
+            {
+                return value - 1;
+            }
+        }
+
+        return entryCount;
+    }
+
+    static int writeChunk(lua_State* L, const void* data, size_t size, void* userData)
+    {
+        ((std::string*) userData)->append((const char*) data, size);
+        return 0;
+    }
+
+    static bool isScript(const std::string& path)
+    {
+        return path.size() > 4 && path.compare(path.size() - 4, 4, ".lua") == 0;
+    }
+
+    static bool compileScript(lua_State* L, PackedFile& packed)
+    {
+        // Same chunk name luaL_loadfile would give it, so errors and tracebacks still point at the script
+        std::string chunkName = "@" + packed.path;
+        if (luaL_loadbuffer(L, packed.file->getData(), packed.file->getSize(), chunkName.c_str()) != 0)
+        {
+            std::cout << "packArchive error: unable to compile " << lua_tostring(L, -1) << std::endl;
+            lua_pop(L, 1);
+            return false;
+        }
+
+        lua_dump(L, writeChunk, &packed.compiled);
+        lua_pop(L, 1);
+        return true;
+    }
+
+    static bool writeArchive(const std::string& path, const std::vector<PackedFile>& files)
+    {
+        uint32 entryCount = (uint32) files.size();
+        uint32 slotCount = 2;
+        while (slotCount < (uint64) entryCount * 2)
+        {
+            slotCount *= 2;
+        }
+
+        std::string names;
+        std::vector<ArchiveEntry> entries(files.size());
+        std::vector<uint32> slots(slotCount, 0);
+        for (uint32 i = 0; i < entryCount; ++i)
+        {
+            ArchiveEntry& entry = entries[i];
+            entry.hash = hashBytes(files[i].path.data(), files[i].path.size());
+            entry.size = files[i].getSize();
+            entry.nameOffset = (uint32) names.size();
+            entry.nameLength = (uint32) files[i].path.size();
+            names += files[i].path;
+
+            uint32 slot = (uint32) entry.hash & (slotCount - 1);
+            while (slots[slot] != 0)
+            {
+                slot = (slot + 1) & (slotCount - 1);
+            }
+
+            slots[slot] = i + 1;
+        }
+
+        uint64 namesOffset = strlen(W_ARCHIVE_CODE) + 5 * sizeof(uint32) + 2 * sizeof(uint64) +
+                             slotCount * sizeof(uint32) + (uint64) entryCount * W_ARCHIVE_ENTRY_SIZE;
+        uint64 offset = namesOffset + names.size();
+        for (auto& entry : entries)
+        {
+            offset += (W_ARCHIVE_ALIGNMENT - offset % W_ARCHIVE_ALIGNMENT) % W_ARCHIVE_ALIGNMENT;
+            entry.offset = offset;
+            offset += entry.size;
+        }
+
+        BinaryWriter index;
+        index.writeBytes(W_ARCHIVE_CODE, strlen(W_ARCHIVE_CODE));
+        index.writeUInt32(W_ARCHIVE_VERSION);
+        index.writeUInt32(W_ARCHIVE_ALIGNMENT);
+        index.writeUInt32(entryCount);
+        index.writeUInt32(slotCount);
+        index.writeUInt32(0);
+        index.writeUInt64(namesOffset);
+        index.writeUInt64(names.size());
+        index.writeArray(slots.data(), slots.size());
+        for (auto& entry : entries)
+        {
+            index.writeUInt64(entry.hash);
+            index.writeUInt64(entry.offset);
+            index.writeUInt64(entry.size);
+            index.writeUInt32(entry.nameOffset);
+            index.writeUInt32(entry.nameLength);
+        }
+        index.writeBytes(names.data(), names.size());
+
+        std::ofstream f(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!f.is_open())
+        {
+            std::cout << "packArchive error: unable to open \"" << path << "\" for writing" << std::endl;
+            return false;
+        }
+
+        f.write(index.getBuffer().data(), index.getBuffer().size());
+        uint64 position = index.getPosition();
+
+        static const char padding[W_ARCHIVE_ALIGNMENT] = {};
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            f.write(padding, (std::streamsize) (entries[i].offset - position));
+            f.write(files[i].getData(), (std::streamsize) files[i].getSize());
+            position = entries[i].offset + entries[i].size;
+        }
+
+        if (!f.good())
+        {
+            std::cout << "packArchive error: unable to write \"" << path << "\"" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool packArchive(const std::string& input, const std::string& outputPath, const ArchiveOptions& options)
+    {
+        std::string root;
+        std::vector<std::string> paths;
+        if (isDirectory(input))
+        {
+            root = input;
+            listFiles(root, paths);
+        }
+        else if (!readManifest(input, root, paths))
+        {
+            std::cout << "packArchive error: unable to open \"" << input << "\"" << std::endl;
+            return false;
+        }
+
+        std::string tempPath = outputPath + ".tmp";
+        std::string output = normalizePath(outputPath);
+        std::string temp = normalizePath(tempPath);
+
+        lua_State* L = options.compileScripts ? luaL_newstate() : nullptr;
+        std::vector<PackedFile> files;
+        std::unordered_set<std::string> packed;
+        bool success = true;
+        for (auto& path : paths)
+        {
+            std::string sourcePath = root + "/" + path;
+
+            // An archive written inside the directory being packed shouldn't end up in the next one
+            std::string source = normalizePath(sourcePath);
+            if (source == output || source == temp)
+                continue;
+
+            PackedFile file;
+            file.path = normalizePath(options.prefix.empty() ? path : options.prefix + "/" + path);
+            if (!packed.insert(file.path).second)
+                continue;
+
+            file.file = MappedFile::open(sourcePath.c_str());
+            if (file.file.get() == nullptr)
+            {
+                std::cout << "packArchive error: unable to open \"" << sourcePath << "\"" << std::endl;
+                success = false;
+                break;
+            }
+
+            if (L != nullptr && isScript(file.path) && !compileScript(L, file))
+            {
+                success = false;
+                break;
+            }
+
+            files.push_back(file);
+        }
+
+        if (L != nullptr)
+            lua_close(L);
+
+        if (!success)
+            return false;
+
+        // Written next to the output first, so a failed pack leaves any existing archive alone
+        if (!writeArchive(tempPath, files))
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+
+        if (!replaceFile(tempPath, outputPath))
+        {
+            std::cout << "packArchive error: unable to replace \"" << outputPath << "\"" << std::endl;
+            std::remove(tempPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    static std::mutex& getMountMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<ArchivePtr>& getMounted()
+    {
+        static std::vector<ArchivePtr> archives;
+        return archives;
+    }
+
+    bool mountArchive(const char* path)
+    {
+        ArchivePtr archive = Archive::open(path);
+        if (archive.get() == nullptr)
+            return false;
+
+        std::lock_guard<std::mutex> lock(getMountMutex());
+        getMounted().insert(getMounted().begin(), archive);
+        return true;
+    }
+
+    void unmountArchives()
+    {
+        std::lock_guard<std::mutex> lock(getMountMutex());
+        getMounted().clear();
+    }
+
+    std::vector<ArchivePtr> getMountedArchives()
+    {
+        std::lock_guard<std::mutex> lock(getMountMutex());
+        return getMounted();
+    }
+
+    MappedFilePtr findArchiveFile(const std::string& path)
+    {
+        for (auto& archive : getMountedArchives())
+        {
+            MappedFilePtr file = archive->find(path);
+            if (file.get() != nullptr)
+                return file;
+        }
+
+        return MappedFilePtr(nullptr);
+    }
+
+    MappedFilePtr openAssetFile(const char* path)
+    {
+        MappedFilePtr file = findArchiveFile(path);
+        if (file.get() != nullptr)
+            return file;
+
+        return MappedFile::open(path);
+    }
+}
@@ -0,0 +1,278 @@
+#include "binaryio.h"
+
+#include <algorithm>
+#include <iostream>
+
+// TODO: Make everything host endian independent
+
+namespace wake
+{
+    BinaryReader::BinaryReader(const char* data, size_t size)
+            : data(data), size(size)
+    {
+    }
+
+    BinaryReader::~BinaryReader()
+    {
+    }
+
+    const char* BinaryReader::getData() const
+    {
+        return data;
+    }
+
+    size_t BinaryReader::getSize() const
+    {
+        return size;
+    }
+
+    size_t BinaryReader::getPosition() const
+    {
+        return position;
+    }
+
+    size_t BinaryReader::getRemaining() const
+    {
+        return size - position;
+    }
+
+    void BinaryReader::seek(size_t position)
+    {
+        if (position > size)
+        {
+            std::cout << "BinaryReader error: attempted to seek to " << position << " in a buffer of " << size <<
+            " bytes" << std::endl;
+            throw std::exception();
+        }
+
+        this->position = position;
+    }
+
+    const char* BinaryReader::readBytes(size_t count, size_t elementSize)
+    {
+        if (elementSize != 0 && count > getRemaining() / elementSize)
+        {
+            std::cout << "BinaryReader error: hit EOF while reading " << count << "x" << elementSize <<
+            " bytes at offset " << position << std::endl;
+            throw std::exception();
+        }
+
+        require(position, position + count * elementSize);
+
+        const char* bytes = data + position;
+        position += count * elementSize;
+        return bytes;
+    }
+
+    void BinaryReader::readPadding(size_t alignment)
+    {
+        readBytes((alignment - position % alignment) % alignment);
+    }
+
+    void BinaryReader::require(size_t begin, size_t end)
+    {
+    }
+
+    uint8 BinaryReader::readUInt8()
+    {
+        return readValue<uint8>();
+    }
+
+    uint32 BinaryReader::readUInt32()
+    {
+        return readValue<uint32>();
+    }
+
+    int32 BinaryReader::readInt32()
+    {
+        return readValue<int32>();
+    }
+
+    uint64 BinaryReader::readUInt64()
+    {
+        return readValue<uint64>();
+    }
+
+    float BinaryReader::readFloat()
+    {
+        return readValue<float>();
+    }
+
+    std::string BinaryReader::readString()
+    {
+        uint32 len = readUInt32();
+        const char* bytes = readBytes(len);
+        return std::string(bytes, len);
+    }
+
+    glm::vec2 BinaryReader::readVec2()
+    {
+        glm::vec2 val;
+        readArray(&val.x, 2);
+        return val;
+    }
+
+    glm::vec3 BinaryReader::readVec3()
+    {
+        glm::vec3 val;
+        readArray(&val.x, 3);
+        return val;
+    }
+
+    glm::vec4 BinaryReader::readVec4()
+    {
+        glm::vec4 val;
+        readArray(&val.x, 4);
+        return val;
+    }
+
+    glm::mat4 BinaryReader::readMatrix4()
+    {
+        glm::mat4 val;
+        val[0] = readVec4();
+        val[1] = readVec4();
+        val[2] = readVec4();
+        val[3] = readVec4();
+        return val;
+    }
+
+    BinaryWriter::BinaryWriter(size_t flushSize)
+            : flushSize(flushSize)
+    {
+    }
+
+    BinaryWriter::~BinaryWriter()
+    {
+    }
+
+    std::string& BinaryWriter::getBuffer()
+    {
+        return buffer;
+    }
+
+    size_t BinaryWriter::getPosition() const
+    {
+        return flushed + buffer.size();
+    }
+
+    void BinaryWriter::writeBytes(const void* bytes, size_t size)
+    {
+        if (flushSize == 0)
+        {
+            buffer.append((const char*) bytes, size);
+            return;
+        }
+
+        // Large writes go through in flushSize pieces so the buffer never has to hold all of them at once
+        const char* data = (const char*) bytes;
+        while (size > 0)
+        {
+            size_t length = std::min(size, flushSize - std::min(flushSize, buffer.size()));
+            buffer.append(data, length);
+            data += length;
+            size -= length;
+
+            flushFull();
+        }
+    }
+
+    char* BinaryWriter::allocateBytes(size_t size)
+    {
+        // Flush first so the returned pointer stays valid until the next write
+        flushFull();
+
+        size_t position = buffer.size();
+        buffer.resize(position + size);
+        return &buffer[0] + position;
+    }
+
+    void BinaryWriter::writePadding(size_t alignment)
+    {
+        size_t padding = (alignment - getPosition() % alignment) % alignment;
+        buffer.append(padding, '\0');
+        flushFull();
+    }
+
+    void BinaryWriter::flush(const char* data, size_t size)
+    {
+    }
+
+    void BinaryWriter::flushRemaining()
+    {
+        flushFull();
+
+        flush(buffer.data(), buffer.size());
+        flushed += buffer.size();
+        buffer.clear();
+    }
+
+    void BinaryWriter::flushFull()
+    {
+        if (flushSize == 0 || buffer.size() < flushSize)
+            return;
+
+        size_t offset = 0;
+        while (buffer.size() - offset >= flushSize)
+        {
+            flush(buffer.data() + offset, flushSize);
+            offset += flushSize;
+        }
+
+        buffer.erase(0, offset);
+        flushed += offset;
+    }
+
+    void BinaryWriter::writeUInt8(uint8 val)
+    {
+        writeBytes(&val, sizeof(val));
+    }
+
+    void BinaryWriter::writeUInt32(uint32 val)
+    {
+        writeBytes(&val, sizeof(val));
+    }
+
+    void BinaryWriter::writeInt32(int32 val)
+    {
+        writeBytes(&val, sizeof(val));
+    }
+
+    void BinaryWriter::writeUInt64(uint64 val)
+    {
+        writeBytes(&val, sizeof(val));
+    }
+
+    void BinaryWriter::writeFloat(float val)
+    {
+        writeBytes(&val, sizeof(val));
+    }
+
+    void BinaryWriter::writeString(const std::string& val)
+    {
+        writeUInt32((uint32) val.size());
+        writeBytes(val.data(), val.size());
+    }
+
+    void BinaryWriter::writeVec2(const glm::vec2& val)
+    {
+        writeArray(&val.x, 2);
+    }
+
+    void BinaryWriter::writeVec3(const glm::vec3& val)
+    {
+        writeArray(&val.x, 3);
+    }
+
+    void BinaryWriter::writeVec4(const glm::vec4& val)
+    {
+        writeArray(&val.x, 4);
+    }
+
+    void BinaryWriter::writeMatrix4(const glm::mat4& val)
+    {
+        writeVec4(val[0]);
+        writeVec4(val[1]);
+        writeVec4(val[2]);
+        writeVec4(val[3]);
+    }
+}
\ No newline at end of file
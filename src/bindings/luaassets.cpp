@@ -1,120 +1,381 @@
 #include "bindings/luaassets.h"
 #include "bindings/luatexture.h"
 #include "bindings/luamodel.h"
+#include "bindings/luamodelrequest.h"
+#include "bindings/luaevent.h"
 #include "moduleregistry.h"
+#include "archive.h"
+#include "modelloader.h"
+#include "cooker.h"
+#include "meshopt.h"
 #include "wmdl.h"
+#include "vertexquantization.h"
+#include "texturecache.h"
+#include "vfs.h"
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#include <algorithm>
 #include <iostream>
 
 namespace wake
 {
     namespace bindings
     {
-        //
-        // Model loading is currently implemented here until we have an actual Model class.
-        // Eventually it will be moved to a static method on the model class so it can be
-        // easily accessed from C++ as well as Lua.
-        //
+        // Reads an optional boolean from a table of options, leaving value alone if it isn't set
+        static void getBooleanField(lua_State* L, int index, const char* name, bool& value)
+        {
+            lua_getfield(L, index, name);
+            if (!lua_isnil(L, -1))
+                value = lua_toboolean(L, -1) != 0;
+            lua_pop(L, 1);
+        }
 
-        static int loadAssimpModel(lua_State* L, const char* path)
+        // The argument at index is either the lazy flag or a table of options
+        static void getLoadOptions(lua_State* L, int index, bool& lazy, bool& optimize)
         {
-            Assimp::Importer importer;
-            const aiScene* scene = importer.ReadFile(path,
-                                                     aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
+            lazy = false;
+            optimize = true;
+            if (lua_istable(L, index))
+            {
+                getBooleanField(L, index, "lazy", lazy);
+                getBooleanField(L, index, "optimize", optimize);
+            }
+            else if (lua_gettop(L) >= index)
+            {
+                lazy = lua_toboolean(L, index) != 0;
+            }
+        }
 
-            if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        static int loadModel(lua_State* L)
+        {
+            const char* path = luaL_checkstring(L, 1);
+
+            bool lazy, optimize;
+            getLoadOptions(L, 2, lazy, optimize);
+
+            pushValue(L, wake::loadModel(path, lazy, optimize));
+            return 1;
+        }
+
+        // Returns a ModelRequest right away, the model is loaded in the background (see modelloader.h)
+        static int loadModelAsync(lua_State* L)
+        {
+            const char* path = luaL_checkstring(L, 1);
+
+            bool lazy, optimize;
+            getLoadOptions(L, 2, lazy, optimize);
+
+            pushValue(L, W_MODEL_LOADER.loadAsync(path, lazy, optimize));
+            return 1;
+        }
+
+        static int saveModel(lua_State* L)
+        {
+            const char* path = luaL_checkstring(L, 1);
+            ModelPtr model = luaW_checkmodel(L, 2);
+
+            // The third argument is either the compress flag or a table of options
+            WMDLSaveOptions options;
+            if (lua_istable(L, 3))
             {
-                std::cout << "loadModel error: " << importer.GetErrorString() << std::endl;
-                lua_pushnil(L);
-                return 1;
+                getBooleanField(L, 3, "compress", options.compress);
+                getBooleanField(L, 3, "shuffle", options.shuffle);
+                getBooleanField(L, 3, "quantize", options.quantize);
+                getBooleanField(L, 3, "compactIndices", options.compactIndices);
+                getBooleanField(L, 3, "embedTextures", options.embedTextures);
             }
+            else if (lua_gettop(L) >= 3)
+            {
+                options.compress = lua_toboolean(L, 3) != 0;
+            }
+
+            lua_pushboolean(L, saveWMDL(path, model, options) ? 1 : 0);
+
+            return 1;
+        }
 
-            ModelPtr model(new Model());
-            for (size_t i = 0; i < scene->mNumMeshes; ++i)
+        // Returns the largest error quantizing the model's vertices would introduce, across all of its meshes
+        static int getQuantizationError(lua_State* L)
+        {
+            ModelPtr model = luaW_checkmodel(L, 1);
+
+            QuantizationError error;
+            for (auto& meshInfo : model->getMeshes())
             {
-                aiMesh* mesh = scene->mMeshes[i];
+                if (meshInfo.mesh.get() == nullptr)
+                    continue;
 
-                std::vector<Vertex> vertices;
-                std::vector<GLuint> indices;
+                auto& vertices = meshInfo.mesh->getVertices();
+                QuantizationError meshError = measureQuantizationError(vertices.data(), vertices.size());
+                error.position = std::max(error.position, meshError.position);
+                error.normal = std::max(error.normal, meshError.normal);
+                error.texCoords = std::max(error.texCoords, meshError.texCoords);
+            }
 
-                for (size_t v = 0; v < mesh->mNumVertices; ++v)
-                {
-                    aiVector3D& position = mesh->mVertices[v];
-                    aiVector3D& normal = mesh->mNormals[v];
+            lua_newtable(L);
 
-                    Vertex vertex;
-                    vertex.position = glm::vec3(position.x, position.y, position.z);
-                    vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
+            lua_pushstring(L, "position");
+            lua_pushnumber(L, error.position);
+            lua_settable(L, -3);
 
-                    if (mesh->mTextureCoords[0])
-                    {
-                        vertex.texCoords = glm::vec2(mesh->mTextureCoords[0][v].x, mesh->mTextureCoords[0][v].y);
-                    }
+            lua_pushstring(L, "normal");
+            lua_pushnumber(L, error.normal);
+            lua_settable(L, -3);
 
-                    vertices.push_back(vertex);
-                }
+            lua_pushstring(L, "texCoords");
+            lua_pushnumber(L, error.texCoords);
+            lua_settable(L, -3);
+
+            return 1;
+        }
+
+        // Runs the full mesh optimization pipeline on every mesh of the model and returns what it changed
+        static int optimizeModel(lua_State* L)
+        {
+            ModelPtr model = luaW_checkmodel(L, 1);
+            MeshOptimizationStats stats = wake::optimizeModel(model);
+
+            lua_newtable(L);
+
+            lua_pushstring(L, "vertexCountBefore");
+            lua_pushnumber(L, (lua_Number) stats.vertexCountBefore);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "vertexCountAfter");
+            lua_pushnumber(L, (lua_Number) stats.vertexCountAfter);
+            lua_settable(L, -3);
 
-                for (size_t v = 0; v < mesh->mNumFaces; ++v)
+            lua_pushstring(L, "triangleCount");
+            lua_pushnumber(L, (lua_Number) stats.triangleCount);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "acmrBefore");
+            lua_pushnumber(L, stats.acmrBefore);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "acmrAfter");
+            lua_pushnumber(L, stats.acmrAfter);
+            lua_settable(L, -3);
+
+            return 1;
+        }
+
+        // Replaces the levels of detail of every mesh of the model, and returns how many levels were generated
+        static int generateLods(lua_State* L)
+        {
+            ModelPtr model = luaW_checkmodel(L, 1);
+
+            LodOptions options;
+            if (lua_istable(L, 2))
+            {
+                lua_getfield(L, 2, "errors");
+                if (lua_istable(L, -1))
                 {
-                    aiFace& face = mesh->mFaces[v];
-                    for (size_t f = 0; f < face.mNumIndices; ++f)
+                    options.errors.clear();
+                    for (size_t i = 1; i <= lua_objlen(L, -1); ++i)
                     {
-                        indices.push_back(face.mIndices[f]);
+                        lua_rawgeti(L, -1, (int) i);
+                        options.errors.push_back((float) luaL_checknumber(L, -1));
+                        lua_pop(L, 1);
                     }
                 }
+                lua_pop(L, 1);
+
+                lua_getfield(L, 2, "reduction");
+                if (lua_isnumber(L, -1))
+                    options.reduction = (float) lua_tonumber(L, -1);
+                lua_pop(L, 1);
+            }
+
+            lua_pushnumber(L, (lua_Number) wake::generateLods(model, options));
+            return 1;
+        }
+
+        // Replaces the meshlets of every mesh of the model, and returns how many were built
+        static int buildMeshlets(lua_State* L)
+        {
+            ModelPtr model = luaW_checkmodel(L, 1);
 
-                model->addMesh(MeshPtr(new Mesh(vertices, indices)), 0);
+            size_t maxVertices = W_MESHLET_MAX_VERTICES;
+            size_t maxTriangles = W_MESHLET_MAX_TRIANGLES;
+            if (lua_istable(L, 2))
+            {
+                lua_getfield(L, 2, "maxVertices");
+                if (lua_isnumber(L, -1))
+                    maxVertices = (size_t) lua_tonumber(L, -1);
+                lua_pop(L, 1);
+
+                lua_getfield(L, 2, "maxTriangles");
+                if (lua_isnumber(L, -1))
+                    maxTriangles = (size_t) lua_tonumber(L, -1);
+                lua_pop(L, 1);
             }
 
-            ModelMetadata metadata;
-            metadata.source = ModelMetadata::Assimp;
-            metadata.path = path;
+            lua_pushnumber(L, (lua_Number) wake::buildMeshlets(model, maxVertices, maxTriangles));
+            return 1;
+        }
+
+        // Cooks every model in a directory or manifest into WMDL files (see cooker.h) and returns a summary
+        static int cook(lua_State* L)
+        {
+            const char* input = luaL_checkstring(L, 1);
+            const char* output = luaL_checkstring(L, 2);
+
+            CookOptions options;
+            if (lua_istable(L, 3))
+            {
+                getBooleanField(L, 3, "compress", options.save.compress);
+                getBooleanField(L, 3, "shuffle", options.save.shuffle);
+                getBooleanField(L, 3, "quantize", options.save.quantize);
+                getBooleanField(L, 3, "compactIndices", options.save.compactIndices);
+                getBooleanField(L, 3, "embedTextures", options.save.embedTextures);
+                getBooleanField(L, 3, "optimize", options.optimize);
+                getBooleanField(L, 3, "lods", options.lods);
+                getBooleanField(L, 3, "meshlets", options.meshlets);
+                getBooleanField(L, 3, "force", options.force);
+
+                lua_getfield(L, 3, "cache");
+                if (lua_isstring(L, -1))
+                    options.cachePath = lua_tostring(L, -1);
+                lua_pop(L, 1);
+            }
+
+            CookSummary summary = cookAssets(input, output, options);
+
+            lua_newtable(L);
+
+            lua_pushstring(L, "inputCount");
+            lua_pushnumber(L, (lua_Number) summary.inputCount);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "cookedCount");
+            lua_pushnumber(L, (lua_Number) summary.cookedCount);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "cachedCount");
+            lua_pushnumber(L, (lua_Number) summary.cachedCount);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "failedCount");
+            lua_pushnumber(L, (lua_Number) summary.failedCount);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "bytesRead");
+            lua_pushnumber(L, (lua_Number) summary.bytesRead);
+            lua_settable(L, -3);
 
-            model->setMetadata(metadata);
+            lua_pushstring(L, "bytesWritten");
+            lua_pushnumber(L, (lua_Number) summary.bytesWritten);
+            lua_settable(L, -3);
 
-            pushValue(L, model);
+            lua_pushstring(L, "seconds");
+            lua_pushnumber(L, summary.seconds);
+            lua_settable(L, -3);
 
+            lua_pushstring(L, "failed");
+            lua_newtable(L);
+            for (size_t i = 0; i < summary.failed.size(); ++i)
+            {
+                lua_pushnumber(L, (lua_Number) (i + 1));
+                lua_pushstring(L, summary.failed[i].c_str());
+                lua_settable(L, -3);
+            }
+            lua_settable(L, -3);
+
+            return 1;
+        }
+
+        // Packs a directory or manifest into an archive (see archive.h), returns true if it succeeded
+        static int packArchive(lua_State* L)
+        {
+            const char* input = luaL_checkstring(L, 1);
+            const char* output = luaL_checkstring(L, 2);
+
+            ArchiveOptions options;
+            if (lua_istable(L, 3))
+            {
+                getBooleanField(L, 3, "compileScripts", options.compileScripts);
+
+                lua_getfield(L, 3, "prefix");
+                if (lua_isstring(L, -1))
+                    options.prefix = lua_tostring(L, -1);
+                lua_pop(L, 1);
+            }
+
+            lua_pushboolean(L, wake::packArchive(input, output, options));
             return 1;
         }
 
-        static int loadWakeModel(lua_State* L, const char* path)
+        static int mountArchive(lua_State* L)
         {
-            ModelPtr model = loadWMDL(path);
-            pushValue(L, model);
+            const char* path = luaL_checkstring(L, 1);
+            lua_pushboolean(L, wake::mountArchive(path));
             return 1;
         }
 
-        static int loadModel(lua_State* L)
+        static int unmountArchives(lua_State* L)
+        {
+            wake::unmountArchives();
+            return 0;
+        }
+
+        // Read-ahead hint for a file or a table of files that will be loaded soon (see vfs.h)
+        static int prefetch(lua_State* L)
         {
-            std::string path(luaL_checkstring(L, 1));
-            std::string::size_type pathPos = path.rfind('.');
-            if (pathPos != std::string::npos)
+            if (lua_istable(L, 1))
             {
-                std::string extension = path.substr(pathPos + 1);
-                if (extension == "wmdl")
+                for (size_t i = 1; i <= lua_objlen(L, 1); ++i)
                 {
-                    return loadWakeModel(L, path.c_str());
+                    lua_rawgeti(L, 1, (int) i);
+                    if (lua_isstring(L, -1))
+                        W_VFS.prefetch(lua_tostring(L, -1));
+                    lua_pop(L, 1);
                 }
             }
+            else
+            {
+                W_VFS.prefetch(luaL_checkstring(L, 1));
+            }
 
-            return loadAssimpModel(L, path.c_str());
+            return 0;
         }
 
-        static int saveModel(lua_State* L)
+        // Records the files read from now on, stopPrefetchRecording writes them to a prefetch manifest (see vfs.h)
+        static int startPrefetchRecording(lua_State* L)
+        {
+            W_VFS.startRecording();
+            return 0;
+        }
+
+        static int stopPrefetchRecording(lua_State* L)
         {
             const char* path = luaL_checkstring(L, 1);
-            ModelPtr model = luaW_checkmodel(L, 2);
+            lua_pushboolean(L, W_VFS.stopRecording(path));
+            return 1;
+        }
 
-            bool compress = true;
-            if (lua_gettop(L) >= 3)
-            {
-                compress = lua_toboolean(L, 3) != 0;
-            }
+        // Prefetches the files in a manifest in the background, returns how many there are
+        static int replayPrefetch(lua_State* L)
+        {
+            const char* path = luaL_checkstring(L, 1);
+            lua_pushnumber(L, (lua_Number) W_VFS.replay(path));
+            return 1;
+        }
 
-            lua_pushboolean(L, saveWMDL(path, model, compress) ? 1 : 0);
+        static int getFileSystemStats(lua_State* L)
+        {
+            lua_newtable(L);
+
+            lua_pushstring(L, "requests");
+            lua_pushnumber(L, (lua_Number) W_VFS.getRequestCount());
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "coalesced");
+            lua_pushnumber(L, (lua_Number) W_VFS.getCoalescedCount());
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "bytesRead");
+            lua_pushnumber(L, (lua_Number) W_VFS.getBytesRead());
+            lua_settable(L, -3);
 
             return 1;
         }
@@ -133,16 +394,63 @@ namespace wake
             return 1;
         }
 
+        static int getTextureCacheStats(lua_State* L)
+        {
+            lua_newtable(L);
+
+            lua_pushstring(L, "hits");
+            lua_pushnumber(L, (lua_Number) W_TEXTURE_CACHE.getHits());
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "misses");
+            lua_pushnumber(L, (lua_Number) W_TEXTURE_CACHE.getMisses());
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "size");
+            lua_pushnumber(L, (lua_Number) W_TEXTURE_CACHE.getSize());
+            lua_settable(L, -3);
+
+            return 1;
+        }
+
+        // Also matches textures by the hash of their file's contents, not just their path
+        static int setTextureCacheHashing(lua_State* L)
+        {
+            W_TEXTURE_CACHE.setHashContents(lua_toboolean(L, 1) != 0);
+            return 0;
+        }
+
         static const struct luaL_reg assetslib_f[] = {
                 {"loadModel",   loadModel},
+                {"loadModelAsync", loadModelAsync},
                 {"saveModel",   saveModel},
+                {"getQuantizationError", getQuantizationError},
+                {"optimizeModel", optimizeModel},
+                {"generateLods", generateLods},
+                {"buildMeshlets", buildMeshlets},
+                {"cook",        cook},
+                {"packArchive", packArchive},
+                {"mountArchive", mountArchive},
+                {"unmountArchives", unmountArchives},
+                {"prefetch",    prefetch},
+                {"getFileSystemStats", getFileSystemStats},
+                {"startPrefetchRecording", startPrefetchRecording},
+                {"stopPrefetchRecording", stopPrefetchRecording},
+                {"replayPrefetch", replayPrefetch},
                 {"loadTexture", loadTexture},
+                {"getTextureCacheStats", getTextureCacheStats},
+                {"setTextureCacheHashing", setTextureCacheHashing},
                 {NULL, NULL}
         };
 
         int luaopen_assets(lua_State* L)
         {
             luaL_register(L, "assets", assetslib_f);
+
+            lua_pushstring(L, "modelLoaded");
+            pushValue(L, W_MODEL_LOADER.LoadedEvent);
+            lua_settable(L, -3);
+
             return 1;
         }
 
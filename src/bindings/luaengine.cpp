@@ -1,6 +1,9 @@
 #include "bindings/luaengine.h"
 #include "bindings/luaevent.h"
+#include "frameuniforms.h"
+#include "glstate.h"
 #include "moduleregistry.h"
+#include "renderqueue.h"
 
 namespace wake
 {
@@ -70,6 +73,65 @@ namespace wake
             return 2;
         }
 
+        static int flushDraws(lua_State* L)
+        {
+            W_RENDER_QUEUE.flush();
+            return 0;
+        }
+
+        static int resetRenderStats(lua_State* L)
+        {
+            W_RENDER_QUEUE.resetStats();
+            return 0;
+        }
+
+        static int getRenderStats(lua_State* L)
+        {
+            const RenderStats& stats = W_RENDER_QUEUE.getStats();
+            lua_newtable(L);
+
+            lua_pushstring(L, "draws");
+            lua_pushnumber(L, (lua_Number) stats.draws);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "batches");
+            lua_pushnumber(L, (lua_Number) stats.batches);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "shaderChanges");
+            lua_pushnumber(L, (lua_Number) stats.shaderChanges);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "textureChanges");
+            lua_pushnumber(L, (lua_Number) stats.textureChanges);
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "stateChanges");
+            lua_pushnumber(L, (lua_Number) stats.getStateChanges());
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "frameUploads");
+            lua_pushnumber(L, (lua_Number) W_FRAME_UNIFORMS.getUploadCount());
+            lua_settable(L, -3);
+
+            return 1;
+        }
+
+        static int getGLStats(lua_State* L)
+        {
+            lua_newtable(L);
+
+            lua_pushstring(L, "issued");
+            lua_pushnumber(L, (lua_Number) W_GL_STATE.getIssuedCount());
+            lua_settable(L, -3);
+
+            lua_pushstring(L, "skipped");
+            lua_pushnumber(L, (lua_Number) W_GL_STATE.getSkippedCount());
+            lua_settable(L, -3);
+
+            return 1;
+        }
+
         static const struct luaL_reg wakelib_f[] = {
                 {"isRunning",           isRunning},
                 {"getTime",             getTime},
@@ -80,6 +142,10 @@ namespace wake
                 {"setWindowFullscreen", setWindowFullscreen},
                 {"setWindowTitle",      setWindowTitle},
                 {"getWindowSize",       getWindowSize},
+                {"flushDraws",          flushDraws},
+                {"getRenderStats",      getRenderStats},
+                {"resetRenderStats",    resetRenderStats},
+                {"getGLStats",          getGLStats},
                 {NULL, NULL}
         };
 
@@ -181,7 +181,7 @@ namespace wake
         {
             MaterialPtr material = luaW_checkmaterial(L, 1);
             const char* name = luaL_checkstring(L, 2);
-            auto& parameter = material->getParameter(name);
+            MaterialParameter parameter = material->getParameter(name);
             switch (parameter.type)
             {
                 default:
@@ -227,11 +227,11 @@ namespace wake
             auto& parameters = material->getParameters();
 
             lua_newtable(L);
-            for (auto entry : parameters)
+            for (size_t i = 0; i < parameters.getCount(); ++i)
             {
-                lua_pushstring(L, entry.first.data());
+                lua_pushstring(L, parameters.getName(i).c_str());
 
-                auto& parameter = entry.second;
+                MaterialParameter parameter = parameters.get(i);
                 switch (parameter.type)
                 {
                     default:
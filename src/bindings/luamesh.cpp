@@ -161,10 +161,124 @@ namespace wake
             return 0;
         }
 
+        static int mesh_get_vertex_count(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            lua_pushnumber(L, (lua_Number) mesh->getVertexCount());
+            return 1;
+        }
+
+        static int mesh_get_index_count(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            lua_pushnumber(L, (lua_Number) mesh->getIndexCount());
+            return 1;
+        }
+
+        static int mesh_is_loaded(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            lua_pushboolean(L, mesh->isLoaded() ? 1 : 0);
+            return 1;
+        }
+
+        static int mesh_has_load_failed(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            lua_pushboolean(L, mesh->hasLoadFailed() ? 1 : 0);
+            return 1;
+        }
+
+        static int mesh_load(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            mesh->load();
+            return 0;
+        }
+
+        static int mesh_get_vertex_format(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            switch (mesh->getVertexFormat())
+            {
+                default:
+                case VertexFormat::Float:
+                    lua_pushstring(L, "float");
+                    break;
+
+                case VertexFormat::Packed:
+                    lua_pushstring(L, "packed");
+                    break;
+
+                case VertexFormat::PackedHalf:
+                    lua_pushstring(L, "packed_half");
+                    break;
+            }
+
+            return 1;
+        }
+
+        static int mesh_set_vertex_format(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            const char* format = luaL_checkstring(L, 2);
+
+            if (strcmp(format, "float") == 0)
+                mesh->setVertexFormat(VertexFormat::Float);
+            else if (strcmp(format, "packed") == 0)
+                mesh->setVertexFormat(VertexFormat::Packed);
+            else if (strcmp(format, "packed_half") == 0)
+                mesh->setVertexFormat(VertexFormat::PackedHalf);
+            else
+                luaL_error(L, "Unknown vertex format %s", format);
+
+            return 0;
+        }
+
+        static int mesh_get_bounds(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            pushValue(L, mesh->getBounds());
+            return 1;
+        }
+
+        static int mesh_get_meshlet_count(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            lua_pushnumber(L, (lua_Number) mesh->getMeshlets().size());
+            return 1;
+        }
+
+        static int mesh_get_lod_count(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            lua_pushnumber(L, (lua_Number) mesh->getLodCount());
+            return 1;
+        }
+
+        // Levels of detail are numbered from 0 (the full mesh) like they are in C++, rather than being indices
+        static int mesh_get_lod_error(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            lua_pushnumber(L, (lua_Number) mesh->getLodError((size_t) luaL_checkinteger(L, 2)));
+            return 1;
+        }
+
+        static int mesh_get_lod_index_count(lua_State* L)
+        {
+            MeshPtr mesh = luaW_checkmesh(L, 1);
+            lua_pushnumber(L, (lua_Number) mesh->getLodIndices((size_t) luaL_checkinteger(L, 2)).size());
+            return 1;
+        }
+
         static int mesh_draw(lua_State* L)
         {
             MeshPtr mesh = luaW_checkmesh(L, 1);
-            mesh->draw();
+            size_t level = 0;
+            if (lua_gettop(L) > 1)
+                level = (size_t) luaL_checkinteger(L, 2);
+
+            mesh->draw(level);
             return 0;
         }
 
@@ -182,7 +296,7 @@ namespace wake
             MeshPtr mesh = luaW_checkmesh(L, 1);
 
             std::stringstream ss;
-            ss << "Mesh[" << mesh->getVertices().size() << "," << mesh->getIndices().size() << "]";
+            ss << "Mesh[" << mesh->getVertexCount() << "," << mesh->getIndexCount() << "]";
             auto str = ss.str();
             lua_pushstring(L, str.data());
             return 1;
@@ -194,6 +308,18 @@ namespace wake
                 {"setVertices", mesh_set_vertices},
                 {"getIndices",  mesh_get_indices},
                 {"setIndices",  mesh_set_indices},
+                {"getVertexCount", mesh_get_vertex_count},
+                {"getIndexCount", mesh_get_index_count},
+                {"isLoaded",    mesh_is_loaded},
+                {"load",        mesh_load},
+                {"hasLoadFailed", mesh_has_load_failed},
+                {"getVertexFormat", mesh_get_vertex_format},
+                {"setVertexFormat", mesh_set_vertex_format},
+                {"getBounds",   mesh_get_bounds},
+                {"getMeshletCount", mesh_get_meshlet_count},
+                {"getLodCount", mesh_get_lod_count},
+                {"getLodError", mesh_get_lod_error},
+                {"getLodIndexCount", mesh_get_lod_index_count},
                 {"draw",        mesh_draw},
                 {NULL, NULL}
         };
@@ -204,6 +330,18 @@ namespace wake
                 {"setVertices", mesh_set_vertices},
                 {"getIndices",  mesh_get_indices},
                 {"setIndices",  mesh_set_indices},
+                {"getVertexCount", mesh_get_vertex_count},
+                {"getIndexCount", mesh_get_index_count},
+                {"isLoaded",    mesh_is_loaded},
+                {"load",        mesh_load},
+                {"hasLoadFailed", mesh_has_load_failed},
+                {"getVertexFormat", mesh_get_vertex_format},
+                {"setVertexFormat", mesh_set_vertex_format},
+                {"getBounds",   mesh_get_bounds},
+                {"getMeshletCount", mesh_get_meshlet_count},
+                {"getLodCount", mesh_get_lod_count},
+                {"getLodError", mesh_get_lod_error},
+                {"getLodIndexCount", mesh_get_lod_index_count},
                 {"draw",        mesh_draw},
                 {"__gc",        mesh_m_gc},
                 {"__tostring",  mesh_m_tostring},
@@ -392,6 +530,33 @@ namespace wake
         lua_setmetatable(L, -2);
     }
 
+    void pushValue(lua_State* L, const Bounds& value)
+    {
+        if (value.empty)
+        {
+            lua_pushnil(L);
+            return;
+        }
+
+        lua_newtable(L);
+
+        lua_pushstring(L, "min");
+        pushValue(L, value.minimum);
+        lua_settable(L, -3);
+
+        lua_pushstring(L, "max");
+        pushValue(L, value.maximum);
+        lua_settable(L, -3);
+
+        lua_pushstring(L, "center");
+        pushValue(L, value.center);
+        lua_settable(L, -3);
+
+        lua_pushstring(L, "radius");
+        lua_pushnumber(L, value.radius);
+        lua_settable(L, -3);
+    }
+
     MeshPtr luaW_checkmesh(lua_State* L, int narg)
     {
         void* dataPtr = luaL_checkudata(L, narg, W_MT_MESH);
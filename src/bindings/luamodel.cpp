@@ -328,6 +328,41 @@ namespace wake
             return 1;
         }
 
+        static int getBounds(lua_State* L)
+        {
+            ModelPtr model = luaW_checkmodel(L, 1);
+            pushValue(L, model->getBounds());
+            return 1;
+        }
+
+        static int getMeshletCulling(lua_State* L)
+        {
+            ModelPtr model = luaW_checkmodel(L, 1);
+            lua_pushboolean(L, model->getMeshletCulling() ? 1 : 0);
+            return 1;
+        }
+
+        static int setMeshletCulling(lua_State* L)
+        {
+            ModelPtr model = luaW_checkmodel(L, 1);
+            model->setMeshletCulling(lua_toboolean(L, 2) != 0);
+            return 0;
+        }
+
+        static int getLodThreshold(lua_State* L)
+        {
+            ModelPtr model = luaW_checkmodel(L, 1);
+            lua_pushnumber(L, (lua_Number) model->getLodThreshold());
+            return 1;
+        }
+
+        static int setLodThreshold(lua_State* L)
+        {
+            ModelPtr model = luaW_checkmodel(L, 1);
+            model->setLodThreshold((float) luaL_checknumber(L, 2));
+            return 0;
+        }
+
         static int draw(lua_State* L)
         {
             ModelPtr model = luaW_checkmodel(L, 1);
@@ -381,6 +416,11 @@ namespace wake
                 {"setMeshMaterialByName", setMeshMaterialByName},
                 {"addMesh",               addMesh},
                 {"removeMesh",            removeMesh},
+                {"getBounds",             getBounds},
+                {"getMeshletCulling",     getMeshletCulling},
+                {"setMeshletCulling",     setMeshletCulling},
+                {"getLodThreshold",       getLodThreshold},
+                {"setLodThreshold",       setLodThreshold},
                 {"draw",                  draw},
                 {NULL, NULL}
         };
@@ -407,6 +447,11 @@ namespace wake
                 {"setMeshMaterialByName", setMeshMaterialByName},
                 {"addMesh",               addMesh},
                 {"removeMesh",            removeMesh},
+                {"getBounds",             getBounds},
+                {"getMeshletCulling",     getMeshletCulling},
+                {"setMeshletCulling",     setMeshletCulling},
+                {"getLodThreshold",       getLodThreshold},
+                {"setLodThreshold",       setLodThreshold},
                 {"draw",                  draw},
                 {"__tostring",            m_tostring},
                 {"__gc",                  m_gc},
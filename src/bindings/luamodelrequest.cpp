@@ -0,0 +1,152 @@
+#include "bindings/luamodelrequest.h"
+#include "bindings/luamodel.h"
+#include "moduleregistry.h"
+
+#include <new>
+#include <sstream>
+
+namespace wake
+{
+    namespace binding
+    {
+        struct ModelRequestContainer
+        {
+            ModelRequestPtr request;
+        };
+
+        static const char* getStatusName(ModelRequest::Status status)
+        {
+            switch (status)
+            {
+                case ModelRequest::Status::Loading:
+                    return "loading";
+
+                case ModelRequest::Status::Uploading:
+                    return "uploading";
+
+                case ModelRequest::Status::Ready:
+                    return "ready";
+
+                case ModelRequest::Status::Failed:
+                default:
+                    return "failed";
+            }
+        }
+
+        static int getPath(lua_State* L)
+        {
+            ModelRequestPtr request = luaW_checkmodelrequest(L, 1);
+            lua_pushstring(L, request->getPath().c_str());
+            return 1;
+        }
+
+        static int getStatus(lua_State* L)
+        {
+            ModelRequestPtr request = luaW_checkmodelrequest(L, 1);
+            lua_pushstring(L, getStatusName(request->getStatus()));
+            return 1;
+        }
+
+        static int isDone(lua_State* L)
+        {
+            ModelRequestPtr request = luaW_checkmodelrequest(L, 1);
+            lua_pushboolean(L, request->isDone() ? 1 : 0);
+            return 1;
+        }
+
+        static int getModel(lua_State* L)
+        {
+            ModelRequestPtr request = luaW_checkmodelrequest(L, 1);
+            pushValue(L, request->getModel());
+            return 1;
+        }
+
+        // Blocks until the request is done and returns the model (or nil if it failed to load)
+        static int wait(lua_State* L)
+        {
+            ModelRequestPtr request = luaW_checkmodelrequest(L, 1);
+            W_MODEL_LOADER.finish(request);
+            pushValue(L, request->getModel());
+            return 1;
+        }
+
+        static int m_tostring(lua_State* L)
+        {
+            ModelRequestPtr request = luaW_checkmodelrequest(L, 1);
+            std::stringstream ss;
+            ss << "ModelRequest(" << request->getPath() << ", " << getStatusName(request->getStatus()) << ")";
+            std::string str = ss.str();
+            lua_pushstring(L, str.c_str());
+            return 1;
+        }
+
+        static int m_gc(lua_State* L)
+        {
+            void* dataPtr = luaL_checkudata(L, 1, W_MT_MODEL_REQUEST);
+            luaL_argcheck(L, dataPtr != nullptr, 1, "'ModelRequest' expected");
+            ModelRequestContainer* container = (ModelRequestContainer*) dataPtr;
+            container->~ModelRequestContainer();
+            return 0;
+        }
+
+        static const struct luaL_reg modelrequestlib_f[] = {
+                {"getPath",   getPath},
+                {"getStatus", getStatus},
+                {"isDone",    isDone},
+                {"getModel",  getModel},
+                {"wait",      wait},
+                {NULL, NULL}
+        };
+
+        static const struct luaL_reg modelrequestlib_m[] = {
+                {"getPath",    getPath},
+                {"getStatus",  getStatus},
+                {"isDone",     isDone},
+                {"getModel",   getModel},
+                {"wait",       wait},
+                {"__gc",       m_gc},
+                {"__tostring", m_tostring},
+                {NULL, NULL}
+        };
+
+        int luaopen_modelrequest(lua_State* L)
+        {
+            luaL_newmetatable(L, W_MT_MODEL_REQUEST);
+
+            lua_pushstring(L, "__index");
+            lua_pushvalue(L, -2);
+            lua_settable(L, -3);
+
+            luaL_register(L, NULL, modelrequestlib_m);
+
+            luaL_register(L, "ModelRequest", modelrequestlib_f);
+            return 1;
+        }
+
+        W_REGISTER_MODULE(luaopen_modelrequest);
+    }
+
+    void pushValue(lua_State* L, ModelRequestPtr value)
+    {
+        if (value.get() == nullptr)
+        {
+            lua_pushnil(L);
+            return;
+        }
+
+        // Lua hands out raw memory, the container (and its SharedPtr) has to be constructed in it
+        void* data = lua_newuserdata(L, sizeof(binding::ModelRequestContainer));
+        auto* container = new (data) binding::ModelRequestContainer();
+        container->request = value;
+        luaL_getmetatable(L, W_MT_MODEL_REQUEST);
+        lua_setmetatable(L, -2);
+    }
+
+    ModelRequestPtr luaW_checkmodelrequest(lua_State* L, int narg)
+    {
+        void* dataPtr = luaL_checkudata(L, narg, W_MT_MODEL_REQUEST);
+        luaL_argcheck(L, dataPtr != nullptr, narg, "'ModelRequest' expected");
+        binding::ModelRequestContainer* container = (binding::ModelRequestContainer*) dataPtr;
+        return container->request;
+    }
+}
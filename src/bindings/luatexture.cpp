@@ -35,6 +35,13 @@ namespace wake
             return 1;
         }
 
+        static int getLevelCount(lua_State* L)
+        {
+            TexturePtr texture = luaW_checktexture(L, 1);
+            lua_pushinteger(L, (lua_Integer) texture->getLevelCount());
+            return 1;
+        }
+
         static int getPath(lua_State* L)
         {
             TexturePtr texture = luaW_checktexture(L, 1);
@@ -82,6 +89,7 @@ namespace wake
                 {"new",                   texture_new},
                 {"getSize",               getSize},
                 {"getComponentsPerPixel", getComponentsPerPixel},
+                {"getLevelCount",         getLevelCount},
                 {"getPath",               getPath},
                 {"generateMipMaps",       generateMipMaps},
                 {"use",                   activate},
@@ -91,6 +99,7 @@ namespace wake
         static const struct luaL_reg texturelib_m[] = {
                 {"getSize",               getSize},
                 {"getComponentsPerPixel", getComponentsPerPixel},
+                {"getLevelCount",         getLevelCount},
                 {"getPath",               getPath},
                 {"generateMipMaps",       generateMipMaps},
                 {"use",                   activate},
@@ -0,0 +1,206 @@
+#include "bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define W_BOUNDS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace wake
+{
+    static inline const float* getPosition(const char* data, size_t index, size_t stride)
+    {
+        return (const float*) (data + index * stride);
+    }
+
+#ifdef W_BOUNDS_SSE2
+    // Each position is loaded as a whole register (the fourth lane holds whatever follows it and is ignored), so the
+    // box needs one min and one max per position.
+    static void computeBoxSSE2(const char* data, size_t count, size_t stride, Bounds& bounds)
+    {
+        __m128 minimum = _mm_loadu_ps(getPosition(data, 0, stride));
+        __m128 maximum = minimum;
+
+        size_t i = 1;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 a = _mm_loadu_ps(getPosition(data, i, stride));
+            __m128 b = _mm_loadu_ps(getPosition(data, i + 1, stride));
+            __m128 c = _mm_loadu_ps(getPosition(data, i + 2, stride));
+            __m128 d = _mm_loadu_ps(getPosition(data, i + 3, stride));
+            minimum = _mm_min_ps(minimum, _mm_min_ps(_mm_min_ps(a, b), _mm_min_ps(c, d)));
+            maximum = _mm_max_ps(maximum, _mm_max_ps(_mm_max_ps(a, b), _mm_max_ps(c, d)));
+        }
+
+        for (; i < count; ++i)
+        {
+            __m128 a = _mm_loadu_ps(getPosition(data, i, stride));
+            minimum = _mm_min_ps(minimum, a);
+            maximum = _mm_max_ps(maximum, a);
+        }
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, minimum);
+        bounds.minimum = glm::vec3(lanes[0], lanes[1], lanes[2]);
+        _mm_storeu_ps(lanes, maximum);
+        bounds.maximum = glm::vec3(lanes[0], lanes[1], lanes[2]);
+    }
+
+    // Four positions at a time are transposed into x, y and z registers, so the squared distances come out together.
+    static float computeRadiusSquaredSSE2(const char* data, size_t count, size_t stride, const glm::vec3& center)
+    {
+        __m128 centerX = _mm_set1_ps(center.x);
+        __m128 centerY = _mm_set1_ps(center.y);
+        __m128 centerZ = _mm_set1_ps(center.z);
+        __m128 maxDistance = _mm_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(getPosition(data, i, stride));
+            __m128 y = _mm_loadu_ps(getPosition(data, i + 1, stride));
+            __m128 z = _mm_loadu_ps(getPosition(data, i + 2, stride));
+            __m128 w = _mm_loadu_ps(getPosition(data, i + 3, stride));
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+
+            __m128 dx = _mm_sub_ps(x, centerX);
+            __m128 dy = _mm_sub_ps(y, centerY);
+            __m128 dz = _mm_sub_ps(z, centerZ);
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            maxDistance = _mm_max_ps(maxDistance, distance);
+        }
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, maxDistance);
+        float result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+
+        for (; i < count; ++i)
+        {
+            const float* position = getPosition(data, i, stride);
+            glm::vec3 offset = glm::vec3(position[0], position[1], position[2]) - center;
+            result = std::max(result, glm::dot(offset, offset));
+        }
+
+        return result;
+    }
+#endif
+
+    Bounds computeBounds(const void* positions, size_t count, size_t stride)
+    {
+        Bounds bounds;
+        if (count == 0)
+            return bounds;
+
+        const char* data = (const char*) positions;
+        float radiusSquared = 0.0f;
+
+#ifdef W_BOUNDS_SSE2
+        if (stride >= sizeof(float) * 4)
+        {
+            computeBoxSSE2(data, count, stride, bounds);
+            bounds.center = (bounds.minimum + bounds.maximum) * 0.5f;
+            radiusSquared = computeRadiusSquaredSSE2(data, count, stride, bounds.center);
+        }
+        else
+#endif
+        {
+            const float* first = getPosition(data, 0, stride);
+            bounds.minimum = glm::vec3(first[0], first[1], first[2]);
+            bounds.maximum = bounds.minimum;
+            for (size_t i = 1; i < count; ++i)
+            {
+                const float* position = getPosition(data, i, stride);
+                glm::vec3 point(position[0], position[1], position[2]);
+                bounds.minimum = glm::min(bounds.minimum, point);
+                bounds.maximum = glm::max(bounds.maximum, point);
+            }
+
+            bounds.center = (bounds.minimum + bounds.maximum) * 0.5f;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float* position = getPosition(data, i, stride);
+                glm::vec3 offset = glm::vec3(position[0], position[1], position[2]) - bounds.center;
+                radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+            }
+        }
+
+        bounds.radius = std::sqrt(radiusSquared);
+        bounds.empty = false;
+        return bounds;
+    }
+
+    Bounds mergeBounds(const Bounds& a, const Bounds& b)
+    {
+        if (a.empty)
+            return b;
+
+        if (b.empty)
+            return a;
+
+        Bounds bounds;
+        bounds.minimum = glm::min(a.minimum, b.minimum);
+        bounds.maximum = glm::max(a.maximum, b.maximum);
+        bounds.empty = false;
+
+        // If one sphere holds the other it's the answer, otherwise the new sphere spans from the far side of one to the
+        // far side of the other
+        glm::vec3 offset = b.center - a.center;
+        float distance = glm::length(offset);
+        if (distance + b.radius <= a.radius)
+        {
+            bounds.center = a.center;
+            bounds.radius = a.radius;
+        }
+        else if (distance + a.radius <= b.radius)
+        {
+            bounds.center = b.center;
+            bounds.radius = b.radius;
+        }
+        else
+        {
+            bounds.radius = (distance + a.radius + b.radius) * 0.5f;
+            bounds.center = a.center + offset * ((bounds.radius - a.radius) / distance);
+        }
+
+        return bounds;
+    }
+
+    Frustum getFrustum(const glm::mat4& matrix)
+    {
+        // Each plane is the sum or difference of the matrix's last row and one of the others (Gribb and Hartmann)
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+        }
+
+        Frustum frustum;
+        for (int i = 0; i < 3; ++i)
+        {
+            frustum.planes[i * 2] = rows[3] + rows[i];
+            frustum.planes[i * 2 + 1] = rows[3] - rows[i];
+        }
+
+        for (auto& plane : frustum.planes)
+        {
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f)
+                plane = plane / length;
+        }
+
+        return frustum;
+    }
+
+    bool isSphereVisible(const Frustum& frustum, const glm::vec3& center, float radius)
+    {
+        for (auto& plane : frustum.planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+
+        return true;
+    }
+}
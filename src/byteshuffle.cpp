@@ -0,0 +1,137 @@
+#include "byteshuffle.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define W_BYTESHUFFLE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace wake
+{
+#ifdef W_BYTESHUFFLE_SSE2
+    // Treating the 64 bytes in r[0..3] as one array, moves the byte at index a (6 bits: 2 bits of register, 4 bits of
+    // position) to the index a rotated left by one bit.
+    static inline void rotateIndices(__m128i r[4])
+    {
+        __m128i a = _mm_unpacklo_epi8(r[0], r[2]);
+        __m128i b = _mm_unpackhi_epi8(r[0], r[2]);
+        __m128i c = _mm_unpacklo_epi8(r[1], r[3]);
+        __m128i d = _mm_unpackhi_epi8(r[1], r[3]);
+        r[0] = a;
+        r[1] = b;
+        r[2] = c;
+        r[3] = d;
+    }
+
+    // Each column of 16 four-byte words is a 16x4 byte matrix; byte b of word w lives at index 4w + b before the
+    // transpose and at 16b + w after it, which is a rotation of the index by four bits (or two bits to go back).
+    static size_t shuffleColumnsSSE2(const char* in, char* out, size_t count, size_t elementSize)
+    {
+        size_t blocks = count / 16 * 16;
+        alignas(16) char column[64];
+        __m128i r[4];
+
+        for (size_t i = 0; i < blocks; i += 16)
+        {
+            for (size_t w = 0; w < elementSize; w += 4)
+            {
+                for (size_t k = 0; k < 16; ++k)
+                {
+                    memcpy(column + k * 4, in + (i + k) * elementSize + w, 4);
+                }
+
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    r[k] = _mm_load_si128((const __m128i*) (column + k * 16));
+                }
+
+                rotateIndices(r);
+                rotateIndices(r);
+                rotateIndices(r);
+                rotateIndices(r);
+
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    _mm_storeu_si128((__m128i*) (out + (w + k) * count + i), r[k]);
+                }
+            }
+        }
+
+        return blocks;
+    }
+
+    static size_t unshuffleColumnsSSE2(const char* in, char* out, size_t count, size_t elementSize)
+    {
+        size_t blocks = count / 16 * 16;
+        alignas(16) char column[64];
+        __m128i r[4];
+
+        for (size_t i = 0; i < blocks; i += 16)
+        {
+            for (size_t w = 0; w < elementSize; w += 4)
+            {
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    r[k] = _mm_loadu_si128((const __m128i*) (in + (w + k) * count + i));
+                }
+
+                rotateIndices(r);
+                rotateIndices(r);
+
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    _mm_store_si128((__m128i*) (column + k * 16), r[k]);
+                }
+
+                for (size_t k = 0; k < 16; ++k)
+                {
+                    memcpy(out + (i + k) * elementSize + w, column + k * 4, 4);
+                }
+            }
+        }
+
+        return blocks;
+    }
+#endif
+
+    void shuffleBytes(const void* in, void* out, size_t count, size_t elementSize)
+    {
+        const char* src = (const char*) in;
+        char* dst = (char*) out;
+        size_t start = 0;
+
+#ifdef W_BYTESHUFFLE_SSE2
+        if (elementSize % 4 == 0)
+            start = shuffleColumnsSSE2(src, dst, count, elementSize);
+#endif
+
+        for (size_t i = start; i < count; ++i)
+        {
+            for (size_t j = 0; j < elementSize; ++j)
+            {
+                dst[j * count + i] = src[i * elementSize + j];
+            }
+        }
+    }
+
+    void unshuffleBytes(const void* in, void* out, size_t count, size_t elementSize)
+    {
+        const char* src = (const char*) in;
+        char* dst = (char*) out;
+        size_t start = 0;
+
+#ifdef W_BYTESHUFFLE_SSE2
+        if (elementSize % 4 == 0)
+            start = unshuffleColumnsSSE2(src, dst, count, elementSize);
+#endif
+
+        for (size_t i = start; i < count; ++i)
+        {
+            for (size_t j = 0; j < elementSize; ++j)
+            {
+                dst[i * elementSize + j] = src[j * count + i];
+            }
+        }
+    }
+}
@@ -0,0 +1,460 @@
+#include "cooker.h"
+#include "fileutil.h"
+#include "mappedfile.h"
+#include "meshopt.h"
+#include "modelloader.h"
+#include "threadpool.h"
+#include "wake.h"
+
+#include <assimp/Importer.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define W_COOK_CACHE_HEADER "wake-cook-cache 1"
+
+namespace wake
+{
+    namespace
+    {
+        struct CookRecord
+        {
+            uint64 key = 0;
+            uint64 hash = 0;
+            std::vector<std::pair<std::string, uint64>> dependencies;
+        };
+
+        struct CookResult
+        {
+            enum
+            {
+                Cooked,
+                Cached,
+                Failed
+            } status = Failed;
+
+            uint64 bytesRead = 0;
+            uint64 bytesWritten = 0;
+            CookRecord record;
+        };
+
+        // Hashes of the textures models depend on, shared between tasks since most textures are used by more than one
+        // model.
+        class DependencyHashes
+        {
+        public:
+            // Returns false if the file can't be read.
+            bool get(const std::string& path, uint64& hash)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto found = hashes.find(path);
+                    if (found != hashes.end())
+                    {
+                        hash = found->second;
+                        return true;
+                    }
+                }
+
+                MappedFilePtr file = MappedFile::open(path.c_str());
+                if (file.get() == nullptr)
+                    return false;
+
+                hash = hashBytes(file->getData(), file->getSize());
+
+                std::lock_guard<std::mutex> lock(mutex);
+                hashes[path] = hash;
+                return true;
+            }
+
+        private:
+            std::mutex mutex;
+            std::map<std::string, uint64> hashes;
+        };
+    }
+
+    static double getSeconds()
+    {
+        typedef std::chrono::duration<double> Seconds;
+        return std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static bool fileExists(const std::string& path)
+    {
+        std::ifstream file(path.c_str());
+        return file.good();
+    }
+
+    static uint64 getFileSize(const std::string& path)
+    {
+        std::ifstream file(path.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return 0;
+
+        std::streamoff size = file.tellg();
+        return size > 0 ? (uint64) size : 0;
+    }
+
+    // Creates every missing directory leading up to path, path itself included.
+    static bool makeDirectories(const std::string& path)
+    {
+        if (path.empty() || isDirectory(path))
+            return true;
+
+        std::string::size_type slash = path.find_last_of("/\\");
+        if (slash != std::string::npos && slash > 0 && !makeDirectories(path.substr(0, slash)))
+            return false;
+
+#ifdef _WIN32
+        return CreateDirectoryA(path.c_str(), NULL) != 0 || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+        return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+    }
+
+    static std::string getExtension(const std::string& path)
+    {
+        std::string::size_type dot = path.rfind('.');
+        std::string::size_type slash = path.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            return "";
+
+        std::string extension = path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension;
+    }
+
+    // Other formats keep their extension in the name, so cube.obj and cube.wmdl next to each other don't both end up in
+    // cube.wmdl.
+    static std::string getOutputPath(const std::string& outputDirectory, const std::string& input)
+    {
+        if (getExtension(input) == "wmdl")
+            return outputDirectory + "/" + input;
+
+        return outputDirectory + "/" + input + ".wmdl";
+    }
+
+    // Compared case insensitively, since that is how some file systems see them.
+    static std::string getCollisionKey(const std::string& outputPath)
+    {
+        std::string key = normalizePath(outputPath);
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        return key;
+    }
+
+    bool findCookInputs(const std::string& input, std::string& root, std::vector<std::string>& inputs)
+    {
+        if (isDirectory(input))
+        {
+            root = input;
+
+            std::vector<std::string> files;
+            listFiles(root, files);
+
+            Assimp::Importer importer;
+            for (auto& file : files)
+            {
+                std::string extension = getExtension(file);
+                if (extension == "wmdl" || (!extension.empty() && importer.IsExtensionSupported("." + extension)))
+                    inputs.push_back(file);
+            }
+
+            return true;
+        }
+
+        if (!readManifest(input, root, inputs))
+        {
+            std::cout << "cookAssets error: unable to open \"" << input << "\"" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    // The options and versions that went into an output. Anything that changes the output must change this.
+    static uint64 getCookKey(const CookOptions& options)
+    {
+        std::ostringstream key;
+        key << W_COOKER_VERSION << ' ' << W_MDL_VERSION << ' ' << options.save.compress << options.save.shuffle
+            << options.save.quantize << options.save.compactIndices << options.save.embedTextures << options.optimize
+            << options.lods << options.meshlets;
+
+        std::string value = key.str();
+        return hashBytes(value.data(), value.size());
+    }
+
+    // Returns false unless the whole field is a hexadecimal number.
+    static bool parseHex(const std::string& field, uint64& value)
+    {
+        if (field.empty() || !isxdigit((unsigned char) field[0]))
+            return false;
+
+        char* end = nullptr;
+        errno = 0;
+        value = std::strtoull(field.c_str(), &end, 16);
+        return errno == 0 && end == field.c_str() + field.size();
+    }
+
+    // Reads the records of a cache database into records, keyed by input path. A missing database is just empty, and
+    // lines that can't be parsed are skipped, so their inputs are cooked again.
+    static void readCookCache(const std::string& path, std::map<std::string, CookRecord>& records)
+    {
+        std::ifstream file(path.c_str());
+        std::string line;
+        if (!file.is_open() || !std::getline(file, line) || line != W_COOK_CACHE_HEADER)
+            return;
+
+        // input \t key \t hash [\t dependency \t hash]...
+        while (std::getline(file, line))
+        {
+            std::vector<std::string> fields;
+            std::istringstream stream(line);
+            std::string field;
+            while (std::getline(stream, field, '\t'))
+            {
+                fields.push_back(field);
+            }
+
+            if (fields.size() < 3 || fields.size() % 2 == 0)
+                continue;
+
+            CookRecord record;
+            bool valid = parseHex(fields[1], record.key) && parseHex(fields[2], record.hash);
+            for (size_t i = 3; valid && i < fields.size(); i += 2)
+            {
+                uint64 hash;
+                valid = parseHex(fields[i + 1], hash);
+                record.dependencies.push_back(std::make_pair(fields[i], hash));
+            }
+
+            if (valid)
+                records[fields[0]] = record;
+        }
+    }
+
+    static bool writeCookCache(const std::string& path, const std::map<std::string, CookRecord>& records)
+    {
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath.c_str(), std::ios::out | std::ios::trunc);
+            if (!file.is_open())
+                return false;
+
+            file << W_COOK_CACHE_HEADER << "\n" << std::hex;
+            for (auto& entry : records)
+            {
+                file << entry.first << '\t' << entry.second.key << '\t' << entry.second.hash;
+                for (auto& dependency : entry.second.dependencies)
+                {
+                    file << '\t' << dependency.first << '\t' << dependency.second;
+                }
+
+                file << "\n";
+            }
+
+            if (!file.good())
+                return false;
+        }
+
+        return replaceFile(tempPath, path);
+    }
+
+    static bool isUpToDate(const CookRecord& cached, const CookRecord& current, const std::string& outputPath,
+                           DependencyHashes& dependencyHashes)
+    {
+        if (cached.key != current.key || cached.hash != current.hash || !fileExists(outputPath))
+            return false;
+
+        for (auto& dependency : cached.dependencies)
+        {
+            uint64 hash;
+            if (!dependencyHashes.get(dependency.first, hash) || hash != dependency.second)
+                return false;
+        }
+
+        return true;
+    }
+
+    static CookResult cookModel(const std::string& inputPath, const std::string& outputPath,
+                                const CookRecord* cached, uint64 key, const CookOptions& options,
+                                DependencyHashes& dependencyHashes)
+    {
+        CookResult result;
+
+        MappedFilePtr file = MappedFile::open(inputPath.c_str());
+        if (file.get() == nullptr)
+        {
+            std::cout << "cookAssets error: unable to open \"" << inputPath << "\"" << std::endl;
+            return result;
+        }
+
+        result.record.key = key;
+        result.record.hash = hashBytes(file->getData(), file->getSize());
+        uint64 inputSize = file->getSize();
+
+        if (!options.force && cached != nullptr && isUpToDate(*cached, result.record, outputPath, dependencyHashes))
+        {
+            result.status = CookResult::Cached;
+            return result;
+        }
+
+        // Cooked models are only ever saved, so nothing they create may reach OpenGL from this thread
+        DeferUploadsScope scope;
+
+        ModelPtr model = loadModel(inputPath.c_str(), false, options.optimize);
+        if (model.get() == nullptr)
+            return result;
+
+        if (options.meshlets)
+            buildMeshlets(model);
+
+        if (options.lods)
+            generateLods(model);
+
+        for (auto& materialInfo : model->getMaterials())
+        {
+            if (materialInfo.material.get() == nullptr)
+                continue;
+
+            for (auto& entry : materialInfo.material->getTextures())
+            {
+                TexturePtr texture = entry.second.texture;
+                if (texture.get() == nullptr || texture->getPath().empty())
+                    continue;
+
+                auto& dependencies = result.record.dependencies;
+                const std::string& path = texture->getPath();
+                auto found = std::find_if(dependencies.begin(), dependencies.end(),
+                                          [&path](const std::pair<std::string, uint64>& dependency) {
+                                              return dependency.first == path;
+                                          });
+
+                uint64 hash;
+                if (found == dependencies.end() && dependencyHashes.get(path, hash))
+                    dependencies.push_back(std::make_pair(path, hash));
+            }
+        }
+
+        std::string::size_type slash = outputPath.find_last_of("/\\");
+        if (slash != std::string::npos && !makeDirectories(outputPath.substr(0, slash)))
+        {
+            std::cout << "cookAssets error: unable to create the directory for \"" << outputPath << "\"" << std::endl;
+            return result;
+        }
+
+        if (!saveWMDL(outputPath.c_str(), model, options.save))
+            return result;
+
+        result.status = CookResult::Cooked;
+        result.bytesRead = inputSize;
+        result.bytesWritten = getFileSize(outputPath);
+        return result;
+    }
+
+    CookSummary cookAssets(const std::string& input, const std::string& outputDirectory, const CookOptions& options)
+    {
+        CookSummary summary;
+        double start = getSeconds();
+
+        std::string root;
+        std::vector<std::string> inputs;
+        if (!findCookInputs(input, root, inputs) || !makeDirectories(outputDirectory))
+        {
+            summary.failed.push_back(input);
+            summary.failedCount = 1;
+            return summary;
+        }
+
+        std::string cachePath = options.cachePath.empty() ? outputDirectory + "/.cookcache" : options.cachePath;
+        std::map<std::string, CookRecord> records;
+        readCookCache(cachePath, records);
+
+        uint64 key = getCookKey(options);
+        DependencyHashes dependencyHashes;
+
+        // Inputs that would be written to the same output would overwrite each other, so none of them are cooked
+        std::map<std::string, size_t> outputCounts;
+        for (auto& path : inputs)
+        {
+            ++outputCounts[getCollisionKey(getOutputPath(outputDirectory, path))];
+        }
+
+        TaskGroup tasks;
+        std::vector<std::future<CookResult>> results;
+        for (auto& path : inputs)
+        {
+            std::string outputPath = getOutputPath(outputDirectory, path);
+            if (outputCounts[getCollisionKey(outputPath)] > 1)
+            {
+                std::cout << "cookAssets error: \"" << path << "\" shares its output \"" << outputPath <<
+                "\" with another input" << std::endl;
+
+                std::promise<CookResult> failed;
+                failed.set_value(CookResult());
+                results.push_back(failed.get_future());
+                continue;
+            }
+
+            auto found = records.find(path);
+            const CookRecord* cached = found != records.end() ? &found->second : nullptr;
+
+            std::string inputPath = root + "/" + path;
+            results.push_back(tasks.submit([inputPath, outputPath, cached, key, &options, &dependencyHashes]() {
+                return cookModel(inputPath, outputPath, cached, key, options, dependencyHashes);
+            }));
+        }
+
+        // Records are only replaced once every task is done, the tasks hold pointers into the old ones
+        std::vector<CookResult> finished;
+        for (auto& result : results)
+        {
+            finished.push_back(tasks.wait(result));
+        }
+
+        summary.inputCount = inputs.size();
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            CookResult& result = finished[i];
+            switch (result.status)
+            {
+                case CookResult::Cooked:
+                    ++summary.cookedCount;
+                    summary.bytesRead += result.bytesRead;
+                    summary.bytesWritten += result.bytesWritten;
+                    records[inputs[i]] = result.record;
+                    break;
+
+                case CookResult::Cached:
+                    ++summary.cachedCount;
+                    break;
+
+                case CookResult::Failed:
+                    ++summary.failedCount;
+                    summary.failed.push_back(inputs[i]);
+                    records.erase(inputs[i]);
+                    break;
+            }
+        }
+
+        if (!writeCookCache(cachePath, records))
+            std::cout << "cookAssets error: unable to write the cache to \"" << cachePath << "\"" << std::endl;
+
+        summary.seconds = getSeconds() - start;
+        return summary;
+    }
+}
@@ -1,4 +1,7 @@
 #include "engine.h"
+#include "glstate.h"
+#include "modelloader.h"
+#include "renderqueue.h"
 
 #include <iostream>
 #include <glm/glm.hpp>
@@ -53,6 +56,9 @@ namespace wake
 
         W_GL_CHECK();
 
+        // Nothing is known to be bound in a new context
+        W_GL_STATE.invalidate();
+
         if (!gl3wIsSupported(3, 3))
         {
             std::cout << "OpenGL 3.3 not supported on this system" << std::endl;
@@ -112,6 +118,11 @@ namespace wake
 
             glfwPollEvents();
 
+            W_RENDER_QUEUE.resetStats();
+
+            // Finish off models loaded in the background, a few uploads at a time
+            W_MODEL_LOADER.update(W_MODEL_LOADER.getUploadBudget());
+
             int displayW, displayH;
             glfwGetFramebufferSize(window, &displayW, &displayH);
             glViewport(0, 0, displayW, displayH);
@@ -124,6 +135,9 @@ namespace wake
 
             LateTickEvent.call(frameTime);
 
+            // Everything drawn during the ticks, sorted into batches
+            W_RENDER_QUEUE.flush();
+
             glfwSwapBuffers(window);
         }
 
@@ -0,0 +1,163 @@
+#include "fileutil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace wake
+{
+    std::string normalizePath(const std::string& path)
+    {
+        std::string prefix;
+        size_t start = 0;
+        if (path.size() >= 2 && path[1] == ':')
+        {
+            // Windows drive letter
+            prefix = path.substr(0, 2);
+            start = 2;
+        }
+
+        bool absolute = start < path.size() && (path[start] == '/' || path[start] == '\\');
+        if (absolute)
+            prefix += '/';
+
+        std::vector<std::string> components;
+        size_t position = start;
+        while (position <= path.size())
+        {
+            size_t end = path.find_first_of("/\\", position);
+            if (end == std::string::npos)
+                end = path.size();
+
+            std::string component = path.substr(position, end - position);
+            position = end + 1;
+
+            if (component.empty() || component == ".")
+                continue;
+
+            if (component == ".." && !components.empty() && components.back() != "..")
+            {
+                components.pop_back();
+                continue;
+            }
+
+            // Nothing is above the root
+            if (component == ".." && absolute)
+                continue;
+
+            components.push_back(component);
+        }
+
+        std::string result = prefix;
+        for (size_t i = 0; i < components.size(); ++i)
+        {
+            if (i > 0)
+                result += '/';
+
+            result += components[i];
+        }
+
+        return result.empty() ? "." : result;
+    }
+
+    bool isDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        DWORD attributes = GetFileAttributesA(path.c_str());
+        return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+    }
+
+    static void listFiles(const std::string& root, const std::string& relative, std::vector<std::string>& files)
+    {
+        std::string directory = relative.empty() ? root : root + "/" + relative;
+        std::vector<std::string> names;
+
+#ifdef _WIN32
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA((directory + "/*").c_str(), &data);
+        if (find == INVALID_HANDLE_VALUE)
+            return;
+
+        do
+        {
+            names.push_back(data.cFileName);
+        } while (FindNextFileA(find, &data));
+
+        FindClose(find);
+#else
+        DIR* dir = opendir(directory.c_str());
+        if (dir == nullptr)
+            return;
+
+        while (dirent* entry = readdir(dir))
+        {
+            names.push_back(entry->d_name);
+        }
+
+        closedir(dir);
+#endif
+
+        // Listing order depends on the file system, sorting keeps anything built from the listing stable
+        std::sort(names.begin(), names.end());
+        for (auto& name : names)
+        {
+            if (name == "." || name == "..")
+                continue;
+
+            std::string path = relative.empty() ? name : relative + "/" + name;
+            if (isDirectory(root + "/" + path))
+                listFiles(root, path, files);
+            else
+                files.push_back(path);
+        }
+    }
+
+    void listFiles(const std::string& root, std::vector<std::string>& files)
+    {
+        listFiles(root, "", files);
+    }
+
+    bool readManifest(const std::string& path, std::string& root, std::vector<std::string>& files)
+    {
+        std::ifstream manifest(path.c_str());
+        if (!manifest.is_open())
+            return false;
+
+        std::string::size_type slash = path.find_last_of("/\\");
+        root = slash != std::string::npos ? path.substr(0, slash) : ".";
+
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            line = line.substr(0, line.find('#'));
+
+            std::string::size_type start = line.find_first_not_of(" \t\r");
+            std::string::size_type end = line.find_last_not_of(" \t\r");
+            if (start != std::string::npos)
+                files.push_back(line.substr(start, end - start + 1));
+        }
+
+        return true;
+    }
+
+    bool replaceFile(const std::string& from, const std::string& to)
+    {
+#ifdef _WIN32
+        return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+}
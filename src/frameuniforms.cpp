@@ -0,0 +1,74 @@
+#include "frameuniforms.h"
+#include "glstate.h"
+#include "material.h"
+#include "wake.h"
+
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace wake
+{
+    static void packMatrix(MaterialPtr material, const char* name, GLfloat* out)
+    {
+        MaterialParameter param = material->getParameter(name);
+        if (param.type == MaterialParameter::Mat4)
+            memcpy(out, glm::value_ptr(param.m4), sizeof(GLfloat) * 16);
+    }
+
+    FrameUniforms& FrameUniforms::get()
+    {
+        static FrameUniforms instance;
+        return instance;
+    }
+
+    bool FrameUniforms::isMember(const std::string& name)
+    {
+        return name == "projection" || name == "view";
+    }
+
+    FrameUniforms::FrameUniforms()
+    {
+        glm::mat4 identity;
+        memcpy(block.projection, glm::value_ptr(identity), sizeof(block.projection));
+        memcpy(block.view, glm::value_ptr(identity), sizeof(block.view));
+    }
+
+    void FrameUniforms::update()
+    {
+        // Parameters that aren't set, or aren't matrices, keep what they had
+        Block next = block;
+        MaterialPtr global = Material::getGlobalMaterial();
+        packMatrix(global, "projection", next.projection);
+        packMatrix(global, "view", next.view);
+
+        if (uploaded && memcmp(&next, &block, sizeof(Block)) == 0)
+            return;
+
+        block = next;
+        uploaded = true;
+        ++uploadCount;
+
+        if (getEngineMode() != EngineMode::Normal)
+            return;
+
+        if (buffer == 0)
+        {
+            glGenBuffers(1, &buffer);
+            W_GL_STATE.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+            W_GL_STATE.bindBufferBase(GL_UNIFORM_BUFFER, W_FRAME_BLOCK_BINDING, buffer);
+        }
+        else
+        {
+            W_GL_STATE.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        }
+
+        W_GL_CHECK();
+    }
+
+    uint64 FrameUniforms::getUploadCount() const
+    {
+        return uploadCount;
+    }
+}
@@ -0,0 +1,181 @@
+#include "glstate.h"
+#include "wake.h"
+
+// Binding that isn't known, no GL object has this name
+#define W_GL_UNKNOWN ((GLuint) ~0u)
+
+namespace wake
+{
+    GLState& GLState::get()
+    {
+        static GLState instance;
+        return instance;
+    }
+
+    GLState::GLState()
+    {
+        invalidate();
+    }
+
+    bool GLState::change(GLuint& current, GLuint value)
+    {
+        if (current == value)
+        {
+            ++skippedCount;
+            return false;
+        }
+
+        current = value;
+        ++issuedCount;
+        return getEngineMode() == EngineMode::Normal;
+    }
+
+    void GLState::useProgram(GLuint program)
+    {
+        if (change(this->program, program))
+            glUseProgram(program);
+    }
+
+    void GLState::bindVertexArray(GLuint vertexArray)
+    {
+        if (change(this->vertexArray, vertexArray))
+            glBindVertexArray(vertexArray);
+    }
+
+    void GLState::bindBuffer(GLenum target, GLuint buffer)
+    {
+        GLuint untracked = W_GL_UNKNOWN;
+        GLuint* current = &untracked;
+        switch (target)
+        {
+            case GL_ARRAY_BUFFER:
+                current = &arrayBuffer;
+                break;
+
+            case GL_UNIFORM_BUFFER:
+                current = &uniformBuffer;
+                break;
+
+            case GL_ELEMENT_ARRAY_BUFFER:
+                if (vertexArray != W_GL_UNKNOWN)
+                {
+                    auto inserted = elementBuffers.insert(std::make_pair(vertexArray, W_GL_UNKNOWN));
+                    current = &inserted.first->second;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        if (change(*current, buffer))
+            glBindBuffer(target, buffer);
+    }
+
+    void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        ++issuedCount;
+        if (target == GL_UNIFORM_BUFFER)
+            uniformBuffer = buffer;
+
+        if (getEngineMode() == EngineMode::Normal)
+            glBindBufferBase(target, index, buffer);
+    }
+
+    void GLState::activeTexture(GLenum unit)
+    {
+        if (change(activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    void GLState::bindTexture(GLuint texture)
+    {
+        GLuint untracked = W_GL_UNKNOWN;
+        GLuint* current = activeUnit < W_GL_STATE_TEXTURE_UNITS ? &textures[activeUnit] : &untracked;
+
+        if (change(*current, texture))
+            glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    void GLState::deleteProgram(GLuint program)
+    {
+        // The program stays in use until another one is, but its name may be handed out again
+        if (this->program == program)
+            this->program = W_GL_UNKNOWN;
+
+        if (getEngineMode() == EngineMode::Normal)
+            glDeleteProgram(program);
+    }
+
+    void GLState::deleteVertexArray(GLuint vertexArray)
+    {
+        elementBuffers.erase(vertexArray);
+        if (this->vertexArray == vertexArray)
+            this->vertexArray = 0;
+
+        if (getEngineMode() == EngineMode::Normal)
+            glDeleteVertexArrays(1, &vertexArray);
+    }
+
+    void GLState::deleteBuffer(GLuint buffer)
+    {
+        if (arrayBuffer == buffer)
+            arrayBuffer = 0;
+
+        if (uniformBuffer == buffer)
+            uniformBuffer = 0;
+
+        // GL only detaches it from the bound vertex array, but once its name is reused the others don't have it either
+        for (auto& entry : elementBuffers)
+        {
+            if (entry.second == buffer)
+                entry.second = vertexArray == entry.first ? 0 : W_GL_UNKNOWN;
+        }
+
+        if (getEngineMode() == EngineMode::Normal)
+            glDeleteBuffers(1, &buffer);
+    }
+
+    void GLState::deleteTexture(GLuint texture)
+    {
+        for (GLuint& bound : textures)
+        {
+            if (bound == texture)
+                bound = 0;
+        }
+
+        if (getEngineMode() == EngineMode::Normal)
+            glDeleteTextures(1, &texture);
+    }
+
+    void GLState::invalidate()
+    {
+        program = W_GL_UNKNOWN;
+        vertexArray = W_GL_UNKNOWN;
+        arrayBuffer = W_GL_UNKNOWN;
+        uniformBuffer = W_GL_UNKNOWN;
+        activeUnit = W_GL_UNKNOWN;
+        for (GLuint& bound : textures)
+        {
+            bound = W_GL_UNKNOWN;
+        }
+
+        elementBuffers.clear();
+    }
+
+    uint64 GLState::getIssuedCount() const
+    {
+        return issuedCount;
+    }
+
+    uint64 GLState::getSkippedCount() const
+    {
+        return skippedCount;
+    }
+
+    void GLState::resetStats()
+    {
+        issuedCount = 0;
+        skippedCount = 0;
+    }
+}
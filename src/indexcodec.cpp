@@ -0,0 +1,169 @@
+#include "indexcodec.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define W_INDEXCODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace wake
+{
+    static inline uint32 zigzag(uint32 delta)
+    {
+        return (delta << 1) ^ (uint32) ((int32) delta >> 31);
+    }
+
+    static inline uint32 unzigzag(uint32 value)
+    {
+        return (value >> 1) ^ (0u - (value & 1));
+    }
+
+    uint32 getMaxIndex(const uint32* indices, size_t count)
+    {
+        uint32 result = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            result = std::max(result, indices[i]);
+        }
+
+        return result;
+    }
+
+    void narrowIndices(const uint32* indices, size_t count, uint16* out)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = (uint16) indices[i];
+        }
+    }
+
+    void widenIndices(const uint16* indices, size_t count, uint32* out)
+    {
+        size_t i = 0;
+
+#ifdef W_INDEXCODEC_SSE2
+        __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i values = _mm_loadu_si128((const __m128i*) (indices + i));
+            _mm_storeu_si128((__m128i*) (out + i), _mm_unpacklo_epi16(values, zero));
+            _mm_storeu_si128((__m128i*) (out + i + 4), _mm_unpackhi_epi16(values, zero));
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            out[i] = indices[i];
+        }
+    }
+
+    size_t getIndexDeltaSize(const uint32* indices, size_t count)
+    {
+        size_t size = 0;
+        uint32 previous = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32 value = zigzag(indices[i] - previous);
+            previous = indices[i];
+
+            size += 1;
+            while (value >= 0x80)
+            {
+                value >>= 7;
+                size += 1;
+            }
+        }
+
+        return size;
+    }
+
+    void encodeIndexDeltas(const uint32* indices, size_t count, std::string& out, uint32 previous)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32 value = zigzag(indices[i] - previous);
+            previous = indices[i];
+
+            while (value >= 0x80)
+            {
+                out.push_back((char) (value | 0x80));
+                value >>= 7;
+            }
+
+            out.push_back((char) value);
+        }
+    }
+
+#ifdef W_INDEXCODEC_SSE2
+    // Decodes 4 single-byte values (already widened to 32 bits) and returns the running total in every lane.
+    static inline __m128i decodeDeltas4(__m128i values, __m128i& previous)
+    {
+        __m128i one = _mm_set1_epi32(1);
+        __m128i deltas = _mm_xor_si128(_mm_srli_epi32(values, 1),
+                                       _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(values, one)));
+
+        // Inclusive prefix sum across the four lanes, then offset by the last index of the previous group
+        deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+        deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+        __m128i result = _mm_add_epi32(deltas, previous);
+
+        previous = _mm_shuffle_epi32(result, _MM_SHUFFLE(3, 3, 3, 3));
+        return result;
+    }
+#endif
+
+    bool decodeIndexDeltas(const char* data, size_t size, uint32* out, size_t count)
+    {
+        const uint8* bytes = (const uint8*) data;
+        size_t position = 0;
+        size_t i = 0;
+        uint32 previous = 0;
+
+        while (i < count)
+        {
+#ifdef W_INDEXCODEC_SSE2
+            // Fast path: 16 varints that are all a single byte
+            if (size - position >= 16 && count - i >= 16)
+            {
+                __m128i block = _mm_loadu_si128((const __m128i*) (bytes + position));
+                if (_mm_movemask_epi8(block) == 0)
+                {
+                    __m128i zero = _mm_setzero_si128();
+                    __m128i low = _mm_unpacklo_epi8(block, zero);
+                    __m128i high = _mm_unpackhi_epi8(block, zero);
+                    __m128i carry = _mm_set1_epi32((int) previous);
+
+                    _mm_storeu_si128((__m128i*) (out + i), decodeDeltas4(_mm_unpacklo_epi16(low, zero), carry));
+                    _mm_storeu_si128((__m128i*) (out + i + 4), decodeDeltas4(_mm_unpackhi_epi16(low, zero), carry));
+                    _mm_storeu_si128((__m128i*) (out + i + 8), decodeDeltas4(_mm_unpacklo_epi16(high, zero), carry));
+                    _mm_storeu_si128((__m128i*) (out + i + 12), decodeDeltas4(_mm_unpackhi_epi16(high, zero), carry));
+
+                    previous = out[i + 15];
+                    position += 16;
+                    i += 16;
+                    continue;
+                }
+            }
+#endif
+
+            // Slow path: one varint of up to 5 bytes
+            uint32 value = 0;
+            for (int shift = 0;; shift += 7)
+            {
+                if (position >= size || shift > 28)
+                    return false;
+
+                uint8 byte = bytes[position++];
+                value |= (uint32) (byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    break;
+            }
+
+            previous += unzigzag(value);
+            out[i++] = previous;
+        }
+
+        return true;
+    }
+}
@@ -2,10 +2,26 @@
 #include <tclap/CmdLine.h>
 
 #include "wake.h"
+#include "archive.h"
+#include "vfs.h"
 #include "scriptmanager.h"
 #include "engine.h"
 #include "input.h"
 
+bool mountArchives(const std::vector<std::string>& archives)
+{
+    for (auto& archive : archives)
+    {
+        if (!wake::mountArchive(archive.c_str()))
+        {
+            std::cout << "Unable to mount archive " << archive << "." << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
 int execute(bool testing, bool tool, const std::string& toolName, const std::vector<std::string>& args)
 {
     wake::setEngineArguments(args);
@@ -167,13 +183,36 @@ int main(int argc, char** argv)
 
         TCLAP::ValueArg<std::string> toolArg("x", "tool", "Tool script to run", false, "", "string", cmd);
 
+        TCLAP::MultiArg<std::string> archiveArg("a", "archive", "Archive to load assets and scripts from before the file system. Archives given later take precedence.", false, "string", cmd);
+
+        TCLAP::ValueArg<std::string> prefetchArg("", "prefetch", "Prefetch manifest to replay in the background while starting up", false, "", "string", cmd);
+
+        TCLAP::ValueArg<std::string> recordPrefetchArg("", "record-prefetch", "Write every file read during the session to a prefetch manifest on exit", false, "", "string", cmd);
+
         TCLAP::UnlabeledMultiArg<std::string> otherArgs("argument", "Additional arguments to pass to the engine", false, "string", cmd);
 
         cmd.parse(argc, argv);
 
         pause = pauseArg.getValue();
 
-        result = execute(testingArg.getValue(), toolArg.isSet(), toolArg.getValue(), otherArgs.getValue());
+        // Archives are mounted first so the prefetcher reads files from the same place the loaders will
+        if (mountArchives(archiveArg.getValue()))
+        {
+            if (prefetchArg.isSet())
+                W_VFS.replay(prefetchArg.getValue());
+
+            if (recordPrefetchArg.isSet())
+                W_VFS.startRecording();
+
+            result = execute(testingArg.getValue(), toolArg.isSet(), toolArg.getValue(), otherArgs.getValue());
+
+            if (recordPrefetchArg.isSet() && !W_VFS.stopRecording(recordPrefetchArg.getValue()))
+                std::cout << "Unable to write prefetch manifest " << recordPrefetchArg.getValue() << "." << std::endl;
+        }
+        else
+        {
+            result = 1;
+        }
     }
     catch (TCLAP::ArgException& e)
     {
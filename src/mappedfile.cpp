@@ -0,0 +1,213 @@
+#include "mappedfile.h"
+
+#include <iostream>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace wake
+{
+    static size_t getPageSize()
+    {
+#ifdef _WIN32
+        static size_t pageSize = []() {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return (size_t) info.dwPageSize;
+        }();
+#else
+        static size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+#endif
+        return pageSize;
+    }
+
+    MappedFilePtr MappedFile::open(const char* path)
+    {
+        MappedFilePtr file(new MappedFile());
+        file->path = path;
+
+#ifdef _WIN32
+        HANDLE fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                        FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (fileHandle != INVALID_HANDLE_VALUE)
+        {
+            LARGE_INTEGER fileSize;
+            if (GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart == 0)
+            {
+                CloseHandle(fileHandle);
+                return file;
+            }
+
+            HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mappingHandle != NULL)
+            {
+                void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+                if (view != NULL)
+                {
+                    file->fileHandle = fileHandle;
+                    file->mappingHandle = mappingHandle;
+                    file->data = (const char*) view;
+                    file->size = (size_t) fileSize.QuadPart;
+                    file->mapped = true;
+                    return file;
+                }
+
+                CloseHandle(mappingHandle);
+            }
+
+            CloseHandle(fileHandle);
+        }
+#else
+        // Nothing to fall back on if the file can't be opened at all, and missing files are common (module searches)
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return MappedFilePtr(nullptr);
+
+        struct stat info;
+        if (fstat(fd, &info) == 0)
+        {
+            if (S_ISDIR(info.st_mode))
+            {
+                close(fd);
+                return MappedFilePtr(nullptr);
+            }
+
+            if (info.st_size == 0)
+            {
+                close(fd);
+                return file;
+            }
+
+            void* view = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED)
+            {
+                // The mapping keeps its own reference to the file.
+                close(fd);
+
+                file->data = (const char*) view;
+                file->size = (size_t) info.st_size;
+                file->mapped = true;
+                return file;
+            }
+        }
+
+        close(fd);
+#endif
+
+        // Mapping isn't available (or failed), fall back to reading the file into memory.
+        std::fstream f(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!f.is_open())
+        {
+            return MappedFilePtr(nullptr);
+        }
+
+        std::streamoff length = f.tellg();
+        if (length < 0)
+        {
+            std::cout << "MappedFile::open error: unable to determine the size of \"" << path << "\"" << std::endl;
+            return MappedFilePtr(nullptr);
+        }
+
+        file->buffer.resize((size_t) length);
+        f.seekg(0, std::ios::beg);
+        if (length > 0 && !f.read(file->buffer.data(), length))
+        {
+            std::cout << "MappedFile::open error: unable to read \"" << path << "\"" << std::endl;
+            return MappedFilePtr(nullptr);
+        }
+
+        file->data = file->buffer.data();
+        file->size = file->buffer.size();
+        return file;
+    }
+
+    MappedFilePtr MappedFile::view(const MappedFilePtr& file, size_t offset, size_t size, const std::string& path)
+    {
+        if (file.get() == nullptr || offset > file->getSize() || size > file->getSize() - offset)
+            return MappedFilePtr(nullptr);
+
+        MappedFilePtr result(new MappedFile());
+        result->data = file->getData() + offset;
+        result->size = size;
+        result->path = path;
+        result->owner = file;
+        return result;
+    }
+
+    MappedFile::MappedFile()
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (!mapped)
+            return;
+
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle((HANDLE) mappingHandle);
+        CloseHandle((HANDLE) fileHandle);
+#else
+        munmap((void*) data, size);
+#endif
+    }
+
+    const char* MappedFile::getData() const
+    {
+        return data;
+    }
+
+    size_t MappedFile::getSize() const
+    {
+        return size;
+    }
+
+    const std::string& MappedFile::getPath() const
+    {
+        return path;
+    }
+
+    bool MappedFile::isMapped() const
+    {
+        return owner.get() != nullptr ? owner->isMapped() : mapped;
+    }
+
+    void MappedFile::prefetch() const
+    {
+        if (!isMapped() || size == 0)
+            return;
+
+#ifndef _WIN32
+        // madvise wants a page aligned address, views into an archive can start anywhere
+        uintptr_t begin = (uintptr_t) data & ~(uintptr_t) (getPageSize() - 1);
+        madvise((void*) begin, (size_t) ((uintptr_t) data + size - begin), MADV_WILLNEED);
+#endif
+    }
+
+    void MappedFile::pageIn() const
+    {
+        if (!isMapped() || size == 0)
+            return;
+
+        prefetch();
+
+        // Reading a byte from every page faults the whole file in
+        size_t pageSize = getPageSize();
+        volatile char sink = 0;
+        for (size_t offset = 0; offset < size; offset += pageSize)
+        {
+            sink ^= data[offset];
+        }
+
+        sink ^= data[size - 1];
+        (void) sink;
+    }
+}
@@ -1,4 +1,10 @@
 #include "material.h"
+#include "frameuniforms.h"
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 
 namespace wake
 {
@@ -45,6 +51,155 @@ namespace wake
         }
     }
 
+    size_t MaterialParameters::getValueSize(uint8 type)
+    {
+        switch (type)
+        {
+            default:
+            case MaterialParameter::Null:
+                return 0;
+
+            case MaterialParameter::Int:
+            case MaterialParameter::UInt:
+            case MaterialParameter::Float:
+                return 4;
+
+            case MaterialParameter::Vec2:
+                return sizeof(glm::vec2);
+
+            case MaterialParameter::Vec3:
+                return sizeof(glm::vec3);
+
+            case MaterialParameter::Vec4:
+                return sizeof(glm::vec4);
+
+            case MaterialParameter::Mat4:
+                return sizeof(glm::mat4);
+        }
+    }
+
+    bool MaterialParameters::set(const std::string& name, const MaterialParameter& param)
+    {
+        if (param.type == MaterialParameter::Null)
+            return remove(name);
+
+        if (name.size() > 0xFFFF)
+        {
+            std::cout << "MaterialParameters error: parameter name is too long" << std::endl;
+            return false;
+        }
+
+        size_t index = lowerBound(name);
+        bool exists = index < entries.size() && names.compare(entries[index].nameOffset, entries[index].nameLength,
+                                                               name) == 0;
+        size_t size = getValueSize(param.type);
+        if (exists && entries[index].type == param.type)
+        {
+            memcpy(values.data() + entries[index].valueOffset, &param.i, size);
+            return false;
+        }
+
+        // A new type needs a different amount of space, so it's stored again at the end
+        if (exists)
+        {
+            remove(name);
+            index = lowerBound(name);
+        }
+
+        Entry entry;
+        entry.nameOffset = (uint32) names.size();
+        entry.nameLength = (uint16) name.size();
+        entry.valueOffset = (uint32) values.size();
+        entry.type = param.type;
+
+        names.append(name);
+        values.resize(values.size() + size);
+        memcpy(values.data() + entry.valueOffset, &param.i, size);
+        entries.insert(entries.begin() + index, entry);
+        return true;
+    }
+
+    bool MaterialParameters::remove(const std::string& name)
+    {
+        size_t index = find(name);
+        if (index == entries.size())
+            return false;
+
+        Entry removed = entries[index];
+        size_t size = getValueSize(removed.type);
+        entries.erase(entries.begin() + index);
+        names.erase(removed.nameOffset, removed.nameLength);
+        values.erase(values.begin() + removed.valueOffset, values.begin() + removed.valueOffset + size);
+
+        // Close the gaps left behind
+        for (auto& entry : entries)
+        {
+            if (entry.nameOffset > removed.nameOffset)
+                entry.nameOffset -= removed.nameLength;
+
+            if (entry.valueOffset > removed.valueOffset)
+                entry.valueOffset -= (uint32) size;
+        }
+
+        return true;
+    }
+
+    size_t MaterialParameters::find(const std::string& name) const
+    {
+        size_t index = lowerBound(name);
+        if (index < entries.size() && names.compare(entries[index].nameOffset, entries[index].nameLength, name) == 0)
+            return index;
+
+        return entries.size();
+    }
+
+    size_t MaterialParameters::getCount() const
+    {
+        return entries.size();
+    }
+
+    std::string MaterialParameters::getName(size_t index) const
+    {
+        return names.substr(entries[index].nameOffset, entries[index].nameLength);
+    }
+
+    const MaterialParameters::Entry& MaterialParameters::getEntry(size_t index) const
+    {
+        return entries[index];
+    }
+
+    MaterialParameter MaterialParameters::get(size_t index) const
+    {
+        MaterialParameter param;
+        param.type = (decltype(param.type)) entries[index].type;
+        memcpy(&param.i, values.data() + entries[index].valueOffset, getValueSize(entries[index].type));
+        return param;
+    }
+
+    MaterialParameter MaterialParameters::get(const std::string& name) const
+    {
+        size_t index = find(name);
+        if (index == entries.size())
+            return MaterialParameter::NullParameter;
+
+        return get(index);
+    }
+
+    const char* MaterialParameters::getValues() const
+    {
+        return values.data();
+    }
+
+    size_t MaterialParameters::lowerBound(const std::string& name) const
+    {
+        auto found = std::lower_bound(entries.begin(), entries.end(), name, [this](const Entry& entry,
+                                                                                   const std::string& name) {
+            return names.compare(entry.nameOffset, entry.nameLength, name) < 0;
+        });
+
+        return (size_t) (found - entries.begin());
+    }
+
     MaterialPtr Material::globalMaterial(new Material());
 
     MaterialPtr Material::getGlobalMaterial()
@@ -55,7 +210,6 @@ namespace wake
     Material::Material()
     {
         shader = nullptr;
-        needsUniformUpdates = true;
     }
 
     Material::Material(const Material& other)
@@ -64,7 +218,7 @@ namespace wake
         shader = other.shader;
         textures = other.textures;
         parameters = other.parameters;
-        needsUniformUpdates = true;
+        layoutChanged();
     }
 
     Material::~Material()
@@ -73,11 +227,12 @@ namespace wake
 
     Material& Material::operator=(const Material& other)
     {
+        changing();
         typeName = other.typeName;
         shader = other.shader;
         textures = other.textures;
         parameters = other.parameters;
-        needsUniformUpdates = true;
+        layoutChanged();
         return *this;
     }
 
@@ -93,8 +248,9 @@ namespace wake
 
     void Material::setShader(ShaderPtr shader)
     {
+        changing();
         this->shader = shader;
-        needsUniformUpdates = true;
+        needsCompile = true;
     }
 
     ShaderPtr Material::getShader() const
@@ -106,12 +262,19 @@ namespace wake
     {
         MaterialTexParameter param;
         param.texture = texture;
+        changing();
         textures[name] = param;
+        needsCompile = true;
     }
 
     void Material::removeTexture(const std::string& name)
     {
+        if (textures.find(name) == textures.end())
+            return;
+
+        changing();
         textures.erase(name);
+        needsCompile = true;
     }
 
     TexturePtr Material::getTexture(const std::string& name)
@@ -138,7 +301,7 @@ namespace wake
         MaterialParameter param;
         param.type = MaterialParameter::Int;
         param.i = i;
-        parameters[name] = param;
+        storeParameter(name, param);
     }
 
     void Material::setParameter(const std::string& name, GLuint u)
@@ -146,7 +309,7 @@ namespace wake
         MaterialParameter param;
         param.type = MaterialParameter::UInt;
         param.u = u;
-        parameters[name] = param;
+        storeParameter(name, param);
     }
 
     void Material::setParameter(const std::string& name, GLfloat f)
@@ -154,7 +317,7 @@ namespace wake
         MaterialParameter param;
         param.type = MaterialParameter::Float;
         param.f = f;
-        parameters[name] = param;
+        storeParameter(name, param);
     }
 
     void Material::setParameter(const std::string& name, const glm::vec2& v2)
@@ -162,7 +325,7 @@ namespace wake
         MaterialParameter param;
         param.type = MaterialParameter::Vec2;
         param.v2 = v2;
-        parameters[name] = param;
+        storeParameter(name, param);
     }
 
     void Material::setParameter(const std::string& name, const glm::vec3& v3)
@@ -170,7 +333,7 @@ namespace wake
         MaterialParameter param;
         param.type = MaterialParameter::Vec3;
         param.v3 = v3;
-        parameters[name] = param;
+        storeParameter(name, param);
     }
 
     void Material::setParameter(const std::string& name, const glm::vec4& v4)
@@ -178,7 +341,7 @@ namespace wake
         MaterialParameter param;
         param.type = MaterialParameter::Vec4;
         param.v4 = v4;
-        parameters[name] = param;
+        storeParameter(name, param);
     }
 
     void Material::setParameter(const std::string& name, const glm::mat4& m4)
@@ -186,7 +349,7 @@ namespace wake
         MaterialParameter param;
         param.type = MaterialParameter::Mat4;
         param.m4 = m4;
-        parameters[name] = param;
+        storeParameter(name, param);
     }
 
     void Material::setTempParameter(const std::string& name, const MaterialParameter& param)
@@ -194,49 +357,47 @@ namespace wake
         if (shader.get() == nullptr)
             return;
 
-        Uniform uniform;
+        compile();
 
-        auto found = parameters.find(name);
-        if (found != parameters.end())
-        {
-            uniform = found->second.uniform;
-        }
-
-        if (uniform.isError())
-        {
-            uniform = shader->getUniform(name.c_str());
-        }
+        auto found = tempLocations.find(name);
+        if (found == tempLocations.end())
+            found = tempLocations.insert(std::make_pair(name, shader->getUniform(name.c_str()).getLocation())).first;
 
+        Uniform uniform(shader->getProgram(), found->second);
         param.setUniform(uniform);
     }
 
     void Material::removeParameter(const std::string& name)
     {
-        parameters.erase(name);
+        if (parameters.find(name) == parameters.getCount())
+            return;
+
+        changing();
+        parameters.remove(name);
+        layoutChanged();
     }
 
-    const MaterialParameter& Material::getParameter(const std::string& name) const
+    MaterialParameter Material::getParameter(const std::string& name) const
     {
-        auto found = parameters.find(name);
-        if (found == parameters.end())
-            return MaterialParameter::NullParameter;
-        return found->second;
+        return parameters.get(name);
     }
 
-    const std::map<std::string, MaterialParameter>& Material::getParameters() const
+    const MaterialParameters& Material::getParameters() const
     {
         return parameters;
     }
 
     size_t Material::getParameterCount() const
     {
-        return parameters.size();
+        return parameters.getCount();
     }
 
+
     void Material::copyFrom(wake::MaterialPtr other)
     {
         if (shader.get() == nullptr)
         {
+            changing();
             shader = other->getShader();
         }
 
@@ -249,12 +410,13 @@ namespace wake
             }
         }
 
-        for (auto& param : other->getParameters())
+        auto& params = other->getParameters();
+        for (size_t i = 0; i < params.getCount(); ++i)
         {
-            auto& ours = getParameter(param.first);
-            if (ours.type == MaterialParameter::Null)
+            std::string name = params.getName(i);
+            if (parameters.find(name) == parameters.getCount())
             {
-                parameters[param.first] = param.second;
+                storeParameter(name, params.get(i));
             }
         }
     }
@@ -264,74 +426,172 @@ namespace wake
         if (shader.get() == nullptr)
             return;
         
+        // Draws outside of the render queue still need this frame's values in the buffer
+        if (shader->hasFrameBlock())
+            W_FRAME_UNIFORMS.update();
+
         shader->use();
+        bindTextures();
+        applyParameters();
+    }
+
+    void Material::bindTextures()
+    {
+        if (shader.get() == nullptr)
+            return;
 
-        uint32 texUnit = 0;
-        for (auto entry : textures)
+        compile();
+
+        for (auto& record : textureRecords)
         {
-            const std::string& name = entry.first;
-            TexturePtr texture = entry.second.texture;
-            if (texture.get() == nullptr)
-                continue;
+            record.texture->activate(record.unit);
+            glUniform1i(record.location, (GLint) record.unit);
+        }
+    }
 
-            if (needsUniformUpdates || entry.second.uniform.isError())
-            {
-                entry.second.uniform = shader->getUniform(name.c_str());
-            }
+    void Material::applyParameters()
+    {
+        if (shader.get() == nullptr)
+            return;
 
-            Uniform& uniform = entry.second.uniform;
-            if (uniform.isError())
-                continue;
+        compile();
 
-            texture->activate(texUnit);
-            uniform.set1i(texUnit);
-            ++texUnit;
+        const char* globalValues = globalMaterial->parameters.getValues();
+        for (auto& record : globalRecords)
+        {
+            setUniformValue(record, globalValues);
         }
 
-        for (auto entry : globalMaterial->parameters)
+        const char* localValues = parameters.getValues();
+        for (auto& record : uniformRecords)
         {
-            const std::string& name = entry.first;
-            MaterialParameter param = entry.second; // copy this, we're going to use it
+            setUniformValue(record, localValues);
+        }
+    }
 
-            // local params override globals
-            if (parameters.find(name) != parameters.end())
-                continue;
+    void Material::resetUniformCache()
+    {
+        needsCompile = true;
+    }
 
-            Uniform uniform;
-            auto found = globalCache.find(name);
-            if (found == globalCache.end())
-            {
-                uniform = shader->getUniform(name.c_str());
-                if (!uniform.isError())
-                    globalCache[name] = uniform;
-            }
-            else
-            {
-                uniform = found->second;
-            }
+    void Material::setUniformValue(const UniformRecord& record, const char* values)
+    {
+        const char* value = values + record.offset;
+        switch (record.type)
+        {
+            default:
+            case MaterialParameter::Null:
+                break;
 
-            param.setUniform(uniform);
-        }
+            case MaterialParameter::Int:
+                glUniform1iv(record.location, 1, (const GLint*) value);
+                break;
 
-        for (auto entry : parameters)
-        {
-            const std::string& name = entry.first;
-            MaterialParameter& param = entry.second;
+            case MaterialParameter::UInt:
+                glUniform1uiv(record.location, 1, (const GLuint*) value);
+                break;
 
-            if (needsUniformUpdates || param.uniform.isError())
-            {
-                param.uniform = shader->getUniform(name.c_str());
-            }
+            case MaterialParameter::Float:
+                glUniform1fv(record.location, 1, (const GLfloat*) value);
+                break;
+
+            case MaterialParameter::Vec2:
+                glUniform2fv(record.location, 1, (const GLfloat*) value);
+                break;
 
-            Uniform& uniform = param.uniform;
-            param.setUniform(uniform);
+            case MaterialParameter::Vec3:
+                glUniform3fv(record.location, 1, (const GLfloat*) value);
+                break;
+
+            case MaterialParameter::Vec4:
+                glUniform4fv(record.location, 1, (const GLfloat*) value);
+                break;
+
+            case MaterialParameter::Mat4:
+                glUniformMatrix4fv(record.location, 1, GL_FALSE, (const GLfloat*) value);
+                break;
         }
+    }
 
-        needsUniformUpdates = false;
+    void Material::storeParameter(const std::string& name, const MaterialParameter& param)
+    {
+        changing();
+        if (parameters.set(name, param))
+            layoutChanged();
     }
 
-    void Material::resetUniformCache()
+    void Material::changing()
+    {
+        W_RENDER_QUEUE.materialChanging(this);
+    }
+
+    void Material::layoutChanged()
+    {
+        needsCompile = true;
+        ++layoutVersion;
+    }
+
+    void Material::compile()
     {
-        needsUniformUpdates = true;
+        if (!needsCompile && compiledGlobalLayout == globalMaterial->layoutVersion)
+            return;
+
+        uniformRecords.clear();
+        globalRecords.clear();
+        textureRecords.clear();
+        tempLocations.clear();
+
+        // Parameters the shader doesn't have are left out, so they cost nothing when drawing
+        for (size_t i = 0; i < parameters.getCount(); ++i)
+        {
+            auto& entry = parameters.getEntry(i);
+            UniformRecord record;
+            record.location = shader->getUniform(parameters.getName(i).c_str()).getLocation();
+            record.type = entry.type;
+            record.offset = entry.valueOffset;
+
+            if (record.location >= 0)
+                uniformRecords.push_back(record);
+        }
+
+        bool frameBlock = shader->hasFrameBlock();
+        auto& globals = globalMaterial->parameters;
+        for (size_t i = 0; i < globals.getCount(); ++i)
+        {
+            std::string name = globals.getName(i);
+
+            // The shader reads these from the frame uniform buffer, and local params override globals
+            if ((frameBlock && FrameUniforms::isMember(name)) || parameters.find(name) != parameters.getCount())
+                continue;
+
+            auto& entry = globals.getEntry(i);
+            UniformRecord record;
+            record.location = shader->getUniform(name.c_str()).getLocation();
+            record.type = entry.type;
+            record.offset = entry.valueOffset;
+
+            if (record.location >= 0)
+                globalRecords.push_back(record);
+        }
+
+        // Units are handed out in order to the textures the shader samples
+        uint32 unit = 0;
+        for (auto& entry : textures)
+        {
+            if (entry.second.texture.get() == nullptr)
+                continue;
+
+            TextureRecord record;
+            record.location = shader->getUniform(entry.first.c_str()).getLocation();
+            if (record.location < 0)
+                continue;
+
+            record.unit = unit++;
+            record.texture = entry.second.texture;
+            textureRecords.push_back(record);
+        }
+
+        needsCompile = false;
+        compiledGlobalLayout = globalMaterial->layoutVersion;
     }
 }
\ No newline at end of file
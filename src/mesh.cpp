@@ -1,9 +1,115 @@
 #include "mesh.h"
+#include "glstate.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include "wake.h"
 
 namespace wake
 {
+    // Converts to IEEE-754 binary16, rounding to nearest even. Values out of range become infinity.
+    static uint16 floatToHalf(float value)
+    {
+        uint32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        uint32 sign = (bits >> 16) & 0x8000;
+        int32 exponent = (int32) ((bits >> 23) & 0xFF) - 127 + 15;
+        uint32 mantissa = bits & 0x7FFFFF;
+
+        if (((bits >> 23) & 0xFF) == 0xFF)
+            return (uint16) (sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+        if (exponent >= 31)
+            return (uint16) (sign | 0x7C00);
+
+        if (exponent <= 0)
+        {
+            if (exponent < -10)
+                return (uint16) sign;
+
+            // Denormal, shift the implicit leading bit in and round
+            mantissa |= 0x800000;
+            uint32 shift = (uint32) (14 - exponent);
+            uint32 half = mantissa >> shift;
+            uint32 remainder = mantissa & ((1u << shift) - 1);
+            uint32 midpoint = 1u << (shift - 1);
+            if (remainder > midpoint || (remainder == midpoint && (half & 1)))
+                ++half;
+
+            return (uint16) (sign | half);
+        }
+
+        uint32 half = sign | ((uint32) exponent << 10) | (mantissa >> 13);
+        uint32 remainder = mantissa & 0x1FFF;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+            ++half; // May carry into the exponent, which correctly rounds up to the next power of two (or infinity)
+
+        return (uint16) half;
+    }
+
+    // Packs a normal into GL_INT_2_10_10_10_REV, x in the lowest bits.
+    static uint32 packNormal(const glm::vec3& normal)
+    {
+        uint32 packed = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            float value = glm::clamp(normal[i], -1.0f, 1.0f) * 511.0f;
+            int32 component = (int32) (value < 0 ? value - 0.5f : value + 0.5f);
+            packed |= ((uint32) component & 0x3FF) << (i * 10);
+        }
+
+        return packed;
+    }
+
+    static size_t getVertexStride(VertexFormat format)
+    {
+        switch (format)
+        {
+            default:
+            case VertexFormat::Float:
+                return sizeof(Vertex);
+
+            case VertexFormat::Packed:
+                return 20;
+
+            case VertexFormat::PackedHalf:
+                return 16;
+        }
+    }
+
+    // Writes the vertices in the GPU layout of the given packed format.
+    static void packVertices(const std::vector<Vertex>& vertices, VertexFormat format, std::vector<char>& out)
+    {
+        size_t stride = getVertexStride(format);
+        out.resize(vertices.size() * stride);
+
+        char* dest = out.data();
+        for (auto& vertex : vertices)
+        {
+            if (format == VertexFormat::PackedHalf)
+            {
+                uint16 position[4] = {floatToHalf(vertex.position.x), floatToHalf(vertex.position.y),
+                                      floatToHalf(vertex.position.z), 0};
+                memcpy(dest, position, sizeof(position));
+                dest += sizeof(position);
+            }
+            else
+            {
+                memcpy(dest, &vertex.position, sizeof(vertex.position));
+                dest += sizeof(vertex.position);
+            }
+
+            uint32 normal = packNormal(vertex.normal);
+            memcpy(dest, &normal, sizeof(normal));
+            dest += sizeof(normal);
+
+            uint16 texCoords[2] = {floatToHalf(vertex.texCoords.x), floatToHalf(vertex.texCoords.y)};
+            memcpy(dest, texCoords, sizeof(texCoords));
+            dest += sizeof(texCoords);
+        }
+    }
+
     Mesh::Mesh()
     {
         initializeData();
@@ -17,6 +123,7 @@ namespace wake
         initializeData();
 
         this->vertices = vertices;
+        updateBounds();
 
         indices.resize(vertices.size());
         for (GLuint i = 0; i < vertices.size(); ++i)
@@ -34,17 +141,61 @@ namespace wake
 
         this->vertices = vertices;
         this->indices = indices;
+        updateBounds();
+
+        updateVertexBuffer();
+        updateElementBuffer();
+    }
+
+    Mesh::Mesh(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount)
+    {
+        initializeData();
+
+        this->vertices.assign(vertices, vertices + vertexCount);
+        this->indices.assign(indices, indices + indexCount);
+        updateBounds();
 
         updateVertexBuffer();
         updateElementBuffer();
     }
 
+    Mesh::Mesh(std::vector<Vertex>&& vertices, std::vector<GLuint>&& indices, VertexFormat vertexFormat,
+               std::vector<MeshLod>&& lods, std::vector<Meshlet>&& meshlets)
+            : vertexFormat(vertexFormat)
+    {
+        initializeData();
+
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->lods = std::move(lods);
+        this->meshlets = std::move(meshlets);
+        updateBounds();
+
+        updateVertexBuffer();
+        updateElementBuffer();
+    }
+
+    Mesh::Mesh(size_t vertexCount, size_t indexCount, const MeshLoader& loader, VertexFormat vertexFormat,
+               const Bounds& bounds)
+            : bounds(bounds), loader(loader), deferredVertexCount(vertexCount), deferredIndexCount(indexCount),
+              vertexFormat(vertexFormat)
+    {
+        initializeData();
+    }
+
     Mesh::Mesh(const Mesh& other)
     {
         initializeData();
 
-        vertices = other.vertices;
-        indices = other.indices;
+        vertices = other.getVertices();
+        indices = other.getIndices();
+        lods = other.lods;
+        meshlets = other.meshlets;
+        bounds = other.bounds;
+        loadFailed = other.loadFailed;
+
+        vertexFormat = other.vertexFormat;
+        updateVertexAttributes();
 
         updateVertexBuffer();
         updateElementBuffer();
@@ -54,19 +205,19 @@ namespace wake
     {
         if (vao != 0)
         {
-            glDeleteVertexArrays(1, &vao);
+            W_GL_STATE.deleteVertexArray(vao);
             vao = 0;
         }
 
         if (vbo != 0)
         {
-            glDeleteBuffers(1, &vbo);
+            W_GL_STATE.deleteBuffer(vbo);
             vbo = 0;
         }
 
         if (ebo != 0)
         {
-            glDeleteBuffers(1, &ebo);
+            W_GL_STATE.deleteBuffer(ebo);
             ebo = 0;
         }
     }
@@ -75,8 +226,16 @@ namespace wake
     {
         initializeData();
 
-        vertices = other.vertices;
-        indices = other.indices;
+        loader = nullptr;
+        vertices = other.getVertices();
+        indices = other.getIndices();
+        lods = other.lods;
+        meshlets = other.meshlets;
+        bounds = other.bounds;
+        loadFailed = other.loadFailed;
+
+        vertexFormat = other.vertexFormat;
+        updateVertexAttributes();
 
         updateVertexBuffer();
         updateElementBuffer();
@@ -84,14 +243,66 @@ namespace wake
         return *this;
     }
 
+    bool Mesh::isLoaded() const
+    {
+        return !loader;
+    }
+
+    void Mesh::load()
+    {
+        if (!loader)
+            return;
+
+        // Clear the loader first so anything it ends up calling on us doesn't recurse back into it
+        MeshLoader currentLoader = loader;
+        loader = nullptr;
+
+        if (!currentLoader(vertices, indices, lods, meshlets))
+        {
+            loadFailed = true;
+            vertices.clear();
+            indices.clear();
+            lods.clear();
+            meshlets.clear();
+        }
+
+        updateBounds();
+
+        updateVertexBuffer();
+        updateElementBuffer();
+    }
+
+    bool Mesh::hasLoadFailed() const
+    {
+        return loadFailed;
+    }
+
+    size_t Mesh::getVertexCount() const
+    {
+        return loader ? deferredVertexCount : vertices.size();
+    }
+
+    size_t Mesh::getIndexCount() const
+    {
+        return loader ? deferredIndexCount : indices.size();
+    }
+
     const std::vector<Vertex>& Mesh::getVertices() const
     {
+        ensureLoaded();
         return vertices;
     }
 
     void Mesh::setVertices(const std::vector<Vertex>& vertices, bool updateIndices)
     {
+        if (!updateIndices)
+            ensureLoaded();
+
+        loader = nullptr;
         this->vertices = vertices;
+        lods.clear();
+        meshlets.clear();
+        updateBounds();
 
         updateVertexBuffer();
 
@@ -109,37 +320,240 @@ namespace wake
 
     const std::vector<GLuint>& Mesh::getIndices() const
     {
+        ensureLoaded();
         return indices;
     }
 
     void Mesh::setIndices(const std::vector<GLuint>& indices)
     {
+        ensureLoaded();
+
         this->indices = indices;
+        lods.clear();
+        meshlets.clear();
+
+        updateElementBuffer();
+    }
+
+    const Bounds& Mesh::getBounds() const
+    {
+        if (bounds.empty)
+            ensureLoaded();
+
+        return bounds;
+    }
+
+    size_t Mesh::getLodCount() const
+    {
+        ensureLoaded();
+        return lods.size() + 1;
+    }
+
+    const std::vector<GLuint>& Mesh::getLodIndices(size_t level) const
+    {
+        ensureLoaded();
+        if (level == 0 || lods.empty())
+            return indices;
+
+        return lods[std::min(level, lods.size()) - 1].indices;
+    }
+
+    float Mesh::getLodError(size_t level) const
+    {
+        ensureLoaded();
+        if (level == 0 || lods.empty())
+            return 0.0f;
+
+        return lods[std::min(level, lods.size()) - 1].error;
+    }
+
+    void Mesh::setLods(const std::vector<MeshLod>& lods)
+    {
+        ensureLoaded();
+
+        this->lods = lods;
 
         updateElementBuffer();
     }
 
-    void Mesh::draw()
+    const std::vector<Meshlet>& Mesh::getMeshlets() const
+    {
+        ensureLoaded();
+        return meshlets;
+    }
+
+    void Mesh::setMeshlets(const std::vector<GLuint>& indices, const std::vector<Meshlet>& meshlets)
+    {
+        ensureLoaded();
+
+        this->indices = indices;
+        this->meshlets = meshlets;
+
+        updateElementBuffer();
+    }
+
+    size_t Mesh::selectLod(const glm::mat4& modelView, const glm::mat4& projection, float threshold) const
+    {
+        // Deferred meshes don't know their levels until they are loaded, which drawing them once takes care of
+        if (lods.empty() || threshold <= 0.0f)
+            return 0;
+
+        float scale = std::max(glm::length(glm::vec3(modelView[0])),
+                               std::max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+        float distance = glm::length(glm::vec3(modelView * glm::vec4(bounds.center, 1.0f)));
+        if (distance <= bounds.radius * scale)
+            return 0;
+
+        // Fraction of the screen's height covered by one unit at the mesh's distance. Perspective projections shrink
+        // things with distance, orthographic ones (projection[3][3] == 1) don't.
+        float screenPerUnit = projection[1][1] * 0.5f;
+        if (projection[3][3] == 0.0f)
+            screenPerUnit /= distance;
+
+        size_t level = 0;
+        while (level < lods.size() && lods[level].error * scale * screenPerUnit <= threshold)
+        {
+            ++level;
+        }
+
+        return level;
+    }
+
+    VertexFormat Mesh::getVertexFormat() const
+    {
+        return vertexFormat;
+    }
+
+    void Mesh::setVertexFormat(VertexFormat format)
+    {
+        if (format == vertexFormat)
+            return;
+
+        vertexFormat = format;
+        updateVertexAttributes();
+
+        // Deferred meshes upload in the new format when they are loaded
+        if (isLoaded())
+            updateVertexBuffer();
+    }
+
+    bool Mesh::isUploaded() const
+    {
+        return vao != 0;
+    }
+
+    void Mesh::upload()
+    {
+        if (getEngineMode() != EngineMode::Normal || isUploaded())
+        {
+            return;
+        }
+
+        initializeData();
+
+        // Deferred meshes upload their data when they are loaded
+        if (isLoaded())
+        {
+            updateVertexBuffer();
+            updateElementBuffer();
+        }
+    }
+
+    void Mesh::draw(size_t level)
     {
         if (getEngineMode() != EngineMode::Normal)
         {
             return;
         }
 
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        upload();
+        load();
+
+        // The vertex array has the attribute pointers into the vertex buffer, so that doesn't need to be bound. It also
+        // keeps the element buffer once it has been bound with it, which the state cache knows.
+        W_GL_STATE.bindVertexArray(vao);
+        W_GL_STATE.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+        // Levels of detail follow the full mesh in the element buffer
+        size_t offset = 0;
+        size_t count = indices.size();
+        for (size_t i = 0; i < std::min(level, lods.size()); ++i)
+        {
+            offset += count;
+            count = lods[i].indices.size();
+        }
+
+        glDrawElements(GL_TRIANGLES, (GLsizei) count, GL_UNSIGNED_INT, (GLvoid*) (offset * sizeof(GLuint)));
+
+        W_GL_CHECK();
+    }
+
+    size_t Mesh::drawMeshlets(const Frustum& frustum, const glm::vec3& cameraPosition, bool cullBackfaces)
+    {
+        ensureLoaded();
+        if (meshlets.empty())
+        {
+            draw();
+            return indices.size() / 3;
+        }
+
+        // Neighbouring meshlets are stored next to each other, so visible ones merge into as few ranges as possible
+        drawCounts.clear();
+        drawOffsets.clear();
+        size_t rangeEnd = ~(size_t) 0;
+        size_t indexCount = 0;
+        for (auto& meshlet : meshlets)
+        {
+            if (!isSphereVisible(frustum, meshlet.center, meshlet.radius))
+                continue;
+
+            if (cullBackfaces && meshlet.coneCutoff < 1.0f)
+            {
+                glm::vec3 offset = meshlet.center - cameraPosition;
+                if (glm::dot(offset, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(offset) + meshlet.radius)
+                    continue;
+            }
+
+            if (meshlet.indexOffset == rangeEnd)
+            {
+                drawCounts.back() += (GLsizei) meshlet.indexCount;
+            }
+            else
+            {
+                drawCounts.push_back((GLsizei) meshlet.indexCount);
+                drawOffsets.push_back((const GLvoid*) (meshlet.indexOffset * sizeof(GLuint)));
+            }
+
+            rangeEnd = meshlet.indexOffset + meshlet.indexCount;
+            indexCount += meshlet.indexCount;
+        }
+
+        if (getEngineMode() != EngineMode::Normal || drawCounts.empty())
+            return indexCount / 3;
 
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        upload();
 
-        glBindVertexArray(0);
+        W_GL_STATE.bindVertexArray(vao);
+        W_GL_STATE.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+        glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+                            (GLsizei) drawCounts.size());
 
         W_GL_CHECK();
+
+        return indexCount / 3;
+    }
+
+    void Mesh::ensureLoaded() const
+    {
+        // Loading a deferred mesh doesn't change what it represents, only when the data is read
+        if (loader)
+            const_cast<Mesh*>(this)->load();
     }
 
     void Mesh::initializeData()
     {
-        if (getEngineMode() != EngineMode::Normal)
+        if (getEngineMode() != EngineMode::Normal || getDeferUploads())
         {
             return;
         }
@@ -157,46 +571,110 @@ namespace wake
         glGenBuffers(1, &ebo);
         W_GL_CHECK();
 
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBindVertexArray(vao);
+        updateVertexAttributes();
+    }
+
+    void Mesh::updateVertexAttributes()
+    {
+        if (getEngineMode() != EngineMode::Normal || !isUploaded())
+        {
+            return;
+        }
+
+        W_GL_STATE.bindVertexArray(vao);
+        W_GL_STATE.bindBuffer(GL_ARRAY_BUFFER, vbo);
         W_GL_CHECK();
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*) offsetof(Vertex, position));
+        GLsizei stride = (GLsizei) getVertexStride(vertexFormat);
 
+        glEnableVertexAttribArray(0);
         glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*) offsetof(Vertex, normal));
-
         glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*) offsetof(Vertex, texCoords));
 
-        W_GL_CHECK();
+        switch (vertexFormat)
+        {
+            case VertexFormat::Float:
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*) offsetof(Vertex, position));
+                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*) offsetof(Vertex, normal));
+                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*) offsetof(Vertex, texCoords));
+                break;
+
+            case VertexFormat::Packed:
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*) 0);
+                glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (GLvoid*) 12);
+                glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*) 16);
+                break;
+
+            case VertexFormat::PackedHalf:
+                glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*) 0);
+                glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (GLvoid*) 8);
+                glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*) 12);
+                break;
+        }
 
-        glBindVertexArray(0);
         W_GL_CHECK();
     }
 
     void Mesh::updateVertexBuffer()
     {
-        if (getEngineMode() != EngineMode::Normal)
+        if (getEngineMode() != EngineMode::Normal || !isUploaded())
         {
             return;
         }
 
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices.front(), GL_STATIC_DRAW);
+        W_GL_STATE.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (vertexFormat == VertexFormat::Float)
+        {
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices.front(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            std::vector<char> packed;
+            packVertices(vertices, vertexFormat, packed);
+            glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+        }
         W_GL_CHECK();
     }
 
     void Mesh::updateElementBuffer()
     {
-        if (getEngineMode() != EngineMode::Normal)
+        if (getEngineMode() != EngineMode::Normal || !isUploaded())
+        {
+            return;
+        }
+
+        // The element buffer binding is part of the vertex array, binding it with our own leaves other meshes alone
+        W_GL_STATE.bindVertexArray(vao);
+        W_GL_STATE.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        if (lods.empty())
         {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices.front(), GL_STATIC_DRAW);
+            W_GL_CHECK();
             return;
         }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices.front(), GL_STATIC_DRAW);
+        size_t size = indices.size();
+        for (auto& lod : lods)
+        {
+            size += lod.indices.size();
+        }
+
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, size * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+
+        size_t offset = indices.size();
+        for (auto& lod : lods)
+        {
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset * sizeof(GLuint), lod.indices.size() * sizeof(GLuint),
+                            lod.indices.data());
+            offset += lod.indices.size();
+        }
+
         W_GL_CHECK();
     }
+
+    void Mesh::updateBounds()
+    {
+        bounds = computeBounds(vertices.data(), vertices.size(), sizeof(Vertex));
+    }
 }
\ No newline at end of file
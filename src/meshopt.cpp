@@ -0,0 +1,1182 @@
+#include "meshopt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace wake
+{
+    // Counts cache misses with a FIFO cache. A vertex is in the cache if fewer than cacheSize misses happened since it
+    // was last loaded; timestamps start far enough back that nothing is cached initially, and the cache can be flushed
+    // by moving time forward by cacheSize.
+    class CacheSimulator
+    {
+    public:
+        CacheSimulator(size_t vertexCount, size_t cacheSize)
+                : timestamps(vertexCount, 0), cacheSize((uint32) cacheSize), time((uint32) cacheSize + 1)
+        {
+        }
+
+        // Returns 1 if the vertex had to be loaded, 0 if it was cached.
+        uint32 access(GLuint vertex)
+        {
+            if (time - timestamps[vertex] > cacheSize)
+            {
+                timestamps[vertex] = time++;
+                return 1;
+            }
+
+            return 0;
+        }
+
+        uint32 accessTriangle(const GLuint* triangle)
+        {
+            return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+        }
+
+        void flush()
+        {
+            time += cacheSize + 1;
+        }
+
+    private:
+        std::vector<uint32> timestamps;
+        uint32 cacheSize;
+        uint32 time;
+    };
+
+    float getACMR(const GLuint* indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+    {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+            return 0.0f;
+
+        CacheSimulator cache(vertexCount, cacheSize);
+        size_t misses = 0;
+        for (size_t i = 0; i < triangleCount * 3; i += 3)
+        {
+            misses += cache.accessTriangle(indices + i);
+        }
+
+        return (float) misses / (float) triangleCount;
+    }
+
+    static uint32 hashVertex(const Vertex& vertex)
+    {
+        // FNV-1a over the raw bytes, WMDL relies on wake::Vertex being tightly packed anyway
+        const uint8* bytes = (const uint8*) &vertex;
+        uint32 hash = 2166136261u;
+        for (size_t i = 0; i < sizeof(Vertex); ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    size_t weldVertices(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+    {
+        // Open addressing table of indices into unique, sized to stay at most half full
+        size_t tableSize = 1;
+        while (tableSize < vertices.size() * 2)
+        {
+            tableSize *= 2;
+        }
+
+        const uint32 empty = ~0u;
+        std::vector<uint32> table(tableSize, empty);
+        std::vector<GLuint> remap(vertices.size());
+        std::vector<Vertex> unique;
+        unique.reserve(vertices.size());
+
+        for (size_t v = 0; v < vertices.size(); ++v)
+        {
+            size_t slot = hashVertex(vertices[v]) & (tableSize - 1);
+            while (table[slot] != empty && memcmp(&unique[table[slot]], &vertices[v], sizeof(Vertex)) != 0)
+            {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+
+            if (table[slot] == empty)
+            {
+                table[slot] = (uint32) unique.size();
+                unique.push_back(vertices[v]);
+            }
+
+            remap[v] = table[slot];
+        }
+
+        for (auto& index : indices)
+        {
+            index = remap[index];
+        }
+
+        vertices.swap(unique);
+        return vertices.size();
+    }
+
+    // Forsyth's vertex scoring: recently used vertices score highest (the last triangle's three a little less, so
+    // strips don't run forever), and vertices with few triangles left get a boost so they're finished off.
+    static float getVertexScore(int cachePosition, uint32 liveTriangles)
+    {
+        if (liveTriangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+            {
+                score = 0.75f;
+            }
+            else
+            {
+                float scale = 1.0f / (float) (W_VERTEX_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (float) (cachePosition - 3) * scale, 1.5f);
+            }
+        }
+
+        return score + 2.0f / std::sqrt((float) liveTriangles);
+    }
+
+    void optimizeVertexCache(GLuint* indices, size_t indexCount, size_t vertexCount)
+    {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+            return;
+
+        // Triangles using each vertex, the first live[v] entries of each list are the ones not emitted yet
+        std::vector<uint32> live(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+        {
+            ++live[indices[i]];
+        }
+
+        std::vector<uint32> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            offsets[v + 1] = offsets[v] + live[v];
+        }
+
+        std::vector<uint32> adjacency(triangleCount * 3);
+        std::vector<uint32> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+        {
+            adjacency[fill[indices[i]]++] = (uint32) (i / 3);
+        }
+
+        std::vector<int> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            vertexScores[v] = getVertexScore(-1, live[v]);
+        }
+
+        std::vector<float> triangleScores(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            const GLuint* triangle = indices + t * 3;
+            triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+        }
+
+        std::vector<GLuint> result;
+        result.reserve(triangleCount * 3);
+
+        std::vector<GLuint> cache;
+        std::vector<GLuint> newCache;
+        size_t cursor = 0;
+        int64 best = -1;
+
+        while (result.size() < triangleCount * 3)
+        {
+            // Dead end, nothing in the cache has triangles left: continue with the next triangle in input order
+            if (best < 0)
+            {
+                while (emitted[cursor])
+                {
+                    ++cursor;
+                }
+
+                best = (int64) cursor;
+            }
+
+            const GLuint* triangle = indices + best * 3;
+            emitted[best] = true;
+            newCache.assign(triangle, triangle + 3);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                GLuint v = triangle[k];
+                result.push_back(v);
+
+                uint32* list = adjacency.data() + offsets[v];
+                for (uint32 j = 0; j < live[v]; ++j)
+                {
+                    if (list[j] == (uint32) best)
+                    {
+                        std::swap(list[j], list[live[v] - 1]);
+                        --live[v];
+                        break;
+                    }
+                }
+            }
+
+            for (GLuint v : cache)
+            {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                    newCache.push_back(v);
+            }
+
+            // Rescore everything that was in the cache (including what just fell out of it) and the triangles
+            // around it, then pick the best of those triangles
+            best = -1;
+            float bestScore = -1.0f;
+            for (size_t i = 0; i < newCache.size(); ++i)
+            {
+                GLuint v = newCache[i];
+                cachePositions[v] = i < W_VERTEX_CACHE_SIZE ? (int) i : -1;
+                vertexScores[v] = getVertexScore(cachePositions[v], live[v]);
+            }
+
+            for (GLuint v : newCache)
+            {
+                const uint32* list = adjacency.data() + offsets[v];
+                for (uint32 j = 0; j < live[v]; ++j)
+                {
+                    uint32 t = list[j];
+                    const GLuint* other = indices + t * 3;
+                    triangleScores[t] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+
+                    if (triangleScores[t] > bestScore)
+                    {
+                        best = t;
+                        bestScore = triangleScores[t];
+                    }
+                }
+            }
+
+            if (newCache.size() > W_VERTEX_CACHE_SIZE)
+                newCache.resize(W_VERTEX_CACHE_SIZE);
+
+            cache.swap(newCache);
+        }
+
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    void optimizeOverdraw(GLuint* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+                          float threshold)
+    {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount < 2)
+            return;
+
+        // Hard boundaries: triangles where all three vertices miss, i.e. the cache starts over anyway
+        std::vector<size_t> hard;
+        {
+            CacheSimulator cache(vertexCount, W_VERTEX_CACHE_SIZE);
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                if (cache.accessTriangle(indices + t * 3) == 3)
+                    hard.push_back(t);
+            }
+        }
+
+        if (hard.empty() || hard[0] != 0)
+            hard.insert(hard.begin(), 0);
+
+        hard.push_back(triangleCount);
+
+        // Soft boundaries: split each hard cluster further wherever the part so far is at least as cache friendly as
+        // the whole cluster (within the threshold), so that starting over there costs little
+        std::vector<size_t> clusters;
+        CacheSimulator cache(vertexCount, W_VERTEX_CACHE_SIZE);
+        for (size_t c = 0; c + 1 < hard.size(); ++c)
+        {
+            size_t start = hard[c];
+            size_t end = hard[c + 1];
+
+            cache.flush();
+            uint32 clusterMisses = 0;
+            for (size_t t = start; t < end; ++t)
+            {
+                clusterMisses += cache.accessTriangle(indices + t * 3);
+            }
+
+            float limit = threshold * (float) clusterMisses / (float) (end - start);
+
+            cache.flush();
+            clusters.push_back(start);
+            uint32 misses = 0;
+            size_t count = 0;
+            for (size_t t = start; t < end; ++t)
+            {
+                misses += cache.accessTriangle(indices + t * 3);
+                ++count;
+
+                if (t + 1 < end && (float) misses <= limit * (float) count)
+                {
+                    clusters.push_back(t + 1);
+                    cache.flush();
+                    misses = 0;
+                    count = 0;
+                }
+            }
+        }
+
+        clusters.push_back(triangleCount);
+
+        glm::vec3 meshCenter(0.0f);
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            meshCenter += vertices[v].position;
+        }
+
+        meshCenter /= (float) std::max(vertexCount, (size_t) 1);
+
+        // Sort clusters by how much they face away from the middle of the mesh: those are the most likely to be in
+        // front of the rest, so drawing them first lets the depth test reject more of what comes after
+        size_t clusterCount = clusters.size() - 1;
+        std::vector<float> keys(clusterCount);
+        for (size_t c = 0; c < clusterCount; ++c)
+        {
+            glm::vec3 center(0.0f);
+            glm::vec3 normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+            {
+                const glm::vec3& a = vertices[indices[t * 3 + 0]].position;
+                const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+                const glm::vec3& p = vertices[indices[t * 3 + 2]].position;
+
+                glm::vec3 cross = glm::cross(b - a, p - a);
+                float triangleArea = glm::length(cross);
+
+                center += (a + b + p) * (triangleArea / 3.0f);
+                normal += cross;
+                area += triangleArea;
+            }
+
+            float normalLength = glm::length(normal);
+            if (area > 0.0f && normalLength > 0.0f)
+                keys[c] = glm::dot(center / area - meshCenter, normal / normalLength);
+            else
+                keys[c] = 0.0f;
+        }
+
+        std::vector<size_t> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; ++c)
+        {
+            order[c] = c;
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+            return keys[a] > keys[b];
+        });
+
+        std::vector<GLuint> result;
+        result.reserve(triangleCount * 3);
+        for (size_t c : order)
+        {
+            result.insert(result.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+        }
+
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+    {
+        const GLuint unused = ~0u;
+        std::vector<GLuint> remap(vertices.size(), unused);
+        std::vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+
+        for (auto& index : indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = (GLuint) ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+
+            index = remap[index];
+        }
+
+        vertices.swap(ordered);
+    }
+
+    namespace
+    {
+        // Sum of squared distances to a set of planes, each weighted by area: for a plane n.p + d = 0, A = n n^T,
+        // b = d n and c = d^2. Evaluated at p it's p^T A p + 2 b.p + c.
+        struct Quadric
+        {
+            double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+            double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+            double c = 0.0;
+            double weight = 0.0;
+
+            void addPlane(const glm::vec3& normal, float d, float planeWeight)
+            {
+                double x = normal.x, y = normal.y, z = normal.z, w = planeWeight;
+                a00 += w * x * x;
+                a01 += w * x * y;
+                a02 += w * x * z;
+                a11 += w * y * y;
+                a12 += w * y * z;
+                a22 += w * z * z;
+                b0 += w * x * d;
+                b1 += w * y * d;
+                b2 += w * z * d;
+                c += w * d * d;
+                weight += w;
+            }
+
+            void add(const Quadric& other)
+            {
+                a00 += other.a00;
+                a01 += other.a01;
+                a02 += other.a02;
+                a11 += other.a11;
+                a12 += other.a12;
+                a22 += other.a22;
+                b0 += other.b0;
+                b1 += other.b1;
+                b2 += other.b2;
+                c += other.c;
+                weight += other.weight;
+            }
+
+            // Average squared distance of p to the planes
+            double getError(const glm::vec3& p) const
+            {
+                double x = p.x, y = p.y, z = p.z;
+                double error = a00 * x * x + a11 * y * y + a22 * z * z +
+                               2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+
+                return weight > 0.0 ? std::max(0.0, error) / weight : 0.0;
+            }
+        };
+
+        enum class VertexKind : uint8
+        {
+            // Every edge around this position is shared by two triangles
+            Manifold,
+
+            // On an open border, may only collapse along it
+            Border,
+
+            // Part of an edge shared by more than two triangles
+            Locked
+        };
+
+        struct Collapse
+        {
+            GLuint from;
+            GLuint to;
+            double error;
+        };
+    }
+
+    static uint64 getEdgeKey(GLuint a, GLuint b)
+    {
+        return a < b ? ((uint64) a << 32) | b : ((uint64) b << 32) | a;
+    }
+
+    static float getMeshRadius(const std::vector<Vertex>& vertices)
+    {
+        Bounds bounds = computeBounds(vertices.data(), vertices.size(), sizeof(Vertex));
+        return glm::length(bounds.maximum - bounds.minimum) * 0.5f;
+    }
+
+    // Maps every vertex to the first vertex with the same position
+    static std::vector<GLuint> getPositionRemap(const std::vector<Vertex>& vertices)
+    {
+        size_t tableSize = 1;
+        while (tableSize < vertices.size() * 2)
+        {
+            tableSize *= 2;
+        }
+
+        const GLuint empty = ~0u;
+        std::vector<GLuint> table(tableSize, empty);
+        std::vector<GLuint> remap(vertices.size());
+        for (size_t v = 0; v < vertices.size(); ++v)
+        {
+            const glm::vec3& position = vertices[v].position;
+            size_t slot = hashBytes((const char*) &position, sizeof(position)) & (tableSize - 1);
+            while (table[slot] != empty && memcmp(&vertices[table[slot]].position, &position, sizeof(position)) != 0)
+            {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+
+            if (table[slot] == empty)
+                table[slot] = (GLuint) v;
+
+            remap[v] = table[slot];
+        }
+
+        return remap;
+    }
+
+    // Counts how many triangles use every edge, by position
+    static std::unordered_map<uint64, uint32> getEdgeCounts(const std::vector<GLuint>& indices,
+                                                            const std::vector<GLuint>& positions)
+    {
+        std::unordered_map<uint64, uint32> counts;
+        counts.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                ++counts[getEdgeKey(positions[indices[i + k]], positions[indices[i + (k + 1) % 3]])];
+            }
+        }
+
+        return counts;
+    }
+
+    // Of the vertices sharing target's position, the one whose attributes are closest to vertex
+    static GLuint findClosestWedge(const std::vector<Vertex>& vertices, const std::vector<uint32>& wedgeOffsets,
+                                   const std::vector<GLuint>& wedges, GLuint vertex, GLuint target)
+    {
+        GLuint best = target;
+        float bestDistance = std::numeric_limits<float>::max();
+        for (uint32 w = wedgeOffsets[target]; w < wedgeOffsets[target + 1]; ++w)
+        {
+            const Vertex& candidate = vertices[wedges[w]];
+            glm::vec3 normal = candidate.normal - vertices[vertex].normal;
+            glm::vec2 texCoords = candidate.texCoords - vertices[vertex].texCoords;
+            float distance = glm::dot(normal, normal) + glm::dot(texCoords, texCoords);
+            if (distance < bestDistance)
+            {
+                best = wedges[w];
+                bestDistance = distance;
+            }
+        }
+
+        return best;
+    }
+
+    std::vector<GLuint> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                                     size_t targetIndexCount, float targetError, float* resultError)
+    {
+        std::vector<GLuint> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+        if (resultError != nullptr)
+            *resultError = 0.0f;
+
+        float radius = getMeshRadius(vertices);
+        for (GLuint index : result)
+        {
+            if (index >= vertices.size())
+                return result;
+        }
+
+        if (radius <= 0.0f || result.size() <= targetIndexCount)
+            return result;
+
+        // Topology and error are worked out per position rather than per vertex, so seams (and meshes that don't share
+        // vertices between triangles at all) simplify like the surface they describe. Every position is represented
+        // by the first vertex at it, and its wedges are all of the vertices at it.
+        std::vector<GLuint> positions = getPositionRemap(vertices);
+        std::vector<uint32> wedgeOffsets(vertices.size() + 1, 0);
+        for (GLuint position : positions)
+        {
+            ++wedgeOffsets[position + 1];
+        }
+
+        for (size_t v = 0; v < vertices.size(); ++v)
+        {
+            wedgeOffsets[v + 1] += wedgeOffsets[v];
+        }
+
+        std::vector<GLuint> wedges(vertices.size());
+        {
+            std::vector<uint32> fill(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+            for (size_t v = 0; v < vertices.size(); ++v)
+            {
+                wedges[fill[positions[v]]++] = (GLuint) v;
+            }
+        }
+
+        std::vector<VertexKind> kinds(vertices.size(), VertexKind::Manifold);
+        std::vector<Quadric> quadrics(vertices.size());
+        {
+            std::unordered_map<uint64, uint32> edges = getEdgeCounts(result, positions);
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                const glm::vec3& p0 = vertices[result[i]].position;
+                const glm::vec3& p1 = vertices[result[i + 1]].position;
+                const glm::vec3& p2 = vertices[result[i + 2]].position;
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+                if (area > 0.0f)
+                    normal /= area;
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    quadrics[positions[result[i + k]]].addPlane(normal, -glm::dot(normal, p0), area);
+                }
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    GLuint a = positions[result[i + k]];
+                    GLuint b = positions[result[i + (k + 1) % 3]];
+                    uint32 count = edges[getEdgeKey(a, b)];
+                    if (count == 1)
+                    {
+                        // Keep borders in place with a plane through the edge, perpendicular to the triangle
+                        glm::vec3 edge = vertices[b].position - vertices[a].position;
+                        float length = glm::length(edge);
+                        glm::vec3 perpendicular = glm::cross(edge, normal);
+                        float perpendicularLength = glm::length(perpendicular);
+                        if (perpendicularLength > 0.0f)
+                        {
+                            perpendicular /= perpendicularLength;
+                            float d = -glm::dot(perpendicular, vertices[a].position);
+                            quadrics[a].addPlane(perpendicular, d, length * length * 10.0f);
+                            quadrics[b].addPlane(perpendicular, d, length * length * 10.0f);
+                        }
+
+                        for (GLuint v : {a, b})
+                        {
+                            if (kinds[v] == VertexKind::Manifold)
+                                kinds[v] = VertexKind::Border;
+                        }
+                    }
+                    else if (count > 2)
+                    {
+                        kinds[a] = VertexKind::Locked;
+                        kinds[b] = VertexKind::Locked;
+                    }
+                }
+            }
+        }
+
+        double errorLimit = (double) targetError * radius * (double) targetError * radius;
+        double maxError = 0.0;
+
+        std::vector<GLuint> remap(vertices.size());
+        std::vector<bool> touched(vertices.size());
+        std::vector<uint32> offsets(vertices.size() + 1);
+        std::vector<uint32> adjacency;
+        std::vector<Collapse> collapses;
+
+        // Each pass collapses the cheapest edges that don't touch each other, so the error of every collapse can be
+        // worked out from the mesh as it was at the start of the pass
+        while (result.size() > targetIndexCount)
+        {
+            std::unordered_map<uint64, uint32> edges = getEdgeCounts(result, positions);
+
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    GLuint a = positions[result[i + k]];
+                    GLuint b = positions[result[i + (k + 1) % 3]];
+                    bool border = edges[getEdgeKey(a, b)] == 1;
+
+                    for (int direction = 0; direction < 2; ++direction)
+                    {
+                        GLuint from = direction == 0 ? a : b;
+                        GLuint to = direction == 0 ? b : a;
+                        if (kinds[from] == VertexKind::Locked || (kinds[from] == VertexKind::Border && !border))
+                            continue;
+
+                        Quadric quadric = quadrics[from];
+                        quadric.add(quadrics[to]);
+
+                        Collapse collapse;
+                        collapse.from = from;
+                        collapse.to = to;
+                        collapse.error = quadric.getError(vertices[to].position);
+                        collapses.push_back(collapse);
+                    }
+                }
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+                return a.error < b.error;
+            });
+
+            // Triangles around every position, to check collapses for flipped triangles and keep them apart
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for (GLuint index : result)
+            {
+                ++offsets[positions[index] + 1];
+            }
+
+            for (size_t v = 0; v < vertices.size(); ++v)
+            {
+                offsets[v + 1] += offsets[v];
+            }
+
+            adjacency.resize(result.size());
+            std::vector<uint32> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); ++i)
+            {
+                adjacency[fill[positions[result[i]]]++] = (uint32) (i / 3);
+            }
+
+            for (size_t v = 0; v < vertices.size(); ++v)
+            {
+                remap[v] = (GLuint) v;
+            }
+
+            std::fill(touched.begin(), touched.end(), false);
+
+            // Collapsing an edge removes two triangles, or one on a border
+            size_t triangleBudget = (result.size() - targetIndexCount) / 3;
+            size_t removed = 0;
+            size_t collapsed = 0;
+            for (auto& collapse : collapses)
+            {
+                if (collapse.error > errorLimit || removed >= triangleBudget)
+                    break;
+
+                if (touched[collapse.from] || touched[collapse.to])
+                    continue;
+
+                const glm::vec3& target = vertices[collapse.to].position;
+                bool flips = false;
+                size_t lost = 0;
+                for (uint32 j = offsets[collapse.from]; j < offsets[collapse.from + 1] && !flips; ++j)
+                {
+                    const GLuint* triangle = result.data() + adjacency[j] * 3;
+                    GLuint corners[3] = {positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]};
+                    if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to)
+                    {
+                        ++lost;
+                        continue;
+                    }
+
+                    glm::vec3 before[3];
+                    glm::vec3 after[3];
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        before[k] = vertices[corners[k]].position;
+                        after[k] = corners[k] == collapse.from ? target : before[k];
+                    }
+
+                    glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+                }
+
+                if (flips)
+                    continue;
+
+                // Nothing around either end may move again this pass
+                for (GLuint v : {collapse.from, collapse.to})
+                {
+                    for (uint32 j = offsets[v]; j < offsets[v + 1]; ++j)
+                    {
+                        const GLuint* triangle = result.data() + adjacency[j] * 3;
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            touched[positions[triangle[k]]] = true;
+                        }
+                    }
+                }
+
+                remap[collapse.from] = collapse.to;
+                quadrics[collapse.to].add(quadrics[collapse.from]);
+                maxError = std::max(maxError, collapse.error);
+
+                removed += lost;
+                ++collapsed;
+            }
+
+            if (collapsed == 0)
+                break;
+
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                GLuint corners[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    corners[k] = remap[positions[result[i + k]]];
+                }
+
+                if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+                    continue;
+
+                // Corners that moved take on whichever vertex at their new position looks the most like them
+                for (int k = 0; k < 3; ++k)
+                {
+                    GLuint vertex = result[i + k];
+                    result[write++] = corners[k] == positions[vertex] ? vertex :
+                                      findClosestWedge(vertices, wedgeOffsets, wedges, vertex, corners[k]);
+                }
+            }
+
+            result.resize(write);
+        }
+
+        if (resultError != nullptr)
+            *resultError = (float) (std::sqrt(maxError) / radius);
+
+        return result;
+    }
+
+    std::vector<MeshLod> generateLods(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+                                      const LodOptions& options)
+    {
+        std::vector<MeshLod> lods;
+        float radius = getMeshRadius(vertices);
+        size_t previousCount = indices.size() / 3 * 3;
+
+        for (float targetError : options.errors)
+        {
+            size_t targetCount = (size_t) ((float) (previousCount / 3) * options.reduction) * 3;
+
+            MeshLod lod;
+            float error = 0.0f;
+            lod.indices = simplifyMesh(vertices, indices, targetCount, targetError, &error);
+
+            // Levels that barely simplify anything only cost memory
+            if (lod.indices.empty() || (float) lod.indices.size() > (float) previousCount * 0.85f)
+                break;
+
+            optimizeVertexCache(lod.indices.data(), lod.indices.size(), vertices.size());
+            lod.error = std::max(error * radius, lods.empty() ? 0.0f : lods.back().error);
+
+            previousCount = lod.indices.size();
+            lods.push_back(std::move(lod));
+        }
+
+        return lods;
+    }
+
+    size_t generateLods(ModelPtr model, const LodOptions& options)
+    {
+        size_t count = 0;
+        for (auto& meshInfo : model->getMeshes())
+        {
+            if (meshInfo.mesh.get() == nullptr)
+                continue;
+
+            MeshPtr mesh = meshInfo.mesh;
+            std::vector<MeshLod> lods = generateLods(mesh->getVertices(), mesh->getIndices(), options);
+            mesh->setLods(lods);
+            count += lods.size();
+        }
+
+        return count;
+    }
+
+    // Bounds and normal cone of the triangles in indices
+    static void finishMeshlet(const std::vector<Vertex>& vertices, const GLuint* indices, Meshlet& meshlet)
+    {
+        glm::vec3 minPosition = vertices[indices[0]].position;
+        glm::vec3 maxPosition = minPosition;
+        glm::vec3 normalSum(0.0f);
+        for (uint32 i = 0; i < meshlet.indexCount; i += 3)
+        {
+            const glm::vec3& p0 = vertices[indices[i]].position;
+            const glm::vec3& p1 = vertices[indices[i + 1]].position;
+            const glm::vec3& p2 = vertices[indices[i + 2]].position;
+            normalSum += glm::cross(p1 - p0, p2 - p0);
+
+            for (const glm::vec3* position : {&p0, &p1, &p2})
+            {
+                minPosition = glm::min(minPosition, *position);
+                maxPosition = glm::max(maxPosition, *position);
+            }
+        }
+
+        meshlet.center = (minPosition + maxPosition) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (uint32 i = 0; i < meshlet.indexCount; ++i)
+        {
+            meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].position - meshlet.center));
+        }
+
+        // The cone is the (area weighted) average normal, widened until it holds every triangle's normal. Cones wider
+        // than about 84 degrees on either side are so rarely culled that they are disabled.
+        meshlet.coneAxis = glm::vec3(0.0f);
+        meshlet.coneCutoff = 1.0f;
+
+        float length = glm::length(normalSum);
+        if (length <= 0.0f)
+            return;
+
+        glm::vec3 axis = normalSum / length;
+        float minDot = 1.0f;
+        for (uint32 i = 0; i < meshlet.indexCount; i += 3)
+        {
+            const glm::vec3& p0 = vertices[indices[i]].position;
+            const glm::vec3& p1 = vertices[indices[i + 1]].position;
+            const glm::vec3& p2 = vertices[indices[i + 2]].position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+            if (area > 0.0f)
+                minDot = std::min(minDot, glm::dot(normal / area, axis));
+        }
+
+        meshlet.coneAxis = axis;
+        if (minDot > 0.1f)
+            meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+
+    std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+                                       size_t maxVertices, size_t maxTriangles)
+    {
+        std::vector<Meshlet> meshlets;
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || maxVertices < 3 || maxTriangles == 0)
+            return meshlets;
+
+        for (GLuint index : indices)
+        {
+            if (index >= vertices.size())
+                return meshlets;
+        }
+
+        // Triangles around every position
+        std::vector<GLuint> positions = getPositionRemap(vertices);
+        std::vector<uint32> offsets(vertices.size() + 1, 0);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+        {
+            ++offsets[positions[indices[i]] + 1];
+        }
+
+        for (size_t v = 0; v < vertices.size(); ++v)
+        {
+            offsets[v + 1] += offsets[v];
+        }
+
+        std::vector<uint32> adjacency(triangleCount * 3);
+        {
+            std::vector<uint32> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < triangleCount * 3; ++i)
+            {
+                adjacency[fill[positions[indices[i]]]++] = (uint32) (i / 3);
+            }
+        }
+
+        std::vector<glm::vec3> normals(triangleCount);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            const glm::vec3& p0 = vertices[indices[t * 3]].position;
+            glm::vec3 normal = glm::cross(vertices[indices[t * 3 + 1]].position - p0,
+                                          vertices[indices[t * 3 + 2]].position - p0);
+            float length = glm::length(normal);
+            normals[t] = length > 0.0f ? normal / length : normal;
+        }
+
+        // Which meshlet last used every vertex and last had every triangle as a candidate, so neither needs clearing
+        const uint32 none = ~0u;
+        std::vector<uint32> vertexMeshlet(vertices.size(), none);
+        std::vector<uint32> candidateMeshlet(triangleCount, none);
+        std::vector<bool> emitted(triangleCount, false);
+
+        std::vector<GLuint> result;
+        result.reserve(triangleCount * 3);
+        std::vector<uint32> candidates;
+        size_t nextSeed = 0;
+
+        while (result.size() < triangleCount * 3)
+        {
+            uint32 id = (uint32) meshlets.size();
+            Meshlet meshlet;
+            meshlet.indexOffset = (uint32) result.size();
+
+            // Start next to where the last meshlet ended if possible, so consecutive meshlets stay close together
+            uint32 seed = none;
+            for (uint32 candidate : candidates)
+            {
+                if (!emitted[candidate])
+                {
+                    seed = candidate;
+                    break;
+                }
+            }
+
+            if (seed == none)
+            {
+                while (emitted[nextSeed])
+                {
+                    ++nextSeed;
+                }
+
+                seed = (uint32) nextSeed;
+            }
+
+            candidates.clear();
+            size_t vertexCount = 0;
+            glm::vec3 normalSum(0.0f);
+            uint32 triangle = seed;
+            while (true)
+            {
+                emitted[triangle] = true;
+                normalSum += normals[triangle];
+                for (int k = 0; k < 3; ++k)
+                {
+                    GLuint vertex = indices[triangle * 3 + k];
+                    result.push_back(vertex);
+                    if (vertexMeshlet[vertex] != id)
+                    {
+                        vertexMeshlet[vertex] = id;
+                        ++vertexCount;
+                    }
+
+                    GLuint position = positions[vertex];
+                    for (uint32 j = offsets[position]; j < offsets[position + 1]; ++j)
+                    {
+                        uint32 neighbour = adjacency[j];
+                        if (!emitted[neighbour] && candidateMeshlet[neighbour] != id)
+                        {
+                            candidateMeshlet[neighbour] = id;
+                            candidates.push_back(neighbour);
+                        }
+                    }
+                }
+
+                meshlet.indexCount += 3;
+                if (meshlet.indexCount / 3 >= maxTriangles)
+                    break;
+
+                // Pick the best candidate, dropping the ones that were emitted in the meantime
+                uint32 best = none;
+                float bestScore = std::numeric_limits<float>::max();
+                size_t write = 0;
+                for (uint32 candidate : candidates)
+                {
+                    if (emitted[candidate])
+                        continue;
+
+                    candidates[write++] = candidate;
+
+                    size_t newVertices = 0;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        if (vertexMeshlet[indices[candidate * 3 + k]] != id)
+                            ++newVertices;
+                    }
+
+                    if (vertexCount + newVertices > maxVertices)
+                        continue;
+
+                    float spread = 1.0f - glm::dot(normals[candidate], normalSum) /
+                                          std::max(glm::length(normalSum), 1e-12f);
+                    float score = (float) newVertices + spread * 2.0f;
+                    if (score < bestScore)
+                    {
+                        best = candidate;
+                        bestScore = score;
+                    }
+                }
+
+                candidates.resize(write);
+                if (best == none)
+                    break;
+
+                triangle = best;
+            }
+
+            finishMeshlet(vertices, result.data() + meshlet.indexOffset, meshlet);
+            meshlets.push_back(meshlet);
+        }
+
+        indices = std::move(result);
+        return meshlets;
+    }
+
+    size_t buildMeshlets(ModelPtr model, size_t maxVertices, size_t maxTriangles)
+    {
+        size_t count = 0;
+        for (auto& meshInfo : model->getMeshes())
+        {
+            if (meshInfo.mesh.get() == nullptr)
+                continue;
+
+            MeshPtr mesh = meshInfo.mesh;
+            std::vector<GLuint> indices = mesh->getIndices();
+            std::vector<Meshlet> meshlets = buildMeshlets(mesh->getVertices(), indices, maxVertices, maxTriangles);
+            mesh->setMeshlets(indices, meshlets);
+            count += meshlets.size();
+        }
+
+        return count;
+    }
+
+    MeshOptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<GLuint>& indices,
+                                       const MeshOptimizationOptions& options)
+    {
+        MeshOptimizationStats stats;
+        stats.vertexCountBefore = vertices.size();
+        stats.vertexCountAfter = vertices.size();
+        stats.triangleCount = indices.size() / 3;
+
+        // Out of range indices would make every step below read out of bounds
+        for (GLuint index : indices)
+        {
+            if (index >= vertices.size())
+                return stats;
+        }
+
+        // Leftover indices that don't form a triangle aren't drawn anyway
+        indices.resize(stats.triangleCount * 3);
+        stats.acmrBefore = getACMR(indices.data(), indices.size(), vertices.size());
+
+        if (options.weld)
+            weldVertices(vertices, indices);
+
+        if (options.vertexCache)
+        {
+            optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+
+            if (options.overdraw)
+                optimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size(),
+                                 options.overdrawThreshold);
+        }
+
+        if (options.vertexFetch)
+            optimizeVertexFetch(vertices, indices);
+
+        stats.vertexCountAfter = vertices.size();
+        stats.acmrAfter = getACMR(indices.data(), indices.size(), vertices.size());
+        return stats;
+    }
+
+    MeshOptimizationStats optimizeModel(ModelPtr model, const MeshOptimizationOptions& options)
+    {
+        MeshOptimizationStats total;
+        double missesBefore = 0.0;
+        double missesAfter = 0.0;
+
+        for (auto& meshInfo : model->getMeshes())
+        {
+            if (meshInfo.mesh.get() == nullptr)
+                continue;
+
+            std::vector<Vertex> vertices = meshInfo.mesh->getVertices();
+            std::vector<GLuint> indices = meshInfo.mesh->getIndices();
+            MeshOptimizationStats stats = optimizeMesh(vertices, indices, options);
+
+            meshInfo.mesh->setVertices(vertices);
+            meshInfo.mesh->setIndices(indices);
+
+            total.vertexCountBefore += stats.vertexCountBefore;
+            total.vertexCountAfter += stats.vertexCountAfter;
+            total.triangleCount += stats.triangleCount;
+            missesBefore += (double) stats.acmrBefore * stats.triangleCount;
+            missesAfter += (double) stats.acmrAfter * stats.triangleCount;
+        }
+
+        if (total.triangleCount > 0)
+        {
+            total.acmrBefore = (float) (missesBefore / (double) total.triangleCount);
+            total.acmrAfter = (float) (missesAfter / (double) total.triangleCount);
+        }
+
+        return total;
+    }
+}
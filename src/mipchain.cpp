@@ -0,0 +1,84 @@
+#include "mipchain.h"
+
+#include <algorithm>
+
+namespace wake
+{
+    int getMipLevelCount(int width, int height)
+    {
+        int levels = 1;
+        for (int size = std::max(width, height); size > 1; size /= 2)
+        {
+            ++levels;
+        }
+
+        return levels;
+    }
+
+    size_t getMipChainSize(int width, int height, int levelCount)
+    {
+        size_t size = 0;
+        for (int level = 0; level < levelCount; ++level)
+        {
+            size += (size_t) width * height * 4;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+
+        return size;
+    }
+
+    // Averages every texel of the source that lands on each destination texel. Normally that's a 2x2 box, but levels
+    // with odd (or 1 texel) dimensions fold the last row or column into their neighbours.
+    static void downsample(const uint8* in, int width, int height, uint8* out, int outWidth, int outHeight)
+    {
+        for (int y = 0; y < outHeight; ++y)
+        {
+            int y0 = y * height / outHeight;
+            int y1 = std::max(y0 + 1, (y + 1) * height / outHeight);
+
+            for (int x = 0; x < outWidth; ++x)
+            {
+                int x0 = x * width / outWidth;
+                int x1 = std::max(x0 + 1, (x + 1) * width / outWidth);
+
+                uint32 sum[4] = {0, 0, 0, 0};
+                for (int sy = y0; sy < y1; ++sy)
+                {
+                    const uint8* row = in + ((size_t) sy * width + x0) * 4;
+                    for (int sx = x0; sx < x1; ++sx, row += 4)
+                    {
+                        sum[0] += row[0];
+                        sum[1] += row[1];
+                        sum[2] += row[2];
+                        sum[3] += row[3];
+                    }
+                }
+
+                uint32 count = (uint32) ((y1 - y0) * (x1 - x0));
+                uint8* texel = out + ((size_t) y * outWidth + x) * 4;
+                for (int c = 0; c < 4; ++c)
+                {
+                    texel[c] = (uint8) ((sum[c] + count / 2) / count);
+                }
+            }
+        }
+    }
+
+    void generateMipChain(uint8* chain, int width, int height, int levelCount)
+    {
+        uint8* level = chain;
+        for (int i = 1; i < levelCount; ++i)
+        {
+            int nextWidth = std::max(1, width / 2);
+            int nextHeight = std::max(1, height / 2);
+            uint8* next = level + (size_t) width * height * 4;
+
+            downsample(level, width, height, next, nextWidth, nextHeight);
+
+            level = next;
+            width = nextWidth;
+            height = nextHeight;
+        }
+    }
+}
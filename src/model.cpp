@@ -1,6 +1,9 @@
 #include "model.h"
+#include "frameuniforms.h"
+#include "renderqueue.h"
 
 #include <algorithm>
+#include <iostream>
 
 namespace wake
 {
@@ -15,6 +18,8 @@ namespace wake
     {
         this->materials = other.materials;
         this->meshes = other.meshes;
+        this->lodThreshold = other.lodThreshold;
+        this->meshletCulling = other.meshletCulling;
     }
 
     Model::~Model()
@@ -25,6 +30,8 @@ namespace wake
     {
         this->materials = other.materials;
         this->meshes = other.meshes;
+        this->lodThreshold = other.lodThreshold;
+        this->meshletCulling = other.meshletCulling;
         return *this;
     }
 
@@ -219,8 +226,99 @@ namespace wake
         return true;
     }
 
+    Bounds Model::getBounds() const
+    {
+        Bounds bounds;
+        for (auto& meshInfo : meshes)
+        {
+            if (meshInfo.mesh.get() != nullptr)
+                bounds = mergeBounds(bounds, meshInfo.mesh->getBounds());
+        }
+
+        return bounds;
+    }
+
+    bool Model::getMeshletCulling() const
+    {
+        return meshletCulling;
+    }
+
+    void Model::setMeshletCulling(bool enabled)
+    {
+        meshletCulling = enabled;
+    }
+
+    float Model::getLodThreshold() const
+    {
+        return lodThreshold;
+    }
+
+    void Model::setLodThreshold(float threshold)
+    {
+        lodThreshold = threshold;
+    }
+
+    // Looks a matrix up the same way Material::use resolves it: parameterData first, then the global material. Shaders
+    // with the Frame block only ever see the global values of its members, so for those parameterData is skipped.
+    static bool findMatrix(MaterialPtr parameterData, const std::string& name, bool frameBlock, glm::mat4& matrix)
+    {
+        bool global = frameBlock && FrameUniforms::isMember(name);
+        bool overridden = parameterData.get() != nullptr &&
+                          parameterData->getParameter(name).type != MaterialParameter::Null;
+
+        // Only once, this would otherwise be printed for every draw
+        static bool warned = false;
+        if (global && overridden && !warned)
+        {
+            std::cout << "Model warning: shaders with the Frame block read \"" << name <<
+            "\" from the global material, the value passed to draw is ignored" << std::endl;
+            warned = true;
+        }
+
+        for (auto& material : {parameterData, Material::getGlobalMaterial()})
+        {
+            if (material.get() == nullptr || (global && material.get() == parameterData.get()))
+                continue;
+
+            MaterialParameter param = material->getParameter(name);
+            if (param.type == MaterialParameter::Mat4)
+            {
+                matrix = param.m4;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     void Model::draw(MaterialPtr parameterData)
     {
+        // Cull with the camera the shaders actually draw with
+        bool frameBlock = false;
+        for (auto& materialInfo : materials)
+        {
+            if (materialInfo.material.get() != nullptr && materialInfo.material->getShader().get() != nullptr &&
+                materialInfo.material->getShader()->hasFrameBlock())
+            {
+                frameBlock = true;
+            }
+        }
+
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::mat4 transform;
+        bool hasCamera = findMatrix(parameterData, "projection", frameBlock, projection) &&
+                         findMatrix(parameterData, "view", frameBlock, view) &&
+                         findMatrix(parameterData, "transform", frameBlock, transform);
+
+        // Culling happens in the model's own space, so nothing needs to be transformed per mesh or meshlet
+        glm::mat4 modelView = view * transform;
+        Frustum frustum = getFrustum(projection * modelView);
+        glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView)[3]);
+        bool perspective = projection[3][3] == 0.0f;
+
+        W_RENDER_QUEUE.beginGroup(parameterData, frustum, cameraPosition, perspective);
+
         for (auto& meshInfo : meshes)
         {
             if (meshInfo.materialIndex < 0 || (size_t) meshInfo.materialIndex >= materials.size())
@@ -230,17 +328,20 @@ namespace wake
             if (materialInfo.material.get() == nullptr)
                 continue;
 
-            materialInfo.material->use();
-
-            if (parameterData.get() != nullptr)
+            auto& mesh = meshInfo.mesh;
+            size_t level = 0;
+            if (hasCamera)
             {
-                for (auto entry : parameterData->getParameters())
-                {
-                    materialInfo.material->setTempParameter(entry.first, entry.second);
-                }
+                const Bounds& bounds = mesh->getBounds();
+                if (!bounds.empty && !isSphereVisible(frustum, bounds.center, bounds.radius))
+                    continue;
+
+                level = mesh->selectLod(modelView, projection, lodThreshold);
             }
 
-            meshInfo.mesh->draw();
+            // Meshlets only cover the full mesh, simplified levels are drawn whole
+            bool meshlets = hasCamera && level == 0 && meshletCulling && !mesh->getMeshlets().empty();
+            W_RENDER_QUEUE.submit(mesh, materialInfo.material, level, meshlets);
         }
     }
 }
\ No newline at end of file
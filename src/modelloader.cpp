@@ -0,0 +1,329 @@
+#include "modelloader.h"
+#include "meshopt.h"
+#include "threadpool.h"
+#include "vfs.h"
+#include "wake.h"
+#include "wmdl.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace wake
+{
+    static double getSeconds()
+    {
+        typedef std::chrono::duration<double> Seconds;
+        return std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Imports the scene's materials by name, along with their diffuse texture if it is a file next to the model. The
+    // texture is bound to tex1, the sampler the stock materials use, and the type name is left for the game to set.
+    static void loadAssimpMaterials(const aiScene* scene, const std::string& path, ModelPtr model)
+    {
+        std::string directory;
+        std::string::size_type slash = path.find_last_of("/\\");
+        if (slash != std::string::npos)
+            directory = path.substr(0, slash + 1);
+
+        for (size_t i = 0; i < scene->mNumMaterials; ++i)
+        {
+            aiMaterial* source = scene->mMaterials[i];
+
+            aiString aiName;
+            std::string name;
+            if (source->Get(AI_MATKEY_NAME, aiName) == AI_SUCCESS)
+                name = aiName.C_Str();
+
+            if (name.empty())
+                name = "material" + std::to_string(i);
+
+            // Materials are looked up by name, so duplicates get a suffix to keep the indices lined up with assimp's
+            std::string uniqueName = name;
+            for (int suffix = 1; model->getMaterialIndex(uniqueName) >= 0; ++suffix)
+            {
+                uniqueName = name + "." + std::to_string(suffix);
+            }
+
+            MaterialPtr material(new Material());
+
+            aiString texturePath;
+            if (source->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == AI_SUCCESS &&
+                texturePath.C_Str()[0] != '*')
+            {
+                std::string fullPath = directory + texturePath.C_Str();
+                std::replace(fullPath.begin(), fullPath.end(), '\\', '/');
+
+                TexturePtr texture = Texture::load(fullPath.c_str());
+                if (texture.get() != nullptr)
+                    material->setTexture("tex1", texture);
+            }
+
+            model->addMaterial(uniqueName, material);
+        }
+    }
+
+    ModelPtr loadAssimpModel(const char* path, bool optimize)
+    {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path,
+                                                 aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
+
+        if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        {
+            std::cout << "loadModel error: " << importer.GetErrorString() << std::endl;
+            return ModelPtr(nullptr);
+        }
+
+        ModelPtr model(new Model());
+        loadAssimpMaterials(scene, path, model);
+
+        for (size_t i = 0; i < scene->mNumMeshes; ++i)
+        {
+            aiMesh* mesh = scene->mMeshes[i];
+
+            std::vector<Vertex> vertices;
+            std::vector<GLuint> indices;
+
+            for (size_t v = 0; v < mesh->mNumVertices; ++v)
+            {
+                aiVector3D& position = mesh->mVertices[v];
+                aiVector3D& normal = mesh->mNormals[v];
+
+                Vertex vertex;
+                vertex.position = glm::vec3(position.x, position.y, position.z);
+                vertex.normal = glm::vec3(normal.x, normal.y, normal.z);
+
+                if (mesh->mTextureCoords[0])
+                {
+                    vertex.texCoords = glm::vec2(mesh->mTextureCoords[0][v].x, mesh->mTextureCoords[0][v].y);
+                }
+
+                vertices.push_back(vertex);
+            }
+
+            for (size_t v = 0; v < mesh->mNumFaces; ++v)
+            {
+                aiFace& face = mesh->mFaces[v];
+                for (size_t f = 0; f < face.mNumIndices; ++f)
+                {
+                    indices.push_back(face.mIndices[f]);
+                }
+            }
+
+            if (optimize)
+                optimizeMesh(vertices, indices);
+
+            int32 materialIndex = (int32) mesh->mMaterialIndex < model->getMaterialCount() ? mesh->mMaterialIndex : -1;
+            model->addMesh(MeshPtr(new Mesh(vertices, indices)), materialIndex);
+        }
+
+        ModelMetadata metadata;
+        metadata.source = ModelMetadata::Assimp;
+        metadata.path = path;
+
+        model->setMetadata(metadata);
+
+        return model;
+    }
+
+    ModelPtr loadModel(const char* path, bool lazy, bool optimize)
+    {
+        std::string pathString(path);
+        std::string::size_type pathPos = pathString.rfind('.');
+        if (pathPos != std::string::npos && pathString.substr(pathPos + 1) == "wmdl")
+        {
+            return loadWMDL(path, lazy);
+        }
+
+        return loadAssimpModel(path, optimize);
+    }
+
+    ModelRequest::ModelRequest(const std::string& path, bool lazy, bool optimize)
+            : path(path), lazy(lazy), optimize(optimize)
+    {
+    }
+
+    const std::string& ModelRequest::getPath() const
+    {
+        return path;
+    }
+
+    bool ModelRequest::isLazy() const
+    {
+        return lazy;
+    }
+
+    bool ModelRequest::isOptimized() const
+    {
+        return optimize;
+    }
+
+    ModelRequest::Status ModelRequest::getStatus() const
+    {
+        return status;
+    }
+
+    bool ModelRequest::isDone() const
+    {
+        return status == Status::Ready || status == Status::Failed;
+    }
+
+    ModelPtr ModelRequest::getModel() const
+    {
+        return status == Status::Ready ? model : ModelPtr(nullptr);
+    }
+
+    ModelLoader& ModelLoader::get()
+    {
+        static ModelLoader instance;
+        return instance;
+    }
+
+    ModelRequestPtr ModelLoader::loadAsync(const std::string& path, bool lazy, bool optimize)
+    {
+        ModelRequestPtr request(new ModelRequest(path, lazy, optimize));
+
+        // The file is read on the I/O threads right away, rather than once a worker gets to the request. loadModel
+        // picks the read up through the VFS, the task just keeps it alive until then.
+        ReadRequestPtr read = W_VFS.readAsync(path);
+        request->result = request->tasks.submit([path, lazy, optimize, read]() {
+            DeferUploadsScope scope;
+            return loadModel(path.c_str(), lazy, optimize);
+        });
+
+        pending.push_back(request);
+        return request;
+    }
+
+    void ModelLoader::update(double budget)
+    {
+        double deadline = getSeconds() + budget;
+
+        // Work on a copy, LoadedEvent handlers may start new loads
+        std::vector<ModelRequestPtr> requests(pending.begin(), pending.end());
+        for (auto& request : requests)
+        {
+            if (!advance(request, deadline, false) && request->status == ModelRequest::Status::Uploading &&
+                getSeconds() >= deadline)
+            {
+                break;
+            }
+        }
+
+        std::vector<ModelRequestPtr> done;
+        for (auto& request : requests)
+        {
+            if (request->isDone())
+                done.push_back(request);
+        }
+
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [](const ModelRequestPtr& request) {
+            return request->isDone();
+        }), pending.end());
+
+        for (auto& request : done)
+        {
+            LoadedEvent.call(request);
+        }
+    }
+
+    void ModelLoader::finish(ModelRequestPtr request)
+    {
+        advance(request, 0.0, true);
+    }
+
+    size_t ModelLoader::getPendingCount() const
+    {
+        return (size_t) std::count_if(pending.begin(), pending.end(), [](const ModelRequestPtr& request) {
+            return !request->isDone();
+        });
+    }
+
+    double ModelLoader::getUploadBudget() const
+    {
+        return uploadBudget;
+    }
+
+    void ModelLoader::setUploadBudget(double budget)
+    {
+        uploadBudget = budget;
+    }
+
+    ModelLoader::ModelLoader()
+    {
+    }
+
+    bool ModelLoader::advance(ModelRequestPtr request, double deadline, bool block)
+    {
+        if (request->status == ModelRequest::Status::Loading)
+        {
+            if (!block && request->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return false;
+
+            ModelPtr model;
+            try
+            {
+                model = request->tasks.wait(request->result);
+            }
+            catch (std::exception& e)
+            {
+                std::cout << "ModelLoader error: unable to load " << request->path << ": " << e.what() << std::endl;
+            }
+
+            if (model.get() == nullptr)
+            {
+                request->status = ModelRequest::Status::Failed;
+                return true;
+            }
+
+            request->model = model;
+            for (auto& meshInfo : model->getMeshes())
+            {
+                if (meshInfo.mesh.get() != nullptr)
+                    request->meshes.push_back(meshInfo.mesh);
+            }
+
+            for (auto& matInfo : model->getMaterials())
+            {
+                for (auto& texEntry : matInfo.material->getTextures())
+                {
+                    TexturePtr texture = texEntry.second.texture;
+                    if (texture.get() != nullptr &&
+                        std::find(request->textures.begin(), request->textures.end(), texture) ==
+                        request->textures.end())
+                    {
+                        request->textures.push_back(texture);
+                    }
+                }
+            }
+
+            request->status = ModelRequest::Status::Uploading;
+        }
+
+        if (request->status == ModelRequest::Status::Uploading)
+        {
+            size_t total = request->meshes.size() + request->textures.size();
+            while (request->uploaded < total)
+            {
+                if (request->uploaded < request->meshes.size())
+                    request->meshes[request->uploaded]->upload();
+                else
+                    request->textures[request->uploaded - request->meshes.size()]->upload();
+
+                ++request->uploaded;
+                if (!block && request->uploaded < total && getSeconds() >= deadline)
+                    return false;
+            }
+
+            request->meshes.clear();
+            request->textures.clear();
+            request->status = ModelRequest::Status::Ready;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,241 @@
+#include "renderqueue.h"
+#include "frameuniforms.h"
+#include "wake.h"
+
+#include <algorithm>
+
+// Widths of the fields in a draw's sort key, from the most significant
+#define W_KEY_SHADER_BITS 12
+#define W_KEY_TEXTURE_SET_BITS 16
+#define W_KEY_MATERIAL_BITS 20
+#define W_KEY_MESH_BITS 16
+
+namespace wake
+{
+    // Ids past what a field holds share its largest value
+    static uint64 keyField(size_t id, uint32 bits)
+    {
+        uint64 maximum = (1ull << bits) - 1;
+        return std::min((uint64) id, maximum);
+    }
+
+    template<typename Map, typename Key>
+    static uint32 findId(Map& ids, const Key& key)
+    {
+        auto inserted = ids.insert(std::make_pair(key, (uint32) ids.size()));
+        return inserted.first->second;
+    }
+
+    // Whether next sets every parameter last did, so nothing last set is left on the program
+    static bool overrides(const MaterialParameters& next, const MaterialParameters& last)
+    {
+        for (size_t i = 0; i < last.getCount(); ++i)
+        {
+            if (next.find(last.getName(i)) == next.getCount())
+                return false;
+        }
+
+        return true;
+    }
+
+    RenderQueue& RenderQueue::get()
+    {
+        static RenderQueue instance;
+        return instance;
+    }
+
+    RenderQueue::RenderQueue()
+    {
+    }
+
+    void RenderQueue::beginGroup(MaterialPtr parameterData, const Frustum& frustum, const glm::vec3& cameraPosition,
+                                 bool cullBackfaces)
+    {
+        groups.emplace_back();
+        DrawGroup& group = groups.back();
+        if (parameterData.get() != nullptr)
+            group.parameters = parameterData->getParameters();
+
+        group.frustum = frustum;
+        group.cameraPosition = cameraPosition;
+        group.cullBackfaces = cullBackfaces;
+    }
+
+    void RenderQueue::submit(MeshPtr mesh, MaterialPtr material, size_t level, bool meshlets)
+    {
+        if (mesh.get() == nullptr || material.get() == nullptr)
+            return;
+
+        // Draws submitted without a group of their own have no parameters and are never culled by meshlet
+        if (groups.empty())
+        {
+            beginGroup(nullptr, Frustum(), glm::vec3(0.0f), false);
+            meshlets = false;
+        }
+
+        ShaderPtr shader = material->getShader();
+
+        auto found = materialKeys.find(material.get());
+        if (found == materialKeys.end())
+        {
+            TextureSet textures;
+            for (auto& entry : material->getTextures())
+            {
+                if (entry.second.texture.get() != nullptr)
+                    textures.push_back(std::make_pair(entry.first, entry.second.texture.get()));
+            }
+
+            MaterialKey materialKey;
+            materialKey.textureSet = findId(textureSetIds, textures);
+
+            size_t shaderId = findId(shaderIds, (const Shader*) shader.get());
+            size_t materialId = materialKeys.size();
+            materialKey.key = keyField(shaderId, W_KEY_SHADER_BITS);
+            materialKey.key = (materialKey.key << W_KEY_TEXTURE_SET_BITS) |
+                              keyField(materialKey.textureSet, W_KEY_TEXTURE_SET_BITS);
+            materialKey.key = (materialKey.key << W_KEY_MATERIAL_BITS) | keyField(materialId, W_KEY_MATERIAL_BITS);
+            materialKey.key <<= W_KEY_MESH_BITS;
+
+            found = materialKeys.insert(std::make_pair(material.get(), materialKey)).first;
+        }
+
+        uint64 meshId = keyField(findId(meshIds, (const Mesh*) mesh.get()), W_KEY_MESH_BITS);
+        order.push_back(std::make_pair(found->second.key | meshId, (uint32) items.size()));
+
+        DrawItem item;
+        item.mesh = mesh;
+        item.material = material;
+        item.shader = shader;
+        item.textureSet = found->second.textureSet;
+        item.group = (uint32) (groups.size() - 1);
+        item.level = (uint32) level;
+        item.meshlets = meshlets;
+        items.push_back(item);
+    }
+
+    size_t RenderQueue::getPendingCount() const
+    {
+        return items.size();
+    }
+
+    void RenderQueue::flush()
+    {
+        std::sort(order.begin(), order.end());
+
+        // Global parameters are the same for every draw, shaders with the frame block read them from one buffer
+        W_FRAME_UNIFORMS.update();
+
+        bool issue = getEngineMode() == EngineMode::Normal;
+
+        const Shader* currentShader = nullptr;
+        const Material* currentMaterial = nullptr;
+        uint32 currentTextureSet = 0;
+        uint32 currentGroup = 0;
+        bool first = true;
+
+        for (auto& entry : order)
+        {
+            DrawItem& item = items[entry.second];
+            Material* material = item.material.get();
+            DrawGroup& group = groups[item.group];
+
+            // A null shader sets nothing, the mesh is drawn with whatever was set before, as Material::use does
+            if (item.shader.get() != nullptr)
+            {
+                bool shaderChanged = first || item.shader.get() != currentShader;
+                bool textureSetChanged = shaderChanged || item.textureSet != currentTextureSet;
+                bool materialChanged = shaderChanged || material != currentMaterial;
+                bool groupChanged = materialChanged || item.group != currentGroup;
+
+                // Parameters the last group set that this one doesn't would keep overriding the material's own values
+                bool applyMaterial = materialChanged ||
+                                     (groupChanged && !overrides(group.parameters, groups[currentGroup].parameters));
+
+                if (shaderChanged)
+                {
+                    ++stats.shaderChanges;
+                    if (issue)
+                        item.shader->use();
+                }
+
+                // Sampler uniforms belong to the program, so a new shader needs its textures set even if they match
+                if (textureSetChanged)
+                {
+                    ++stats.textureChanges;
+                    if (issue)
+                        material->bindTextures();
+                }
+
+                if (applyMaterial)
+                {
+                    ++stats.batches;
+                    if (issue)
+                        material->applyParameters();
+                }
+
+                // The material may have overwritten the last group's parameters
+                if (issue && groupChanged)
+                {
+                    for (size_t i = 0; i < group.parameters.getCount(); ++i)
+                    {
+                        material->setTempParameter(group.parameters.getName(i), group.parameters.get(i));
+                    }
+                }
+
+                currentShader = item.shader.get();
+                currentTextureSet = item.textureSet;
+                currentMaterial = material;
+                currentGroup = item.group;
+                first = false;
+            }
+
+            // Mesh draws do nothing outside of EngineMode::Normal on their own
+            if (item.meshlets)
+                item.mesh->drawMeshlets(group.frustum, group.cameraPosition, group.cullBackfaces);
+            else
+                item.mesh->draw(item.level);
+
+            ++stats.draws;
+        }
+
+        clear();
+    }
+
+    void RenderQueue::materialChanging(const Material* material)
+    {
+        if (items.empty())
+            return;
+
+        // Every draw reads the global material, but other materials only matter to their own draws
+        if (material == Material::getGlobalMaterial().get() || materialKeys.count(material) > 0)
+            flushPending();
+    }
+
+    void RenderQueue::flushPending()
+    {
+        DrawGroup group = groups.back();
+        flush();
+        groups.push_back(group);
+    }
+
+    void RenderQueue::clear()
+    {
+        groups.clear();
+        items.clear();
+        order.clear();
+        shaderIds.clear();
+        textureSetIds.clear();
+        materialKeys.clear();
+        meshIds.clear();
+    }
+
+    const RenderStats& RenderQueue::getStats() const
+    {
+        return stats;
+    }
+
+    void RenderQueue::resetStats()
+    {
+        stats = RenderStats();
+    }
+}
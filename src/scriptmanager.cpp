@@ -1,11 +1,64 @@
 #include "scriptmanager.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include "moduleregistry.h"
+#include "vfs.h"
 
 namespace wake
 {
+    // Replaces the Lua file searcher in package.loaders. Tries the same package.path patterns, but reads through the VFS
+    // (see vfs.h), so modules are found in the mounted archives as well and are included in prefetch recordings.
+    static int loadModule(lua_State* L)
+    {
+        std::string name = luaL_checkstring(L, 1);
+        std::replace(name.begin(), name.end(), '.', '/');
+
+        lua_getglobal(L, "package");
+        lua_getfield(L, -1, "path");
+        std::string patterns = lua_isstring(L, -1) ? lua_tostring(L, -1) : "";
+        lua_pop(L, 2);
+
+        std::string tried;
+        size_t position = 0;
+        while (position < patterns.size())
+        {
+            size_t end = patterns.find(';', position);
+            if (end == std::string::npos)
+                end = patterns.size();
+
+            std::string path = patterns.substr(position, end - position);
+            position = end + 1;
+            if (path.empty())
+                continue;
+
+            for (size_t mark = path.find('?'); mark != std::string::npos; mark = path.find('?', mark + name.size()))
+            {
+                path.replace(mark, 1, name);
+            }
+
+            MappedFilePtr file = W_VFS.read(path);
+            if (file.get() == nullptr)
+            {
+                tried += "\n\tno file '" + path + "'";
+                continue;
+            }
+
+            std::string chunkName = "@" + path;
+            if (luaL_loadbuffer(L, file->getData(), file->getSize(), chunkName.c_str()) != 0)
+            {
+                return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s", lua_tostring(L, 1),
+                                  path.c_str(), lua_tostring(L, -1));
+            }
+
+            return 1;
+        }
+
+        lua_pushstring(L, tried.c_str());
+        return 1;
+    }
+
     ScriptManager& ScriptManager::get()
     {
         static ScriptManager instance;
@@ -27,6 +80,12 @@ namespace wake
 
         setPath(W_SCRIPT_PATH);
 
+        lua_getglobal(state, "package");
+        lua_getfield(state, -1, "loaders");
+        lua_pushcfunction(state, loadModule);
+        lua_rawseti(state, -2, 2);
+        lua_pop(state, 2);
+
         W_MODULE_REGISTRY.registerAll(state);
 
         return true;
@@ -55,7 +114,12 @@ namespace wake
 
     bool ScriptManager::doFile(const char* path)
     {
-        if (luaL_loadfile(state, path) != 0)
+        // Missing files go through luaL_loadfile anyway, for its error message
+        MappedFilePtr file = W_VFS.read(path);
+        std::string chunkName = std::string("@") + path;
+        int error = file.get() != nullptr ? luaL_loadbuffer(state, file->getData(), file->getSize(), chunkName.c_str())
+                                          : luaL_loadfile(state, path);
+        if (error != 0)
         {
             std::cout << "Unable to run script: " << lua_tostring(state, -1) << std::endl;
             return false;
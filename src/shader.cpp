@@ -1,4 +1,6 @@
 #include "shader.h"
+#include "frameuniforms.h"
+#include "glstate.h"
 #include "wake.h"
 
 #include <iostream>
@@ -170,6 +172,17 @@ namespace wake
         glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, glm::value_ptr(m44));
     }
 
+    // Points the program's per-frame block, if it declares one, at the frame uniform buffer
+    static bool bindFrameBlock(GLuint program)
+    {
+        GLuint index = glGetUniformBlockIndex(program, W_FRAME_BLOCK_NAME);
+        if (index == GL_INVALID_INDEX)
+            return false;
+
+        glUniformBlockBinding(program, index, W_FRAME_BLOCK_BINDING);
+        return true;
+    }
+
     ShaderPtr Shader::compile(const char* vertexSource, const char* fragmentSource)
     {
         if (getEngineMode() != EngineMode::Normal)
@@ -220,12 +233,14 @@ namespace wake
         glAttachShader(shaderProgram, fragmentShader);
         glLinkProgram(shaderProgram);
 
-        return ShaderPtr(new Shader(shaderProgram, vertexShader, fragmentShader));
+        ShaderPtr shader(new Shader(shaderProgram, vertexShader, fragmentShader));
+        shader->frameBlock = bindFrameBlock(shaderProgram);
+        return shader;
     }
 
     void Shader::reset()
     {
-        glUseProgram(0);
+        W_GL_STATE.useProgram(0);
     }
 
     Shader::Shader(GLuint shaderProgram, GLuint vertexShader, GLuint fragmentShader)
@@ -240,6 +255,7 @@ namespace wake
         glAttachShader(shaderProgram, vertexShader);
         glAttachShader(shaderProgram, fragmentShader);
         glLinkProgram(shaderProgram);
+        frameBlock = bindFrameBlock(shaderProgram);
     }
 
     Shader& Shader::operator=(const Shader& other)
@@ -251,6 +267,7 @@ namespace wake
         glAttachShader(shaderProgram, vertexShader);
         glAttachShader(shaderProgram, fragmentShader);
         glLinkProgram(shaderProgram);
+        frameBlock = bindFrameBlock(shaderProgram);
 
         return *this;
     }
@@ -258,12 +275,17 @@ namespace wake
     Shader::~Shader()
     {
         if (getEngineMode() == EngineMode::Normal)
-            glDeleteProgram(shaderProgram);
+            W_GL_STATE.deleteProgram(shaderProgram);
     }
 
     void Shader::use()
     {
-        glUseProgram(shaderProgram);
+        W_GL_STATE.useProgram(shaderProgram);
+    }
+
+    bool Shader::hasFrameBlock() const
+    {
+        return frameBlock;
     }
 
     GLuint Shader::getProgram() const
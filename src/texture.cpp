@@ -1,8 +1,12 @@
 #include "texture.h"
+#include "glstate.h"
+#include "texturecache.h"
+#include "mipchain.h"
 #include "wake.h"
 
 #include <stb_image.h>
 
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
@@ -10,12 +14,22 @@
 namespace wake
 {
     TexturePtr Texture::load(const char* path)
+    {
+        return W_TEXTURE_CACHE.load(path);
+    }
+
+    TexturePtr Texture::decode(const unsigned char* fileData, size_t size, const std::string& path)
     {
         int width;
         int height;
         int comp;
-        stbi_set_flip_vertically_on_load(1); // we need to flip the y axis due to OpenGL
-        unsigned char* data = stbi_load(path, &width, &height, &comp, STBI_rgb_alpha);
+
+        // We need to flip the y axis due to OpenGL. The flag is global to stb_image, so only set it once instead of
+        // on every (possibly concurrent) decode.
+        static bool flip = (stbi_set_flip_vertically_on_load(1), true);
+        (void) flip;
+
+        unsigned char* data = stbi_load_from_memory(fileData, (int) size, &width, &height, &comp, STBI_rgb_alpha);
         if (data == nullptr)
         {
             std::cout << "Texture::load error: there was a problem loading the texture " << path << std::endl;
@@ -47,13 +61,26 @@ namespace wake
         initializeData();
     }
 
+    Texture::Texture(unsigned char* data, int width, int height, int comp, int levelCount, const std::string& path)
+    {
+        this->data = data;
+        this->width = width;
+        this->height = height;
+        this->comp = comp;
+        this->levelCount = levelCount;
+        this->path = path;
+
+        initializeData();
+    }
+
     Texture::Texture(const Texture& other)
     {
-        data = (unsigned char*) malloc(sizeof(unsigned char) * other.width * other.height * other.comp);
-        memcpy(data, other.data, sizeof(unsigned char) * other.width * other.height * other.comp);
+        data = (unsigned char*) malloc(other.getDataSize());
+        memcpy(data, other.data, other.getDataSize());
         width = other.width;
         height = other.height;
         comp = other.comp;
+        levelCount = other.levelCount;
 
         initializeData();
     }
@@ -64,18 +91,19 @@ namespace wake
 
         if (texture != 0)
         {
-            glDeleteTextures(1, &texture);
+            W_GL_STATE.deleteTexture(texture);
             texture = 0;
         }
     }
 
     Texture& Texture::operator=(const Texture& other)
     {
-        data = (unsigned char*) malloc(sizeof(unsigned char) * other.width * other.height * other.comp);
-        memcpy(data, other.data, sizeof(unsigned char) * other.width * other.height * other.comp);
+        data = (unsigned char*) malloc(other.getDataSize());
+        memcpy(data, other.data, other.getDataSize());
         width = other.width;
         height = other.height;
         comp = other.comp;
+        levelCount = other.levelCount;
 
         initializeData();
 
@@ -102,14 +130,35 @@ namespace wake
         return comp;
     }
 
+    int Texture::getLevelCount() const
+    {
+        return levelCount;
+    }
+
     const std::string& Texture::getPath() const
     {
         return path;
     }
 
+    bool Texture::isUploaded() const
+    {
+        return texture != 0;
+    }
+
+    void Texture::upload()
+    {
+        if (getEngineMode() != EngineMode::Normal || isUploaded())
+        {
+            return;
+        }
+
+        initializeData();
+    }
+
     void Texture::bind()
     {
-        glBindTexture(GL_TEXTURE_2D, texture);
+        upload();
+        W_GL_STATE.bindTexture(texture);
     }
 
     void Texture::generateMipMaps()
@@ -122,7 +171,7 @@ namespace wake
 
     void Texture::activate(GLenum unit)
     {
-        glActiveTexture(GL_TEXTURE0 + unit);
+        W_GL_STATE.activeTexture(unit);
         bind();
 
         W_GL_CHECK();
@@ -130,7 +179,7 @@ namespace wake
 
     void Texture::initializeData()
     {
-        if (getEngineMode() != EngineMode::Normal)
+        if (getEngineMode() != EngineMode::Normal || getDeferUploads())
         {
             return;
         }
@@ -144,20 +193,41 @@ namespace wake
         }
 
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        W_GL_STATE.bindTexture(texture);
 
         W_GL_CHECK();
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+        // Leave the maximum level alone for single level textures so generateMipMaps can fill in the rest
+        if (levelCount > 1)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
         W_GL_CHECK();
 
         if (data)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        {
+            const unsigned char* level = data;
+            int levelWidth = width;
+            int levelHeight = height;
+            for (int i = 0; i < levelCount; ++i)
+            {
+                glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, level);
+
+                level += getMipChainSize(levelWidth, levelHeight, 1);
+                levelWidth = std::max(1, levelWidth / 2);
+                levelHeight = std::max(1, levelHeight / 2);
+            }
+        }
 
         W_GL_CHECK();
     }
+
+    size_t Texture::getDataSize() const
+    {
+        return getMipChainSize(width, height, levelCount);
+    }
 }
\ No newline at end of file
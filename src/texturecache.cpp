@@ -0,0 +1,175 @@
+#include "texturecache.h"
+#include "fileutil.h"
+#include "vfs.h"
+
+#include <iostream>
+#include <vector>
+
+namespace wake
+{
+    TextureCache& TextureCache::get()
+    {
+        static TextureCache instance;
+        return instance;
+    }
+
+    TexturePtr TextureCache::load(const std::string& path)
+    {
+        std::string key = normalizePath(path);
+        bool hash;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            loaded.wait(lock, [this, &key]() {
+                return loading.count(key) == 0;
+            });
+
+            TexturePtr texture = findLocked(key);
+            if (texture.get() != nullptr)
+            {
+                ++hits;
+                return texture;
+            }
+
+            loading.insert(key);
+            hash = hashContents;
+        }
+
+        // Read and decode without holding the lock, other textures can load in the meantime
+        TexturePtr texture;
+        bool decoded = false;
+        uint64 contentHash = 0;
+
+        MappedFilePtr file = W_VFS.read(path);
+        if (file.get() == nullptr)
+        {
+            std::cout << "Texture::load error: unable to open " << path << std::endl;
+        }
+        else
+        {
+            if (hash)
+            {
+                contentHash = hashBytes(file->getData(), file->getSize());
+
+                std::unique_lock<std::mutex> lock(mutex);
+                auto it = contents.find(contentHash);
+                if (it != contents.end())
+                {
+                    texture = it->second.lock();
+                    if (texture.get() == nullptr)
+                        contents.erase(it);
+                }
+            }
+
+            if (texture.get() == nullptr)
+            {
+                texture = Texture::decode((const unsigned char*) file->getData(), file->getSize(), path);
+                decoded = true;
+            }
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            loading.erase(key);
+
+            if (texture.get() != nullptr)
+            {
+                entries[key] = texture;
+                if (hash)
+                    contents[contentHash] = texture;
+            }
+
+            if (decoded || texture.get() == nullptr)
+                ++misses;
+            else
+                ++hits;
+        }
+
+        loaded.notify_all();
+        return texture;
+    }
+
+    TexturePtr TextureCache::find(const std::string& path)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return findLocked(normalizePath(path));
+    }
+
+    void TextureCache::insert(TexturePtr texture)
+    {
+        if (texture.get() == nullptr || texture->getPath().empty())
+            return;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        entries[normalizePath(texture->getPath())] = texture;
+    }
+
+    bool TextureCache::getHashContents() const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return hashContents;
+    }
+
+    void TextureCache::setHashContents(bool hash)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        hashContents = hash;
+    }
+
+    uint64 TextureCache::getHits() const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return hits;
+    }
+
+    uint64 TextureCache::getMisses() const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return misses;
+    }
+
+    size_t TextureCache::getSize() const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        size_t size = 0;
+        for (auto& entry : entries)
+        {
+            if (!entry.second.expired())
+                ++size;
+        }
+
+        return size;
+    }
+
+    void TextureCache::resetStats()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        hits = 0;
+        misses = 0;
+    }
+
+    void TextureCache::clear()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        entries.clear();
+        contents.clear();
+    }
+
+    TextureCache::TextureCache()
+    {
+    }
+
+    TexturePtr TextureCache::findLocked(const std::string& key)
+    {
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return TexturePtr(nullptr);
+
+        TexturePtr texture = it->second.lock();
+        if (texture.get() == nullptr)
+            entries.erase(it);
+
+        return texture;
+    }
+}
@@ -0,0 +1,93 @@
+#include "threadpool.h"
+
+namespace wake
+{
+    ThreadPool& ThreadPool::get()
+    {
+        static ThreadPool instance(std::thread::hardware_concurrency());
+        return instance;
+    }
+
+    ThreadPool::ThreadPool(size_t threadCount)
+    {
+        if (threadCount == 0)
+            threadCount = 1;
+
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        condition.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    size_t ThreadPool::getThreadCount() const
+    {
+        return workers.size();
+    }
+
+    void ThreadPool::enqueue(JobPtr job)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            tasks.push(job);
+        }
+
+        condition.notify_one();
+    }
+
+    void ThreadPool::workerLoop()
+    {
+        while (true)
+        {
+            JobPtr job;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+                if (stopping && tasks.empty())
+                    return;
+
+                job = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            // Skipped if the group it belongs to ran it already
+            job->claimAndRun();
+        }
+    }
+
+    TaskGroup::TaskGroup(ThreadPool& pool)
+            : pool(pool)
+    {
+    }
+
+    bool TaskGroup::runPendingTask()
+    {
+        // Tasks a worker claimed are just dropped from the group, they are already running or done
+        while (!jobs.empty())
+        {
+            ThreadPool::JobPtr job = jobs.front();
+            jobs.pop_front();
+
+            if (job->claimAndRun())
+                return true;
+        }
+
+        return false;
+    }
+}
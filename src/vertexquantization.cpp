@@ -0,0 +1,173 @@
+#include "vertexquantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace wake
+{
+    static int16 toSnorm16(float value)
+    {
+        value = std::max(-1.0f, std::min(1.0f, value)) * 32767.0f;
+        return (int16) std::floor(value + 0.5f);
+    }
+
+    static float fromSnorm16(int16 value)
+    {
+        return std::max(-1.0f, value / 32767.0f);
+    }
+
+    static uint16 toUnorm16(float value)
+    {
+        value = std::max(0.0f, std::min(1.0f, value)) * 65535.0f;
+        return (uint16) std::floor(value + 0.5f);
+    }
+
+    static float fromUnorm16(uint16 value)
+    {
+        return value / 65535.0f;
+    }
+
+    static float signNotZero(float value)
+    {
+        return value < 0.0f ? -1.0f : 1.0f;
+    }
+
+    // Projects the unit sphere onto an octahedron and unfolds it into the [-1, 1] square
+    static glm::vec2 encodeOctahedral(const glm::vec3& normal)
+    {
+        float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (sum == 0.0f)
+            return glm::vec2(0.0f, 0.0f);
+
+        glm::vec2 result(normal.x / sum, normal.y / sum);
+        if (normal.z < 0.0f)
+        {
+            result = glm::vec2((1.0f - std::abs(result.y)) * signNotZero(result.x),
+                               (1.0f - std::abs(result.x)) * signNotZero(result.y));
+        }
+
+        return result;
+    }
+
+    static glm::vec3 decodeOctahedral(const glm::vec2& encoded)
+    {
+        glm::vec3 result(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+        if (result.z < 0.0f)
+        {
+            result.x = (1.0f - std::abs(encoded.y)) * signNotZero(encoded.x);
+            result.y = (1.0f - std::abs(encoded.x)) * signNotZero(encoded.y);
+        }
+
+        return glm::normalize(result);
+    }
+
+    VertexQuantization getVertexQuantization(const Vertex* vertices, size_t count)
+    {
+        VertexQuantization quantization;
+        quantization.positionCenter = glm::vec3(0.0f);
+        quantization.positionExtent = glm::vec3(1.0f);
+        quantization.texCoordMin = glm::vec2(0.0f);
+        quantization.texCoordExtent = glm::vec2(1.0f);
+
+        if (count == 0)
+            return quantization;
+
+        glm::vec3 minPosition = vertices[0].position;
+        glm::vec3 maxPosition = vertices[0].position;
+        glm::vec2 minTexCoords = vertices[0].texCoords;
+        glm::vec2 maxTexCoords = vertices[0].texCoords;
+        for (size_t i = 1; i < count; ++i)
+        {
+            minPosition = glm::min(minPosition, vertices[i].position);
+            maxPosition = glm::max(maxPosition, vertices[i].position);
+            minTexCoords = glm::min(minTexCoords, vertices[i].texCoords);
+            maxTexCoords = glm::max(maxTexCoords, vertices[i].texCoords);
+        }
+
+        quantization.positionCenter = (minPosition + maxPosition) * 0.5f;
+        quantization.texCoordMin = minTexCoords;
+        for (int i = 0; i < 3; ++i)
+        {
+            float extent = (maxPosition[i] - minPosition[i]) * 0.5f;
+            quantization.positionExtent[i] = extent > 0.0f ? extent : 1.0f;
+        }
+
+        for (int i = 0; i < 2; ++i)
+        {
+            float extent = maxTexCoords[i] - minTexCoords[i];
+            quantization.texCoordExtent[i] = extent > 0.0f ? extent : 1.0f;
+        }
+
+        return quantization;
+    }
+
+    void quantizeVertices(const Vertex* vertices, size_t count, const VertexQuantization& quantization,
+                          QuantizedVertex* out)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Vertex& vertex = vertices[i];
+            QuantizedVertex& result = out[i];
+
+            glm::vec3 position = (vertex.position - quantization.positionCenter) / quantization.positionExtent;
+            glm::vec2 normal = encodeOctahedral(vertex.normal);
+            glm::vec2 texCoords = (vertex.texCoords - quantization.texCoordMin) / quantization.texCoordExtent;
+
+            for (int c = 0; c < 3; ++c)
+                result.position[c] = toSnorm16(position[c]);
+
+            result.normal[0] = toSnorm16(normal.x);
+            result.normal[1] = toSnorm16(normal.y);
+            result.texCoords[0] = toUnorm16(texCoords.x);
+            result.texCoords[1] = toUnorm16(texCoords.y);
+            result.reserved = 0;
+        }
+    }
+
+    void dequantizeVertices(const QuantizedVertex* vertices, size_t count, const VertexQuantization& quantization,
+                            Vertex* out)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const QuantizedVertex& vertex = vertices[i];
+            Vertex& result = out[i];
+
+            glm::vec3 position(fromSnorm16(vertex.position[0]), fromSnorm16(vertex.position[1]),
+                               fromSnorm16(vertex.position[2]));
+            glm::vec2 texCoords(fromUnorm16(vertex.texCoords[0]), fromUnorm16(vertex.texCoords[1]));
+
+            result.position = quantization.positionCenter + position * quantization.positionExtent;
+            result.normal = decodeOctahedral(glm::vec2(fromSnorm16(vertex.normal[0]), fromSnorm16(vertex.normal[1])));
+            result.texCoords = quantization.texCoordMin + texCoords * quantization.texCoordExtent;
+        }
+    }
+
+    QuantizationError measureQuantizationError(const Vertex* vertices, size_t count)
+    {
+        VertexQuantization quantization = getVertexQuantization(vertices, count);
+
+        std::vector<QuantizedVertex> quantized(count);
+        std::vector<Vertex> roundTrip(count);
+        quantizeVertices(vertices, count, quantization, quantized.data());
+        dequantizeVertices(quantized.data(), count, quantization, roundTrip.data());
+
+        QuantizationError error;
+        for (size_t i = 0; i < count; ++i)
+        {
+            error.position = std::max(error.position, glm::length(vertices[i].position - roundTrip[i].position));
+            error.texCoords = std::max(error.texCoords, glm::length(vertices[i].texCoords - roundTrip[i].texCoords));
+
+            // Degenerate normals have no direction to lose
+            float length = glm::length(vertices[i].normal);
+            if (length > 0.0f)
+            {
+                float cosine = glm::dot(vertices[i].normal / length, roundTrip[i].normal);
+                float angle = std::acos(std::max(-1.0f, std::min(1.0f, cosine))) * 180.0f / 3.14159265f;
+                error.normal = std::max(error.normal, angle);
+            }
+        }
+
+        return error;
+    }
+}
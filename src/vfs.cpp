@@ -0,0 +1,279 @@
+#include "vfs.h"
+#include "archive.h"
+#include "fileutil.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define W_PREFETCH_MANIFEST_HEADER "wake-prefetch 1"
+
+namespace wake
+{
+    ReadRequest::ReadRequest(const std::string& path)
+            : path(path), key(normalizePath(path))
+    {
+    }
+
+    ReadRequest::~ReadRequest()
+    {
+        W_VFS.release(key);
+    }
+
+    const std::string& ReadRequest::getPath() const
+    {
+        return path;
+    }
+
+    bool ReadRequest::isDone() const
+    {
+        return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    MappedFilePtr ReadRequest::wait() const
+    {
+        return result.get();
+    }
+
+    VirtualFileSystem& VirtualFileSystem::get()
+    {
+        static VirtualFileSystem instance;
+        return instance;
+    }
+
+    VirtualFileSystem::VirtualFileSystem()
+            : requestCount(0), coalescedCount(0), bytesRead(0), recording(false), io(W_VFS_IO_THREADS)
+    {
+    }
+
+    MappedFilePtr VirtualFileSystem::read(const std::string& path)
+    {
+        ++requestCount;
+
+        ReadRequestPtr request;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = requests.find(normalizePath(path));
+            if (found != requests.end())
+                request = found->second.lock();
+        }
+
+        if (request.get() != nullptr)
+        {
+            ++coalescedCount;
+            return request->wait();
+        }
+
+        MappedFilePtr file = openAssetFile(path.c_str());
+        if (file.get() != nullptr && recording)
+            record(normalizePath(path), file->getSize());
+
+        return file;
+    }
+
+    ReadRequestPtr VirtualFileSystem::readAsync(const std::string& path)
+    {
+        ++requestCount;
+
+        ReadRequestPtr request(new ReadRequest(path));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::weak_ptr<ReadRequest>& entry = requests[request->key];
+        ReadRequestPtr existing = entry.lock();
+        if (existing.get() != nullptr)
+        {
+            ++coalescedCount;
+
+            // Not registered, so it mustn't unregister the request it lost to either
+            request->key.clear();
+            return existing;
+        }
+
+        std::string key = request->key;
+        request->result = io.submit([this, path, key]() {
+            MappedFilePtr file = openAssetFile(path.c_str());
+            if (file.get() != nullptr)
+            {
+                if (recording)
+                    record(key, file->getSize());
+
+                file->pageIn();
+                bytesRead += file->getSize();
+            }
+
+            return file;
+        }).share();
+
+        entry = request;
+        return request;
+    }
+
+    std::vector<ReadRequestPtr> VirtualFileSystem::readBatch(const std::vector<std::string>& paths)
+    {
+        std::vector<size_t> order(paths.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&paths](size_t a, size_t b) {
+            return paths[a] < paths[b];
+        });
+
+        std::vector<ReadRequestPtr> result(paths.size());
+        for (size_t index : order)
+        {
+            result[index] = readAsync(paths[index]);
+        }
+
+        return result;
+    }
+
+    void VirtualFileSystem::prefetch(const std::string& path)
+    {
+        io.submit([path]() {
+            MappedFilePtr file = findArchiveFile(path);
+            if (file.get() != nullptr)
+            {
+                file->prefetch();
+                return;
+            }
+
+#ifdef __linux__
+            // Starts readahead into the page cache without mapping the file
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd >= 0)
+            {
+                posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+                close(fd);
+            }
+#else
+            // Without a readahead hint for unmapped files, read it on this thread instead
+            file = MappedFile::open(path.c_str());
+            if (file.get() != nullptr)
+                file->pageIn();
+#endif
+        });
+    }
+
+    uint64 VirtualFileSystem::getRequestCount() const
+    {
+        return requestCount;
+    }
+
+    uint64 VirtualFileSystem::getCoalescedCount() const
+    {
+        return coalescedCount;
+    }
+
+    uint64 VirtualFileSystem::getBytesRead() const
+    {
+        return bytesRead;
+    }
+
+    void VirtualFileSystem::resetStats()
+    {
+        requestCount = 0;
+        coalescedCount = 0;
+        bytesRead = 0;
+    }
+
+    void VirtualFileSystem::startRecording()
+    {
+        std::lock_guard<std::mutex> lock(recordMutex);
+        recorded.clear();
+        recordedPaths.clear();
+        recordingStart = std::chrono::steady_clock::now();
+        recording = true;
+    }
+
+    bool VirtualFileSystem::stopRecording(const std::string& manifestPath)
+    {
+        std::vector<RecordedRead> reads;
+        {
+            std::lock_guard<std::mutex> lock(recordMutex);
+            recording = false;
+            reads.swap(recorded);
+            recordedPaths.clear();
+        }
+
+        // Asynchronous reads are recorded when they finish, which isn't always the order they were asked for in
+        std::stable_sort(reads.begin(), reads.end(), [](const RecordedRead& a, const RecordedRead& b) {
+            return a.seconds < b.seconds;
+        });
+
+        std::ofstream manifest(manifestPath.c_str(), std::ios::out | std::ios::trunc);
+        if (!manifest.is_open())
+        {
+            std::cout << "VirtualFileSystem error: unable to open \"" << manifestPath << "\" for writing" << std::endl;
+            return false;
+        }
+
+        manifest << W_PREFETCH_MANIFEST_HEADER << "\n";
+        for (auto& read : reads)
+        {
+            manifest << std::fixed << std::setprecision(6) << read.seconds << ' ' << read.size << ' ' << read.path <<
+            "\n";
+        }
+
+        return manifest.good();
+    }
+
+    bool VirtualFileSystem::isRecording() const
+    {
+        return recording;
+    }
+
+    size_t VirtualFileSystem::replay(const std::string& manifestPath)
+    {
+        std::ifstream manifest(manifestPath.c_str());
+        std::string line;
+        if (!manifest.is_open() || !std::getline(manifest, line) || line != W_PREFETCH_MANIFEST_HEADER)
+        {
+            std::cout << "VirtualFileSystem error: \"" << manifestPath << "\" isn't a prefetch manifest" << std::endl;
+            return 0;
+        }
+
+        size_t count = 0;
+        while (std::getline(manifest, line))
+        {
+            std::istringstream fields(line);
+            double seconds;
+            uint64 size;
+            std::string path;
+            if (!(fields >> seconds >> size) || !std::getline(fields >> std::ws, path) || path.empty())
+                continue;
+
+            prefetch(path);
+            ++count;
+        }
+
+        return count;
+    }
+
+    void VirtualFileSystem::record(const std::string& key, uint64 size)
+    {
+        std::lock_guard<std::mutex> lock(recordMutex);
+        if (!recording || !recordedPaths.insert(key).second)
+            return;
+
+        typedef std::chrono::duration<double> Seconds;
+        double seconds = std::chrono::duration_cast<Seconds>(std::chrono::steady_clock::now() - recordingStart).count();
+        recorded.push_back({key, seconds, size});
+    }
+
+    void VirtualFileSystem::release(const std::string& key)
+    {
+        if (key.empty())
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = requests.find(key);
+        if (found != requests.end() && found->second.expired())
+            requests.erase(found);
+    }
+}
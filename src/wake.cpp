@@ -6,6 +6,7 @@ namespace wake
 
     static EngineMode engineMode = EngineMode::Invalid;
     static std::vector<std::string> arguments;
+    static thread_local bool deferUploads = false;
 
     void setEngineMode(EngineMode mode)
     {
@@ -17,6 +18,16 @@ namespace wake
         return engineMode;
     }
 
+    void setDeferUploads(bool defer)
+    {
+        deferUploads = defer;
+    }
+
+    bool getDeferUploads()
+    {
+        return deferUploads;
+    }
+
     void setEngineArguments(const std::vector<std::string>& args)
     {
         arguments = args;
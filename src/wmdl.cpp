@@ -1,9 +1,23 @@
 #include "wmdl.h"
-
+#include "fileutil.h"
+#include "mappedfile.h"
+#include "binaryio.h"
+#include "threadpool.h"
+#include "byteshuffle.h"
+#include "vertexquantization.h"
+#include "indexcodec.h"
+#include "mipchain.h"
+#include "texturecache.h"
+#include "vfs.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <fstream>
-#include <sstream>
 #include <iostream>
+#include <mutex>
 
 #include <snappy.h>
 
@@ -13,448 +27,1406 @@
 
 namespace wake
 {
-    static uint8 readUInt8(std::istream& in)
+    namespace
     {
-        uint8 val;
-        in.read((char*) &val, sizeof(val));
+        // Reader over a chunked payload that is being decompressed on the thread pool. Reads that run ahead of
+        // decompression block until the chunks they touch are ready, so parsing overlaps with decompression.
+        class ChunkedReader : public BinaryReader
+        {
+        public:
+            ChunkedReader(const char* data, size_t size, size_t chunkSize)
+                    : BinaryReader(data, size), chunkSize(chunkSize)
+            {
+            }
+
+            virtual ~ChunkedReader()
+            {
+                // Chunks still in flight write into our buffer, don't let it go away underneath them.
+                for (size_t i = readyChunks; i < chunks.size(); ++i)
+                {
+                    tasks.wait(chunks[i]);
+                }
+            }
+
+            // Queues the task that decompresses the next chunk, it returns whether that worked.
+            template<typename F>
+            void addChunk(F decompress)
+            {
+                chunks.push_back(tasks.submit(decompress));
+            }
+
+        protected:
+            virtual void require(size_t begin, size_t end) override
+            {
+                while (readyChunks < chunks.size() && readyChunks * chunkSize < end)
+                {
+                    if (!tasks.wait(chunks[readyChunks++]))
+                    {
+                        std::cout << "loadWMDL error: unable to decompress chunk " << (readyChunks - 1) << std::endl;
+                        throw std::exception();
+                    }
+                }
+            }
 
-        if (in.eof())
+        private:
+            size_t chunkSize;
+            TaskGroup tasks;
+            std::vector<std::future<bool>> chunks;
+            size_t readyChunks = 0;
+        };
+
+        // Location of every compressed chunk of a version 8+ payload.
+        struct ChunkIndex
         {
-            std::cout << "readUInt8 error: hit EOF while reading from stream" << std::endl;
-            throw std::exception();
-        }
+            size_t chunkSize;
+            uint64 uncompressedSize;
+            std::vector<const char*> chunks;
+            std::vector<uint32> compressedSizes;
+        };
+
+        // Payload that stays around after loadWMDL returns so the meshes of a lazily loaded model can be read from it
+        // later. Chunked payloads are only decompressed a chunk at a time as they are needed, anything else is either
+        // the mapped file itself or was decompressed up front.
+        class LazyPayload
+        {
+        public:
+            LazyPayload(MappedFilePtr file, const char* data, size_t size)
+                    : file(file), data(data), size(size)
+            {
+            }
 
-        if (in.bad())
+            LazyPayload(MappedFilePtr file, const ChunkIndex& index)
+                    : file(file), buffer(new char[index.uncompressedSize]), data(buffer.get()),
+                      size((size_t) index.uncompressedSize), index(index), readyChunks(index.chunks.size(), false)
+            {
+            }
+
+            LazyPayload(std::unique_ptr<char[]>& buffer, size_t size)
+                    : buffer(std::move(buffer)), data(this->buffer.get()), size(size)
+            {
+            }
+
+            const char* getData() const
+            {
+                return data;
+            }
+
+            size_t getSize() const
+            {
+                return size;
+            }
+
+            // Makes sure the bytes in [begin, end) are decompressed. Mesh loaders may run on any thread.
+            void require(size_t begin, size_t end)
+            {
+                if (readyChunks.empty() || begin >= end)
+                    return;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t i = begin / index.chunkSize; i <= (end - 1) / index.chunkSize; ++i)
+                {
+                    if (readyChunks[i])
+                        continue;
+
+                    size_t expectedSize = (size_t) std::min((uint64) index.chunkSize,
+                                                            index.uncompressedSize - i * index.chunkSize);
+                    size_t length;
+                    if (!snappy::GetUncompressedLength(index.chunks[i], index.compressedSizes[i], &length) ||
+                        length != expectedSize ||
+                        !snappy::RawUncompress(index.chunks[i], index.compressedSizes[i],
+                                               buffer.get() + i * index.chunkSize))
+                    {
+                        std::cout << "loadWMDL error: unable to decompress chunk " << i << std::endl;
+                        throw std::exception();
+                    }
+
+                    readyChunks[i] = true;
+                }
+            }
+
+        private:
+            MappedFilePtr file;
+            std::unique_ptr<char[]> buffer;
+            const char* data;
+            size_t size;
+
+            ChunkIndex index;
+            std::vector<bool> readyChunks;
+            std::mutex mutex;
+        };
+
+        class LazyPayloadReader : public BinaryReader
         {
-            std::cout << "readUInt8 error: unable to read from stream" << std::endl;
-            throw std::exception();
-        }
+        public:
+            LazyPayloadReader(std::shared_ptr<LazyPayload> payload)
+                    : BinaryReader(payload->getData(), payload->getSize()), payload(payload)
+            {
+            }
 
-        return val;
-    }
+        protected:
+            virtual void require(size_t begin, size_t end) override
+            {
+                payload->require(begin, end);
+            }
 
-    static void writeUInt8(std::ostream& out, uint8 val)
-    {
-        out.write((char*) &val, sizeof(val));
+        private:
+            std::shared_ptr<LazyPayload> payload;
+        };
 
-        if (out.bad())
+        // Streams an uncompressed payload straight to the output file.
+        class StreamWriter : public BinaryWriter
         {
-            std::cout << "writeUInt8 error: unable to write to stream" << std::endl;
-            throw std::exception();
-        }
+        public:
+            StreamWriter(std::ostream& out)
+                    : BinaryWriter(W_MDL_CHUNK_SIZE), out(out)
+            {
+            }
+
+            void finish()
+            {
+                flushRemaining();
+            }
+
+        protected:
+            virtual void flush(const char* data, size_t size) override
+            {
+                out.write(data, size);
+            }
+
+        private:
+            std::ostream& out;
+        };
+
+        // Compresses a payload one chunk at a time on the thread pool, writing the chunks to the output file in order
+        // as they complete. Only a few chunks are in flight at any time, so memory use doesn't depend on model size.
+        class ChunkedWriter : public BinaryWriter
+        {
+        public:
+            ChunkedWriter(std::ostream& out)
+                    : BinaryWriter(W_MDL_CHUNK_SIZE), out(out), maxPending(W_THREAD_POOL.getThreadCount() + 1)
+            {
+            }
+
+            virtual ~ChunkedWriter()
+            {
+                for (auto& chunk : pending)
+                {
+                    tasks.wait(chunk);
+                }
+            }
+
+            // Flushes the last chunk and returns the compressed size of every chunk.
+            const std::vector<uint32>& finish()
+            {
+                flushRemaining();
+                while (!pending.empty())
+                {
+                    writeNext();
+                }
+
+                return compressedSizes;
+            }
+
+        protected:
+            virtual void flush(const char* data, size_t size) override
+            {
+                // An empty payload is still stored as a single (empty) chunk, but otherwise there is nothing to do
+                if (size == 0 && compressedSizes.size() + pending.size() > 0)
+                    return;
+
+                std::shared_ptr<std::string> chunk(new std::string(data, size));
+                pending.push_back(tasks.submit([chunk]() {
+                    std::string result;
+                    snappy::Compress(chunk->data(), chunk->size(), &result);
+                    return result;
+                }));
+
+                while (pending.size() > maxPending)
+                {
+                    writeNext();
+                }
+            }
+
+        private:
+            void writeNext()
+            {
+                std::string compressed = tasks.wait(pending.front());
+                pending.pop_front();
+
+                out.write(compressed.data(), compressed.size());
+                compressedSizes.push_back((uint32) compressed.size());
+            }
+
+            std::ostream& out;
+            size_t maxPending;
+            TaskGroup tasks;
+            std::deque<std::future<std::string>> pending;
+            std::vector<uint32> compressedSizes;
+        };
     }
 
-    static uint32 readUInt32(std::istream& in)
+    static ChunkIndex readChunkIndex(BinaryReader& f)
     {
-        uint32 val;
-        in.read((char*) &val, sizeof(val));
+        ChunkIndex index;
+        index.chunkSize = f.readUInt32();
+        size_t chunkCount = f.readUInt32();
+        index.uncompressedSize = f.readUInt64();
 
-        if (in.eof())
+        if (index.chunkSize == 0 ||
+            chunkCount != std::max((uint64) 1, (index.uncompressedSize + index.chunkSize - 1) / index.chunkSize))
         {
-            std::cout << "readUInt32 error: hit EOF while reading from stream" << std::endl;
+            std::cout << "loadWMDL error: chunk index is corrupt" << std::endl;
             throw std::exception();
         }
 
-        if (in.bad())
+        index.compressedSizes.resize(chunkCount);
+        f.readArray(index.compressedSizes.data(), chunkCount);
+
+        index.chunks.resize(chunkCount);
+        for (size_t i = 0; i < chunkCount; ++i)
         {
-            std::cout << "readUInt32 error: unable to read from stream" << std::endl;
-            throw std::exception();
+            index.chunks[i] = f.readBytes(index.compressedSizes[i]);
         }
 
-        return val;
+        return index;
     }
 
-    static void writeUInt32(std::ostream& out, uint32 val)
+    static std::unique_ptr<BinaryReader> readChunkedPayload(BinaryReader& f, MappedFilePtr file,
+                                                            std::unique_ptr<char[]>& buffer)
     {
-        out.write((char*) &val, sizeof(val));
+        ChunkIndex index = readChunkIndex(f);
+        size_t chunkSize = index.chunkSize;
+        uint64 uncompressedSize = index.uncompressedSize;
+
+        buffer.reset(new char[uncompressedSize]);
 
-        if (out.bad())
+        std::unique_ptr<ChunkedReader> reader(new ChunkedReader(buffer.get(), (size_t) uncompressedSize, chunkSize));
+        for (size_t i = 0; i < index.chunks.size(); ++i)
         {
-            std::cout << "writeUInt32 error: unable to write to stream" << std::endl;
-            throw std::exception();
+            const char* compressed = index.chunks[i];
+            size_t compressedSize = index.compressedSizes[i];
+            size_t expectedSize = (size_t) std::min((uint64) chunkSize, uncompressedSize - i * chunkSize);
+            char* out = buffer.get() + i * chunkSize;
+
+            // The task holds on to the file so the compressed data stays mapped until it is done
+            reader->addChunk([file, compressed, compressedSize, expectedSize, out]() {
+                size_t length;
+                if (!snappy::GetUncompressedLength(compressed, compressedSize, &length) || length != expectedSize)
+                    return false;
+
+                return snappy::RawUncompress(compressed, compressedSize, out);
+            });
         }
+
+        return std::unique_ptr<BinaryReader>(reader.release());
     }
 
-    static int32 readInt32(std::istream& in)
+    static size_t getAligned(size_t position)
     {
-        int32 val;
-        in.read((char*) &val, sizeof(val));
+        return (position + W_MDL_ALIGNMENT - 1) / W_MDL_ALIGNMENT * W_MDL_ALIGNMENT;
+    }
 
-        if (in.eof())
-        {
-            std::cout << "readInt32 error: hit EOF while reading from stream" << std::endl;
-            throw std::exception();
-        }
+    // Every distinct texture used by the model's materials that has pixel data to embed
+    static std::vector<TexturePtr> getEmbeddedTextures(ModelPtr model, const WMDLSaveOptions& options)
+    {
+        std::vector<TexturePtr> textures;
+        if (!options.embedTextures)
+            return textures;
 
-        if (in.bad())
+        for (auto& matInfo : model->getMaterials())
         {
-            std::cout << "readInt32 error: unable to read from stream" << std::endl;
-            throw std::exception();
+            for (auto& texEntry : matInfo.material->getTextures())
+            {
+                TexturePtr texture = texEntry.second.texture;
+                if (texture.get() == nullptr || texture->getData() == nullptr)
+                    continue;
+
+                if (std::find(textures.begin(), textures.end(), texture) == textures.end())
+                    textures.push_back(texture);
+            }
         }
 
-        return val;
+        return textures;
     }
 
-    static void writeInt32(std::ostream& out, int32 val)
+    static int getFullLevelCount(TexturePtr texture)
     {
-        out.write((char*) &val, sizeof(val));
+        return getMipLevelCount(texture->getWidth(), texture->getHeight());
+    }
 
-        if (out.bad())
+    // Size of the texture section, which always starts the payload
+    static size_t getTextureSectionSize(const std::vector<TexturePtr>& textures)
+    {
+        size_t size = sizeof(uint32);
+        for (auto& texture : textures)
         {
-            std::cout << "writeInt32 error: unable to write to stream" << std::endl;
-            throw std::exception();
+            // Path, width, height, components, format, level count and reserved, then the aligned mip chain
+            size += sizeof(uint32) + texture->getPath().size() + sizeof(uint32) * 2 + 4;
+            size = getAligned(size) +
+                   getMipChainSize(texture->getWidth(), texture->getHeight(), getFullLevelCount(texture));
         }
+
+        return size;
     }
 
-    static uint64 readUInt64(std::istream& in)
+    static void writeTextureSection(BinaryWriter& data, const std::vector<TexturePtr>& textures)
     {
-        uint64 val;
-        in.read((char*) &val, sizeof(val));
-
-        if (in.eof())
+        data.writeUInt32((uint32) textures.size());
+        for (auto& texture : textures)
         {
-            std::cout << "readUInt64 error: hit EOF while reading from stream" << std::endl;
-            throw std::exception();
-        }
+            int width = texture->getWidth();
+            int height = texture->getHeight();
+            int levelCount = getFullLevelCount(texture);
+
+            data.writeString(texture->getPath());
+            data.writeUInt32((uint32) width);
+            data.writeUInt32((uint32) height);
+            data.writeUInt8((uint8) texture->getComponentsPerPixel());
+            data.writeUInt8(W_MDL_TEXTURE_RGBA8);
+            data.writeUInt8((uint8) levelCount);
+            data.writeUInt8(0);
+            data.writePadding(W_MDL_ALIGNMENT);
+
+            // Textures that were loaded from a WMDL file already have their chain, anything else only has level 0
+            size_t chainSize = getMipChainSize(width, height, levelCount);
+            if (texture->getLevelCount() == levelCount)
+            {
+                data.writeBytes(texture->getData(), chainSize);
+                continue;
+            }
 
-        if (in.bad())
-        {
-            std::cout << "readUInt64 error: unable to read from stream" << std::endl;
-            throw std::exception();
+            std::vector<uint8> chain(chainSize);
+            memcpy(chain.data(), texture->getData(), getMipChainSize(width, height, 1));
+            generateMipChain(chain.data(), width, height, levelCount);
+            data.writeBytes(chain.data(), chainSize);
         }
-
-        return val;
     }
 
-    static void writeUInt64(std::ostream& out, uint64 val)
+    static void writeMaterialSection(BinaryWriter& data, ModelPtr model, const std::vector<TexturePtr>& embedded)
     {
-        out.write((char*) &val, sizeof(val));
-
-        if (out.bad())
+        data.writeUInt32((uint32) model->getMaterialCount());
+        for (auto& matInfo : model->getMaterials())
         {
-            std::cout << "writeUInt64 error: unable to write to stream" << std::endl;
-            throw std::exception();
+            data.writeString(matInfo.name);
+            data.writeString(matInfo.material->getTypeName());
+
+            // Textures
+            auto& textures = matInfo.material->getTextures();
+            data.writeUInt32((uint32) textures.size());
+            for (auto& texEntry : textures)
+            {
+                data.writeString(texEntry.first);
+                if (texEntry.second.texture.get() == nullptr)
+                    data.writeString("");
+                else
+                    data.writeString(texEntry.second.texture->getPath());
+
+                // Index into the texture section, or -1 if the texture isn't embedded
+                auto it = std::find(embedded.begin(), embedded.end(), texEntry.second.texture);
+                data.writeInt32(it == embedded.end() ? -1 : (int32) (it - embedded.begin()));
+            }
+
+            // Parameters
+            auto& params = matInfo.material->getParameters();
+            data.writeUInt32((uint32) params.getCount());
+            for (size_t p = 0; p < params.getCount(); ++p)
+            {
+                std::string paramName = params.getName(p);
+                MaterialParameter param = params.get(p);
+                data.writeString(paramName);
+                data.writeUInt8((uint8) param.type);
+                switch (param.type)
+                {
+                    default:
+                        std::cout << "Unable to write material " << matInfo.name << ": unknown parameter type " <<
+                        param.type << " for parameter " << paramName << std::endl;
+                        throw std::exception();
+
+                    case MaterialParameter::Null:
+                        break;
+
+                    case MaterialParameter::Int:
+                        data.writeInt32(param.i);
+                        break;
+
+                    case MaterialParameter::UInt:
+                        data.writeUInt32(param.u);
+                        break;
+
+                    case MaterialParameter::Float:
+                        data.writeFloat(param.f);
+                        break;
+
+                    case MaterialParameter::Vec2:
+                        data.writeVec2(param.v2);
+                        break;
+
+                    case MaterialParameter::Vec3:
+                        data.writeVec3(param.v3);
+                        break;
+
+                    case MaterialParameter::Vec4:
+                        data.writeVec4(param.v4);
+                        break;
+
+                    case MaterialParameter::Mat4:
+                        data.writeMatrix4(param.m4);
+                        break;
+                }
+            }
         }
     }
 
-    static float readFloat(std::istream& in)
+    // Size of the vertex quantization ranges stored in front of quantized vertices
+    static const size_t quantizationSize = sizeof(float) * 10;
+
+    // Number of elements in each independently shuffled block of an array
+    static size_t getShuffleBlockCount(size_t elementSize)
+    {
+        return std::max((size_t) 1, W_MDL_SHUFFLE_BLOCK_SIZE / elementSize);
+    }
+
+    struct IndexLayout
     {
-        float val;
-        in.read((char*) &val, sizeof(val));
+        uint8 encoding;
+        size_t size;
+    };
 
-        if (in.eof())
+    // Where each mesh ends up in the payload, worked out before anything is written so the table can come first
+    struct MeshLayout
+    {
+        IndexLayout indices;
+        std::vector<IndexLayout> lods;
+        size_t offset;
+        size_t size;
+    };
+
+    // Picks the smallest of the index encodings that can represent the indices
+    static IndexLayout chooseIndexEncoding(const std::vector<GLuint>& indices, bool compact)
+    {
+        IndexLayout layout;
+        layout.encoding = W_MDL_INDEX_UINT32;
+        layout.size = indices.size() * sizeof(uint32);
+        if (!compact)
+            return layout;
+
+        if (getMaxIndex(indices.data(), indices.size()) <= 0xFFFF)
         {
-            std::cout << "readFloat error: hit EOF while reading from stream" << std::endl;
-            throw std::exception();
+            layout.encoding = W_MDL_INDEX_UINT16;
+            layout.size = indices.size() * sizeof(uint16);
         }
 
-        if (in.bad())
+        size_t deltaSize = sizeof(uint32) + getIndexDeltaSize(indices.data(), indices.size());
+        if (deltaSize < layout.size)
         {
-            std::cout << "readFloat error: unable to read from stream" << std::endl;
-            throw std::exception();
+            layout.encoding = W_MDL_INDEX_DELTA;
+            layout.size = deltaSize;
         }
 
-        return val;
+        return layout;
     }
 
-    static void writeFloat(std::ostream& out, float val)
+    static std::vector<MeshLayout> getMeshLayout(ModelPtr model, const WMDLSaveOptions& options, size_t sectionOffset,
+                                                 size_t& sectionEnd)
     {
-        out.write((char*) &val, sizeof(val));
+        auto& meshes = model->getMeshes();
 
-        if (out.bad())
+        // Table of contents, each entry is 72 bytes: material index, vertex and index counts, vertex encoding and
+        // format, index encoding, reserved, offset and size, then the bounds (minimum, maximum, center and radius)
+        size_t tableSize = sizeof(uint32) + meshes.size() * 72;
+        size_t offset = getAligned(sectionOffset + tableSize);
+
+        std::vector<MeshLayout> layout(meshes.size());
+        sectionEnd = sectionOffset + tableSize;
+        for (size_t m = 0; m < meshes.size(); ++m)
         {
-            std::cout << "writeFloat error: unable to write to stream" << std::endl;
-            throw std::exception();
+            auto& mesh = meshes[m].mesh;
+            layout[m].indices = chooseIndexEncoding(mesh->getIndices(), options.compactIndices);
+
+            size_t vertexSize = getAligned(mesh->getVertexCount() * sizeof(Vertex));
+            if (options.quantize)
+                vertexSize = getAligned(quantizationSize) +
+                             getAligned(mesh->getVertexCount() * sizeof(QuantizedVertex));
+
+            layout[m].offset = offset;
+            layout[m].size = getAligned(sizeof(uint32) * 2) + vertexSize + layout[m].indices.size;
+
+            // Levels of detail follow the indices: their count, a 12 byte header for each (error, index count, index
+            // encoding and reserved) and then their indices
+            layout[m].size = getAligned(layout[m].size) + sizeof(uint32) + (mesh->getLodCount() - 1) * 12;
+            for (size_t level = 1; level < mesh->getLodCount(); ++level)
+            {
+                layout[m].lods.push_back(chooseIndexEncoding(mesh->getLodIndices(level), options.compactIndices));
+                layout[m].size = getAligned(layout[m].size) + layout[m].lods.back().size;
+            }
+
+            // Then the meshlets, 40 bytes each: index offset and count, center, radius, cone axis and cutoff
+            layout[m].size = getAligned(layout[m].size) + sizeof(uint32) + mesh->getMeshlets().size() * 40;
+
+            sectionEnd = offset + layout[m].size;
+            offset = getAligned(sectionEnd);
         }
+
+        return layout;
     }
 
-    static std::string readString(std::istream& in)
+    // Writes an array of vertices, shuffling it one block at a time if requested.
+    static void writeVertexBlock(BinaryWriter& data, const void* vertices, size_t count, size_t elementSize,
+                                 uint64 flags)
     {
-        uint32 len = readUInt32(in);
-        char* data = new char[len + 1];
-        data[len] = '\0';
-        in.read(data, len);
-        std::string result = data;
-        delete[] data;
-        return result;
+        if (flags & W_MDL_FLAG_SHUFFLE)
+            shuffleBytes(vertices, data.allocateBytes(count * elementSize), count, elementSize);
+        else
+            data.writeBytes(vertices, count * elementSize);
     }
 
-    static void writeString(std::ostream& out, const std::string& val)
+    static void writeVertices(BinaryWriter& data, const std::vector<Vertex>& vertices, uint64 flags,
+                              const WMDLSaveOptions& options)
     {
-        writeUInt32(out, (uint32) val.size());
-        const char* data = val.data();
-        out.write(data, val.size());
+        if (!options.quantize)
+        {
+            data.writePadding(W_MDL_ALIGNMENT);
+
+            size_t blockCount = getShuffleBlockCount(sizeof(Vertex));
+            for (size_t i = 0; i < vertices.size(); i += blockCount)
+            {
+                size_t count = std::min(blockCount, vertices.size() - i);
+                writeVertexBlock(data, vertices.data() + i, count, sizeof(Vertex), flags);
+            }
+
+            return;
+        }
+
+        VertexQuantization quantization = getVertexQuantization(vertices.data(), vertices.size());
+        data.writePadding(W_MDL_ALIGNMENT);
+        data.writeVec3(quantization.positionCenter);
+        data.writeVec3(quantization.positionExtent);
+        data.writeVec2(quantization.texCoordMin);
+        data.writeVec2(quantization.texCoordExtent);
+
+        data.writePadding(W_MDL_ALIGNMENT);
 
-        if (out.bad())
+        size_t blockCount = getShuffleBlockCount(sizeof(QuantizedVertex));
+        std::vector<QuantizedVertex> quantized(std::min(blockCount, vertices.size()));
+        for (size_t i = 0; i < vertices.size(); i += blockCount)
         {
-            std::cout << "writeString error: unable to write to stream" << std::endl;
-            throw std::exception();
+            size_t count = std::min(blockCount, vertices.size() - i);
+            quantizeVertices(vertices.data() + i, count, quantization, quantized.data());
+            writeVertexBlock(data, quantized.data(), count, sizeof(QuantizedVertex), flags);
         }
     }
 
-    static glm::vec2 readVec2(std::istream& in)
+    static void writeIndices(BinaryWriter& data, const std::vector<GLuint>& indices, const IndexLayout& layout)
     {
-        glm::vec2 val;
-        val.x = readFloat(in);
-        val.y = readFloat(in);
-        return val;
+        // Encoded a block at a time, so there is never a second copy of all of the indices
+        size_t blockCount = W_MDL_SHUFFLE_BLOCK_SIZE / sizeof(uint32);
+
+        data.writePadding(W_MDL_ALIGNMENT);
+        switch (layout.encoding)
+        {
+            default:
+            case W_MDL_INDEX_UINT32:
+                data.writeArray(indices.data(), indices.size());
+                break;
+
+            case W_MDL_INDEX_UINT16:
+                for (size_t i = 0; i < indices.size(); i += blockCount)
+                {
+                    size_t count = std::min(blockCount, indices.size() - i);
+                    narrowIndices(indices.data() + i, count, (uint16*) data.allocateBytes(count * sizeof(uint16)));
+                }
+                break;
+
+            case W_MDL_INDEX_DELTA:
+            {
+                data.writeUInt32((uint32) (layout.size - sizeof(uint32)));
+
+                std::string encoded;
+                for (size_t i = 0; i < indices.size(); i += blockCount)
+                {
+                    size_t count = std::min(blockCount, indices.size() - i);
+                    encoded.clear();
+                    encodeIndexDeltas(indices.data() + i, count, encoded, i > 0 ? indices[i - 1] : 0);
+                    data.writeBytes(encoded.data(), encoded.size());
+                }
+                break;
+            }
+        }
     }
 
-    static void writeVec2(std::ostream& out, const glm::vec2& val)
+    static void writeMeshSection(BinaryWriter& data, ModelPtr model, const std::vector<MeshLayout>& layout,
+                                 uint64 flags, const WMDLSaveOptions& options)
     {
-        writeFloat(out, val.x);
-        writeFloat(out, val.y);
+        auto& meshes = model->getMeshes();
+        uint8 vertexEncoding = options.quantize ? W_MDL_VERTEX_QUANTIZED : W_MDL_VERTEX_FLOAT;
+
+        data.writeUInt32((uint32) meshes.size());
+        for (size_t m = 0; m < meshes.size(); ++m)
+        {
+            auto& meshInfo = meshes[m];
+            auto& mesh = meshInfo.mesh;
+
+            data.writeInt32(meshInfo.materialIndex);
+            data.writeUInt32((uint32) mesh->getVertexCount());
+            data.writeUInt32((uint32) mesh->getIndexCount());
+            data.writeUInt8(vertexEncoding);
+            data.writeUInt8((uint8) mesh->getVertexFormat());
+            data.writeUInt8(layout[m].indices.encoding);
+            data.writeUInt8(0); // reserved
+            data.writeUInt64((uint64) layout[m].offset);
+            data.writeUInt64((uint64) layout[m].size);
+
+            const Bounds& bounds = mesh->getBounds();
+            data.writeVec3(bounds.minimum);
+            data.writeVec3(bounds.maximum);
+            data.writeVec3(bounds.center);
+            data.writeFloat(bounds.radius);
+        }
+
+        for (size_t m = 0; m < meshes.size(); ++m)
+        {
+            data.writePadding(W_MDL_ALIGNMENT);
+
+            auto& mesh = meshes[m].mesh;
+            auto& vertices = mesh->getVertices();
+            auto& indices = mesh->getIndices();
+            data.writeUInt32((uint32) vertices.size());
+            data.writeUInt32((uint32) indices.size());
+
+            writeVertices(data, vertices, flags, options);
+            writeIndices(data, indices, layout[m].indices);
+
+            data.writePadding(W_MDL_ALIGNMENT);
+            data.writeUInt32((uint32) layout[m].lods.size());
+            for (size_t level = 1; level <= layout[m].lods.size(); ++level)
+            {
+                data.writeFloat(mesh->getLodError(level));
+                data.writeUInt32((uint32) mesh->getLodIndices(level).size());
+                data.writeUInt8(layout[m].lods[level - 1].encoding);
+                data.writeUInt8(0); // reserved
+                data.writeUInt8(0);
+                data.writeUInt8(0);
+            }
+
+            for (size_t level = 1; level <= layout[m].lods.size(); ++level)
+            {
+                writeIndices(data, mesh->getLodIndices(level), layout[m].lods[level - 1]);
+            }
+
+            data.writePadding(W_MDL_ALIGNMENT);
+            data.writeUInt32((uint32) mesh->getMeshlets().size());
+            for (auto& meshlet : mesh->getMeshlets())
+            {
+                data.writeUInt32(meshlet.indexOffset);
+                data.writeUInt32(meshlet.indexCount);
+                data.writeVec3(meshlet.center);
+                data.writeFloat(meshlet.radius);
+                data.writeVec3(meshlet.coneAxis);
+                data.writeFloat(meshlet.coneCutoff);
+            }
+        }
     }
 
-    static glm::vec3 readVec3(std::istream& in)
+    static std::vector<TexturePtr> readTextureSection(BinaryReader& data)
     {
-        glm::vec3 val;
-        val.x = readFloat(in);
-        val.y = readFloat(in);
-        val.z = readFloat(in);
-        return val;
+        std::vector<TexturePtr> textures;
+
+        uint32 textureCount = data.readUInt32();
+        for (uint32 t = 0; t < textureCount; ++t)
+        {
+            std::string path = data.readString();
+            int width = (int) data.readUInt32();
+            int height = (int) data.readUInt32();
+            int comp = data.readUInt8();
+            uint8 format = data.readUInt8();
+            int levelCount = data.readUInt8();
+            data.readUInt8();
+            data.readPadding(W_MDL_ALIGNMENT);
+
+            if (format != W_MDL_TEXTURE_RGBA8)
+            {
+                std::cout << "loadWMDL error: unknown format " << (int) format << " for texture " << path << std::endl;
+                throw std::exception();
+            }
+
+            if (width <= 0 || height <= 0 || levelCount < 1 || levelCount > getMipLevelCount(width, height))
+            {
+                std::cout << "loadWMDL error: invalid size for texture " << path << std::endl;
+                throw std::exception();
+            }
+
+            size_t chainSize = getMipChainSize(width, height, levelCount);
+            const char* chain = data.readBytes(chainSize);
+
+            // Share the texture with other models that embed it (or load it from its path) while it's still around
+            TexturePtr cached = W_TEXTURE_CACHE.find(path);
+            if (cached.get() != nullptr && cached->getWidth() == width && cached->getHeight() == height &&
+                cached->getLevelCount() == levelCount)
+            {
+                textures.push_back(cached);
+                continue;
+            }
+
+            // wake::Texture owns (and frees) its data
+            unsigned char* pixels = (unsigned char*) malloc(chainSize);
+            memcpy(pixels, chain, chainSize);
+
+            TexturePtr texture(new Texture(pixels, width, height, comp, levelCount, path));
+            W_TEXTURE_CACHE.insert(texture);
+            textures.push_back(texture);
+        }
+
+        return textures;
     }
 
-    static void writeVec3(std::ostream& out, const glm::vec3& val)
+    static void readMaterialSection(BinaryReader& data, ModelPtr model, uint32 version,
+                                    const std::vector<TexturePtr>& embedded)
     {
-        writeFloat(out, val.x);
-        writeFloat(out, val.y);
-        writeFloat(out, val.z);
+        // External textures are loaded once every material has been read, so their files can be read together
+        struct ExternalTexture
+        {
+            MaterialPtr material;
+            std::string name;
+            std::string path;
+        };
+
+        std::vector<ExternalTexture> external;
+
+        uint32 materialCount = data.readUInt32();
+        for (uint32 k = 0; k < materialCount; ++k)
+        {
+            std::string matName = data.readString();
+            MaterialPtr mat(new Material());
+
+            if (version >= 5)
+            {
+                std::string matType = data.readString();
+                mat->setTypeName(matType);
+            }
+
+            uint32 textureCount = data.readUInt32();
+            for (uint32 t = 0; t < textureCount; ++t)
+            {
+                TexturePtr texture(nullptr);
+                std::string textureName = data.readString();
+
+                if (version >= 6)
+                {
+                    std::string texturePath = data.readString();
+
+                    int32 embeddedIndex = -1;
+                    if (version >= 15)
+                    {
+                        embeddedIndex = data.readInt32();
+                        if (embeddedIndex >= (int32) embedded.size())
+                        {
+                            std::cout << "Unable to read material " << matName << ": embedded texture " <<
+                            embeddedIndex << " doesn't exist" << std::endl;
+                            throw std::exception();
+                        }
+                    }
+
+                    if (embeddedIndex >= 0)
+                        texture = embedded[embeddedIndex];
+                    else if (texturePath != "")
+                        external.push_back({mat, textureName, texturePath});
+                }
+
+                mat->setTexture(textureName, texture);
+            }
+
+            uint32 paramCount = data.readUInt32();
+            for (uint32 p = 0; p < paramCount; ++p)
+            {
+                std::string paramName = data.readString();
+                uint8 type = data.readUInt8();
+                switch (type)
+                {
+                    default:
+                        std::cout << "Unable to read material " << matName << ": unknown parameter type " <<
+                        type << " for parameter " << paramName << std::endl;
+                        throw std::exception();
+
+                    case MaterialParameter::Null:
+                        break;
+
+                    case MaterialParameter::Int:
+                        mat->setParameter(paramName, (GLint) data.readInt32());
+                        break;
+
+                    case MaterialParameter::UInt:
+                        mat->setParameter(paramName, (GLuint) data.readUInt32());
+                        break;
+
+                    case MaterialParameter::Float:
+                        mat->setParameter(paramName, data.readFloat());
+                        break;
+
+                    case MaterialParameter::Vec2:
+                        mat->setParameter(paramName, data.readVec2());
+                        break;
+
+                    case MaterialParameter::Vec3:
+                        mat->setParameter(paramName, data.readVec3());
+                        break;
+
+                    case MaterialParameter::Vec4:
+                        mat->setParameter(paramName, data.readVec4());
+                        break;
+
+                    case MaterialParameter::Mat4:
+                        mat->setParameter(paramName, data.readMatrix4());
+                        break;
+                }
+            }
+
+            model->addMaterial(matName, mat);
+        }
+
+        // Reading every file up front lets each texture decode while the next ones are still being read (see vfs.h)
+        std::vector<std::string> paths;
+        for (auto& texture : external)
+        {
+            if (W_TEXTURE_CACHE.find(texture.path).get() == nullptr)
+                paths.push_back(texture.path);
+        }
+
+        std::vector<ReadRequestPtr> reads = W_VFS.readBatch(paths);
+        for (auto& texture : external)
+        {
+            texture.material->setTexture(texture.name, Texture::load(texture.path.c_str()));
+        }
     }
 
-    static glm::vec4 readVec4(std::istream& in)
+    struct MeshData
     {
-        glm::vec4 val;
-        val.x = readFloat(in);
-        val.y = readFloat(in);
-        val.z = readFloat(in);
-        val.w = readFloat(in);
-        return val;
-    }
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> indices;
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+    };
 
-    static void writeVec4(std::ostream& out, const glm::vec4& val)
+    struct MeshEntry
     {
-        writeFloat(out, val.x);
-        writeFloat(out, val.y);
-        writeFloat(out, val.z);
-        writeFloat(out, val.w);
+        int32 materialIndex;
+        uint32 vertexCount;
+        uint32 indexCount;
+        uint8 vertexEncoding;
+        uint8 vertexFormat;
+        uint8 indexEncoding;
+        uint64 offset;
+        uint64 size;
+        Bounds bounds;
+    };
+
+    static VertexFormat getVertexFormat(const MeshEntry& entry)
+    {
+        // Formats this build doesn't know about can always fall back to full floats
+        if (entry.vertexFormat > (uint8) VertexFormat::PackedHalf)
+            return VertexFormat::Float;
+
+        return (VertexFormat) entry.vertexFormat;
     }
 
-    static glm::mat4 readMatrix4(std::istream& in)
+    static void readVertices(BinaryReader& data, size_t count, size_t elementSize, uint32 version, uint64 flags,
+                             void* out)
     {
-        glm::mat4 val;
-        val[0] = readVec4(in);
-        val[1] = readVec4(in);
-        val[2] = readVec4(in);
-        val[3] = readVec4(in);
-        return val;
+        data.readPadding(W_MDL_ALIGNMENT);
+        const char* bytes = data.readBytes(count, elementSize);
+        if (!(flags & W_MDL_FLAG_SHUFFLE))
+        {
+            memcpy(out, bytes, count * elementSize);
+            return;
+        }
+
+        // Version 14+ shuffles arrays in blocks, older versions shuffle the whole array at once
+        size_t blockCount = version >= 14 ? getShuffleBlockCount(elementSize) : std::max(count, (size_t) 1);
+        for (size_t i = 0; i < count; i += blockCount)
+        {
+            size_t length = std::min(blockCount, count - i);
+            unshuffleBytes(bytes + i * elementSize, (char*) out + i * elementSize, length, elementSize);
+        }
     }
 
-    static void writeMatrix4(std::ostream& out, const glm::mat4& val)
+    static void readIndices(BinaryReader& data, uint8 encoding, uint32 count, std::vector<GLuint>& indices)
     {
-        writeVec4(out, val[0]);
-        writeVec4(out, val[1]);
-        writeVec4(out, val[2]);
-        writeVec4(out, val[3]);
+        data.readPadding(W_MDL_ALIGNMENT);
+        indices.resize(count);
+        if (encoding == W_MDL_INDEX_UINT16)
+        {
+            widenIndices((const uint16*) data.readBytes(count, sizeof(uint16)), count, indices.data());
+        }
+        else if (encoding == W_MDL_INDEX_DELTA)
+        {
+            uint32 size = data.readUInt32();
+            if (!decodeIndexDeltas(data.readBytes(size), size, indices.data(), count))
+            {
+                std::cout << "loadWMDL error: delta coded indices are corrupt" << std::endl;
+                throw std::exception();
+            }
+        }
+        else if (encoding == W_MDL_INDEX_UINT32)
+        {
+            data.readArray(indices.data(), count);
+        }
+        else
+        {
+            std::cout << "loadWMDL error: unknown index encoding " << (uint32) encoding << std::endl;
+            throw std::exception();
+        }
     }
 
-    bool saveWMDL(const char* path, ModelPtr model, bool compress)
+    // Decodes a single mesh from the data pointed to by the version 9+ table of contents. This only touches memory
+    // owned by the caller, so it is safe to run on the thread pool.
+    static MeshData decodeMesh(const char* blob, const MeshEntry& entry, uint32 version, uint64 flags)
     {
-        std::stringstream data;
+        BinaryReader data(blob, (size_t) entry.size);
+        MeshData mesh;
 
-        try
+        uint32 vertexCount = data.readUInt32();
+        uint32 indexCount = data.readUInt32();
+
+        // Version 10+ also records the counts in the table, and lazily loaded meshes already trust those
+        if (version >= 10 && (vertexCount != entry.vertexCount || indexCount != entry.indexCount))
         {
-            ////
-            // Material Section
-            ////
-            writeUInt32(data, (uint32) model->getMaterialCount());
-            for (auto& matInfo : model->getMaterials())
+            std::cout << "loadWMDL error: mesh counts don't match the table of contents" << std::endl;
+            throw std::exception();
+        }
+
+        mesh.vertices.resize(vertexCount);
+        if (entry.vertexEncoding == W_MDL_VERTEX_QUANTIZED)
+        {
+            VertexQuantization quantization;
+            data.readPadding(W_MDL_ALIGNMENT);
+            quantization.positionCenter = data.readVec3();
+            quantization.positionExtent = data.readVec3();
+            quantization.texCoordMin = data.readVec2();
+            quantization.texCoordExtent = data.readVec2();
+
+            std::vector<QuantizedVertex> quantized(vertexCount);
+            readVertices(data, vertexCount, sizeof(QuantizedVertex), version, flags, quantized.data());
+            dequantizeVertices(quantized.data(), vertexCount, quantization, mesh.vertices.data());
+        }
+        else if (entry.vertexEncoding == W_MDL_VERTEX_FLOAT)
+        {
+            readVertices(data, vertexCount, sizeof(Vertex), version, flags, mesh.vertices.data());
+        }
+        else
+        {
+            std::cout << "loadWMDL error: unknown vertex encoding " << (uint32) entry.vertexEncoding << std::endl;
+            throw std::exception();
+        }
+
+        readIndices(data, entry.indexEncoding, indexCount, mesh.indices);
+
+        // Version 16+ stores levels of detail after the indices
+        if (version >= 16)
+        {
+            data.readPadding(W_MDL_ALIGNMENT);
+            uint32 lodCount = data.readUInt32();
+
+            // Reading all of the headers at once also makes sure a corrupt count can't make us allocate too much
+            BinaryReader headers(data.readBytes(lodCount, 12), lodCount * (size_t) 12);
+
+            std::vector<uint32> lodIndexCounts(lodCount);
+            std::vector<uint8> lodEncodings(lodCount);
+            mesh.lods.resize(lodCount);
+            for (uint32 level = 0; level < lodCount; ++level)
             {
-                writeString(data, matInfo.name);
-                writeString(data, matInfo.material->getTypeName());
+                mesh.lods[level].error = headers.readFloat();
+                lodIndexCounts[level] = headers.readUInt32();
+                lodEncodings[level] = headers.readUInt8();
+                headers.readBytes(3); // reserved
+            }
 
-                // Textures
-                auto& textures = matInfo.material->getTextures();
-                writeUInt32(data, (uint32) textures.size());
-                for (auto& texEntry : textures)
-                {
-                    writeString(data, texEntry.first);
-                    if (texEntry.second.texture.get() == nullptr)
-                        writeString(data, "");
-                    else
-                        writeString(data, texEntry.second.texture->getPath());
-                }
+            for (uint32 level = 0; level < lodCount; ++level)
+            {
+                readIndices(data, lodEncodings[level], lodIndexCounts[level], mesh.lods[level].indices);
+            }
+        }
+
+        // Version 18+ stores meshlets after the levels of detail
+        if (version >= 18)
+        {
+            data.readPadding(W_MDL_ALIGNMENT);
+            uint32 meshletCount = data.readUInt32();
+            BinaryReader meshlets(data.readBytes(meshletCount, 40), meshletCount * (size_t) 40);
 
-                // Parameters
-                auto& params = matInfo.material->getParameters();
-                writeUInt32(data, (uint32) params.size());
-                for (auto& paramEntry : params)
+            mesh.meshlets.resize(meshletCount);
+            for (auto& meshlet : mesh.meshlets)
+            {
+                meshlet.indexOffset = meshlets.readUInt32();
+                meshlet.indexCount = meshlets.readUInt32();
+                meshlet.center = meshlets.readVec3();
+                meshlet.radius = meshlets.readFloat();
+                meshlet.coneAxis = meshlets.readVec3();
+                meshlet.coneCutoff = meshlets.readFloat();
+
+                if (meshlet.indexOffset > indexCount || meshlet.indexCount > indexCount - meshlet.indexOffset)
                 {
-                    writeString(data, paramEntry.first);
-                    writeUInt8(data, (uint8) paramEntry.second.type);
-                    switch (paramEntry.second.type)
-                    {
-                        default:
-                            std::cout << "Unable to write material " << matInfo.name << ": unknown parameter type " <<
-                            paramEntry.second.type << " for parameter " << paramEntry.first << std::endl;
-                            throw std::exception();
+                    std::cout << "loadWMDL error: meshlet points outside of the mesh's indices" << std::endl;
+                    throw std::exception();
+                }
+            }
+        }
 
-                        case MaterialParameter::Null:
-                            break;
+        return mesh;
+    }
 
-                        case MaterialParameter::Int:
-                            writeInt32(data, paramEntry.second.i);
-                            break;
+    static std::vector<MeshEntry> readMeshEntries(BinaryReader& data, uint32 version)
+    {
+        uint32 meshCount = data.readUInt32();
 
-                        case MaterialParameter::UInt:
-                            writeUInt32(data, paramEntry.second.u);
-                            break;
+        std::vector<MeshEntry> entries(meshCount);
+        for (auto& entry : entries)
+        {
+            entry.materialIndex = data.readInt32();
+            if (version >= 10)
+            {
+                entry.vertexCount = data.readUInt32();
+                entry.indexCount = data.readUInt32();
+            }
+            else
+            {
+                entry.vertexCount = 0;
+                entry.indexCount = 0;
+            }
 
-                        case MaterialParameter::Float:
-                            writeFloat(data, paramEntry.second.f);
-                            break;
+            // Version 12+ stores how the vertices are encoded where the table used to be reserved
+            entry.vertexEncoding = W_MDL_VERTEX_FLOAT;
+            entry.vertexFormat = (uint8) VertexFormat::Float;
+            entry.indexEncoding = W_MDL_INDEX_UINT32;
+            if (version >= 12)
+            {
+                entry.vertexEncoding = data.readUInt8();
+                entry.vertexFormat = data.readUInt8();
 
-                        case MaterialParameter::Vec2:
-                            writeVec2(data, paramEntry.second.v2);
-                            break;
+                // Version 13+ also stores the index encoding
+                uint8 indexEncoding = data.readUInt8();
+                if (version >= 13)
+                    entry.indexEncoding = indexEncoding;
 
-                        case MaterialParameter::Vec3:
-                            writeVec3(data, paramEntry.second.v3);
-                            break;
+                data.readUInt8(); // reserved
+            }
+            else
+            {
+                data.readUInt32(); // reserved
+            }
 
-                        case MaterialParameter::Vec4:
-                            writeVec4(data, paramEntry.second.v4);
-                            break;
+            entry.offset = data.readUInt64();
+            entry.size = data.readUInt64();
 
-                        case MaterialParameter::Mat4:
-                            writeMatrix4(data, paramEntry.second.m4);
-                            break;
-                    }
-                }
+            // Version 17+ also stores the bounds, older meshes are left empty until they are loaded
+            if (version >= 17)
+            {
+                entry.bounds.minimum = data.readVec3();
+                entry.bounds.maximum = data.readVec3();
+                entry.bounds.center = data.readVec3();
+                entry.bounds.radius = data.readFloat();
+                entry.bounds.empty = entry.vertexCount == 0;
             }
 
-            ////
-            // Model Section
-            ////
-
-            writeUInt32(data, (uint32) model->getMeshCount());
-            for (auto& meshInfo : model->getMeshes())
+            if (entry.offset > data.getSize() || entry.size > data.getSize() - entry.offset)
             {
-                writeInt32(data, meshInfo.materialIndex);
+                std::cout << "loadWMDL error: mesh table entry points outside of the payload" << std::endl;
+                throw std::exception();
+            }
+        }
 
-                auto& mesh = meshInfo.mesh;
-                auto& vertices = mesh->getVertices();
-                writeUInt32(data, vertices.size());
-                for (auto& vertex : vertices)
+        return entries;
+    }
+
+    // Builds meshes that are only decoded the first time they are used. Each mesh holds on to the payload until then.
+    static void readLazyMeshTable(BinaryReader& data, ModelPtr model, uint32 version, uint64 flags,
+                                  std::shared_ptr<LazyPayload> payload, const std::string& path)
+    {
+        for (auto& entry : readMeshEntries(data, version))
+        {
+            model->addMesh(MeshPtr(new Mesh(entry.vertexCount, entry.indexCount,
+                                            [payload, entry, version, flags, path](std::vector<Vertex>& vertices,
+                                                                                   std::vector<GLuint>& indices,
+                                                                                   std::vector<MeshLod>& lods,
+                                                                                   std::vector<Meshlet>& meshlets) {
+                try
                 {
-                    writeVec3(data, vertex.position);
-                    writeVec3(data, vertex.normal);
-                    writeVec2(data, vertex.texCoords);
+                    payload->require((size_t) entry.offset, (size_t) (entry.offset + entry.size));
+                    MeshData mesh = decodeMesh(payload->getData() + entry.offset, entry, version, flags);
+                    vertices = std::move(mesh.vertices);
+                    indices = std::move(mesh.indices);
+                    lods = std::move(mesh.lods);
+                    meshlets = std::move(mesh.meshlets);
+                    return true;
                 }
-
-                auto& indices = mesh->getIndices();
-                writeUInt32(data, indices.size());
-                for (GLuint index : indices)
+                catch (std::exception& e)
                 {
-                    writeUInt32(data, index);
+                    std::cout << "loadWMDL error: unable to load mesh data from \"" << path << "\": " << e.what() <<
+                    std::endl;
+                    return false;
                 }
+            }, getVertexFormat(entry), entry.bounds)), entry.materialIndex);
+        }
+    }
+
+    static void readMeshTable(BinaryReader& data, ModelPtr model, uint32 version, uint64 flags)
+    {
+        std::vector<MeshEntry> entries = readMeshEntries(data, version);
+
+        TaskGroup tasks;
+        std::vector<std::future<MeshData>> decoded;
+        decoded.reserve(entries.size());
+
+        // Decode tasks point into the payload, so every task has to finish before we are allowed to throw.
+        bool failed = false;
+        try
+        {
+            for (auto& entry : entries)
+            {
+                // Reading the blob here (rather than in the task) waits for any chunks it lives in to be decompressed
+                data.seek((size_t) entry.offset);
+                const char* blob = data.readBytes((size_t) entry.size);
+
+                decoded.push_back(tasks.submit([blob, entry, version, flags]() {
+                    return decodeMesh(blob, entry, version, flags);
+                }));
             }
         }
         catch (std::exception& e)
         {
-            return false;
+            failed = true;
         }
 
-        std::string dataStr = data.str();
-
-        std::fstream f(path, std::ios::out | std::ios::ate | std::ios::binary);
-        try
+        for (size_t m = 0; m < decoded.size(); ++m)
         {
-            if (!f.is_open())
+            try
             {
-                std::cout << "saveWMDL error: unable to open file \"" << path << "\" for writing." << std::endl;
-                return false;
+                MeshData mesh = tasks.wait(decoded[m]);
+                if (!failed)
+                {
+                    model->addMesh(MeshPtr(new Mesh(std::move(mesh.vertices), std::move(mesh.indices),
+                                                    getVertexFormat(entries[m]), std::move(mesh.lods),
+                                                    std::move(mesh.meshlets))),
+                                   entries[m].materialIndex);
+                }
+            }
+            catch (std::exception& e)
+            {
+                failed = true;
             }
+        }
+
+        if (failed)
+        {
+            std::cout << "loadWMDL error: unable to decode mesh section" << std::endl;
+            throw std::exception();
+        }
+    }
 
-            ////
-            // Header
-            ////
+    static void readMeshSection(BinaryReader& data, ModelPtr model, uint32 version, uint64 flags)
+    {
+        if (version >= 9)
+        {
+            readMeshTable(data, model, version, flags);
+            return;
+        }
 
-            uint64 flags = W_MDL_FLAG_NONE;
-            if (compress)
+        uint32 meshCount = data.readUInt32();
+        for (uint32 m = 0; m < meshCount; ++m)
+        {
+            int32 materialIndex = data.readInt32();
+
+            MeshPtr mesh;
+            if (version >= 7)
             {
-                std::string result;
-                snappy::Compress(dataStr.c_str(), dataStr.length(), &result);
+                // Aligned blobs, these can be handed to the mesh as-is
+                uint32 vertexCount = data.readUInt32();
+                data.readPadding(W_MDL_ALIGNMENT);
+                const Vertex* vertices = (const Vertex*) data.readBytes(vertexCount, sizeof(Vertex));
 
-                f.write(W_MDL_CODE, strlen(W_MDL_CODE));
-                writeUInt32(f, W_MDL_VERSION);
-                flags |= W_MDL_FLAG_COMPRESS;
-                writeUInt64(f, flags);
+                uint32 indexCount = data.readUInt32();
+                data.readPadding(W_MDL_ALIGNMENT);
+                const GLuint* indices = (const GLuint*) data.readBytes(indexCount, sizeof(GLuint));
 
-                f.write(result.c_str(), result.size());
+                mesh = MeshPtr(new Mesh(vertices, vertexCount, indices, indexCount));
             }
             else
             {
-                f.write(W_MDL_CODE, strlen(W_MDL_CODE));
-                writeUInt32(f, W_MDL_VERSION);
-                writeUInt64(f, flags);
+                // Older versions have the same layout but no alignment guarantees, so copy them out
+                uint32 vertexCount = data.readUInt32();
+                std::vector<Vertex> vertices(vertexCount);
+                data.readArray(vertices.data(), vertexCount);
 
-                f.write(dataStr.c_str(), dataStr.length());
-            }
+                uint32 indexCount = data.readUInt32();
+                std::vector<GLuint> indices(indexCount);
+                data.readArray(indices.data(), indexCount);
 
-            if (!f.good())
-            {
-                std::cout << "saveWMDL error: unable to write to output file \"" << path << "\"" << std::endl;
-                return false;
+                mesh = MeshPtr(new Mesh(vertices, indices));
             }
 
-            f.close();
-            return true;
+            model->addMesh(mesh, materialIndex);
+        }
+    }
+
+    bool saveWMDL(const char* path, ModelPtr model, bool compress)
+    {
+        WMDLSaveOptions options;
+        options.compress = compress;
+        return saveWMDL(path, model, options);
+    }
+
+    bool saveWMDL(const char* path, ModelPtr model, const WMDLSaveOptions& options)
+    {
+        uint64 flags = W_MDL_FLAG_NONE;
+        if (options.compress)
+        {
+            flags |= W_MDL_FLAG_COMPRESS | W_MDL_FLAG_CHUNKED;
+            if (options.shuffle)
+                flags |= W_MDL_FLAG_SHUFFLE;
+        }
+
+        // The material section is small, and its size is needed to lay out the mesh section. Embedded textures are
+        // streamed out one at a time, so only their size is worked out here.
+        std::vector<TexturePtr> textures = getEmbeddedTextures(model, options);
+        BinaryWriter materials;
+        size_t payloadSize;
+        std::vector<MeshLayout> layout;
+
+        try
+        {
+            writeMaterialSection(materials, model, textures);
+            size_t materialsEnd = getTextureSectionSize(textures) + materials.getPosition();
+            layout = getMeshLayout(model, options, materialsEnd, payloadSize);
         }
         catch (std::exception& e)
         {
-            if (f.is_open())
+            return false;
+        }
+
+        std::string tempPath = std::string(path) + ".tmp";
+        std::fstream f(tempPath, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!f.is_open())
+        {
+            std::cout << "saveWMDL error: unable to open file \"" << tempPath << "\" for writing." << std::endl;
+            return false;
+        }
+
+        ////
+        // Header
+        ////
+
+        BinaryWriter header;
+        header.writeBytes(W_MDL_CODE, strlen(W_MDL_CODE));
+        header.writeUInt32(W_MDL_VERSION);
+        header.writeUInt64(flags);
+        header.writePadding(W_MDL_ALIGNMENT);
+
+        f.write(header.getBuffer().data(), header.getPosition());
+
+        ////
+        // Payload
+        ////
+
+        bool written = false;
+        try
+        {
+            if (flags & W_MDL_FLAG_COMPRESS)
+            {
+                // Chunk sizes aren't known until the chunks are compressed, so reserve the index and fill it in after
+                size_t chunkCount = std::max((size_t) 1, (payloadSize + W_MDL_CHUNK_SIZE - 1) / W_MDL_CHUNK_SIZE);
+                std::streamoff indexPosition = f.tellp();
+
+                BinaryWriter index;
+                index.writeUInt32((uint32) W_MDL_CHUNK_SIZE);
+                index.writeUInt32((uint32) chunkCount);
+                index.writeUInt64((uint64) payloadSize);
+                index.allocateBytes(chunkCount * sizeof(uint32));
+                f.write(index.getBuffer().data(), index.getPosition());
+
+                ChunkedWriter data(f);
+                writeTextureSection(data, textures);
+                data.writeBytes(materials.getBuffer().data(), materials.getPosition());
+                writeMeshSection(data, model, layout, flags, options);
+
+                const std::vector<uint32>& compressedSizes = data.finish();
+                written = data.getPosition() == payloadSize && compressedSizes.size() == chunkCount;
+
+                f.seekp(indexPosition + (std::streamoff) (sizeof(uint32) * 2 + sizeof(uint64)));
+                f.write((const char*) compressedSizes.data(), compressedSizes.size() * sizeof(uint32));
+            }
+            else
             {
-                f.close();
+                StreamWriter data(f);
+                writeTextureSection(data, textures);
+                data.writeBytes(materials.getBuffer().data(), materials.getPosition());
+                writeMeshSection(data, model, layout, flags, options);
+                data.finish();
+
+                written = data.getPosition() == payloadSize;
             }
 
+            if (!written)
+            {
+                std::cout << "saveWMDL error: payload doesn't match its precomputed layout" << std::endl;
+            }
+        }
+        catch (std::exception& e)
+        {
+            written = false;
+        }
+
+        if (written && !f.good())
+        {
+            std::cout << "saveWMDL error: unable to write to output file \"" << tempPath << "\"" << std::endl;
+            written = false;
+        }
+
+        f.close();
+
+        if (!written)
+        {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+
+        if (!replaceFile(tempPath, path))
+        {
+            std::cout << "saveWMDL error: unable to replace \"" << path << "\"" << std::endl;
+            std::remove(tempPath.c_str());
             return false;
         }
+
+        return true;
     }
 
-    ModelPtr loadWMDL(const char* path)
+    ModelPtr loadWMDL(const char* path, bool lazy)
     {
-        std::fstream f(path, std::ios::in | std::ios::binary);
-        if (!f.is_open())
+        MappedFilePtr file = W_VFS.read(path);
+        if (file.get() == nullptr)
         {
             std::cout << "loadWMDL error: unable to open file \"" << path << "\" for reading." << std::endl;
             return ModelPtr(nullptr);
         }
 
-        char* code = new char[strlen(W_MDL_CODE) + 1];
-        f.read(code, strlen(W_MDL_CODE));
-        code[strlen(W_MDL_CODE)] = '\0';
+        BinaryReader f(file->getData(), file->getSize());
 
-        if (strcmp(code, W_MDL_CODE) != 0)
+        size_t codeLength = strlen(W_MDL_CODE);
+        std::string code(file->getData(), std::min(codeLength, file->getSize()));
+        if (code != W_MDL_CODE)
         {
-            delete[] code;
-            f.close();
             std::cout << "loadWMDL error: bad header, expected " << W_MDL_CODE << ", got " << code << std::endl;
             return ModelPtr(nullptr);
         }
 
-        delete[] code;
+        f.seek(codeLength);
 
         ModelPtr model(new Model());
 
         try
         {
-            uint32 version = readUInt32(f);
+            uint32 version = f.readUInt32();
             if (version < W_MDL_MIN_VERSION)
             {
                 std::cout << "loadWMDL error: version mismatch, version must be at least " << W_MDL_MIN_VERSION <<
                 " but the file is version " << version << std::endl;
-                f.close();
                 return ModelPtr(nullptr);
             }
 
@@ -462,151 +1434,115 @@ namespace wake
             {
                 std::cout << "loadWMDL error: version mismatch, version must be at most " << W_MDL_MAX_VERSION <<
                 " but the file is version " << version << std::endl;
-                f.close();
                 return ModelPtr(nullptr);
             }
 
-            uint64 flags = readUInt64(f);
-            std::string raw((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
-            f.close();
+            uint64 flags = f.readUInt64();
 
-            if (flags & W_MDL_FLAG_COMPRESS)
+            // Version 7+ pads the header so that the payload starts at an aligned offset
+            if (version >= 7)
             {
-                std::string uncompressed;
-                snappy::Uncompress(raw.c_str(), raw.length(), &uncompressed);
-                raw = uncompressed;
+                f.readPadding(W_MDL_ALIGNMENT);
+                if (f.getPosition() != W_MDL_PAYLOAD_OFFSET)
+                {
+                    std::cout << "loadWMDL error: payload starts at " << f.getPosition() << " instead of " <<
+                    W_MDL_PAYLOAD_OFFSET << std::endl;
+                    throw std::exception();
+                }
             }
 
-            std::stringstream data(raw);
-            raw = "";
+            // Lazy loading relies on the counts in the version 10+ mesh table, older files are always loaded in full
+            lazy = lazy && version >= 10;
 
-            // Material Section
-            // Only valid in version 4+
-            if (version >= 4)
+            std::unique_ptr<char[]> uncompressed;
+            std::unique_ptr<BinaryReader> reader;
+            std::shared_ptr<LazyPayload> lazyPayload;
+            if (lazy && (flags & W_MDL_FLAG_COMPRESS) && (flags & W_MDL_FLAG_CHUNKED))
             {
-                uint32 materialCount = readUInt32(data);
-                for (uint32 k = 0; k < materialCount; ++k)
-                {
-                    std::string matName = readString(data);
-                    MaterialPtr mat(new Material());
-
-                    if (version >= 5)
-                    {
-                        std::string matType = readString(data);
-                        mat->setTypeName(matType);
-                    }
-
-                    uint32 textureCount = readUInt32(data);
-                    for (uint32 t = 0; t < textureCount; ++t)
-                    {
-                        TexturePtr texture(nullptr);
-                        std::string textureName = readString(data);
-
-                        if (version >= 6)
-                        {
-                            std::string texturePath = readString(data);
-                            if (texturePath != "")
-                                texture = Texture::load(texturePath.data());
-                        }
-
-                        mat->setTexture(textureName, texture);
-                    }
-
-                    uint32 paramCount = readUInt32(data);
-                    for (uint32 p = 0; p < paramCount; ++p)
-                    {
-                        std::string paramName = readString(data);
-                        uint8 type = readUInt8(data);
-                        switch (type)
-                        {
-                            default:
-                                std::cout << "Unable to read material " << matName << ": unknown parameter type " <<
-                                type << " for parameter " << paramName << std::endl;
-                                throw std::exception();
-
-                            case MaterialParameter::Null:
-                                break;
+                lazyPayload.reset(new LazyPayload(file, readChunkIndex(f)));
+            }
+            else if ((flags & W_MDL_FLAG_COMPRESS) && (flags & W_MDL_FLAG_CHUNKED))
+            {
+                reader = readChunkedPayload(f, file, uncompressed);
+            }
+            else if (flags & W_MDL_FLAG_COMPRESS)
+            {
+                const char* payload = f.getData() + f.getPosition();
+                size_t payloadSize = f.getRemaining();
 
-                            case MaterialParameter::Int:
-                                mat->setParameter(paramName, readInt32(data));
-                                break;
+                size_t uncompressedSize;
+                if (!snappy::GetUncompressedLength(payload, payloadSize, &uncompressedSize))
+                {
+                    std::cout << "loadWMDL error: compressed payload is corrupt" << std::endl;
+                    throw std::exception();
+                }
 
-                            case MaterialParameter::UInt:
-                                mat->setParameter(paramName, readUInt32(data));
-                                break;
+                uncompressed.reset(new char[uncompressedSize]);
+                if (!snappy::RawUncompress(payload, payloadSize, uncompressed.get()))
+                {
+                    std::cout << "loadWMDL error: unable to decompress payload" << std::endl;
+                    throw std::exception();
+                }
 
-                            case MaterialParameter::Float:
-                                mat->setParameter(paramName, readFloat(data));
-                                break;
+                if (lazy)
+                    lazyPayload.reset(new LazyPayload(uncompressed, uncompressedSize));
+                else
+                    reader.reset(new BinaryReader(uncompressed.get(), uncompressedSize));
+            }
+            else if (lazy)
+            {
+                lazyPayload.reset(new LazyPayload(file, f.getData() + f.getPosition(), f.getRemaining()));
+            }
+            else
+            {
+                reader.reset(new BinaryReader(f.getData() + f.getPosition(), f.getRemaining()));
+            }
 
-                            case MaterialParameter::Vec2:
-                                mat->setParameter(paramName, readVec2(data));
-                                break;
+            if (lazyPayload)
+            {
+                reader.reset(new LazyPayloadReader(lazyPayload));
+            }
 
-                            case MaterialParameter::Vec3:
-                                mat->setParameter(paramName, readVec3(data));
-                                break;
+            // Compressed payloads don't point into the file, so let the mapping go away once decompression is done
+            // (chunk tasks that are still running and lazy payloads hold their own reference).
+            if (flags & W_MDL_FLAG_COMPRESS)
+            {
+                file.reset();
+            }
 
-                            case MaterialParameter::Vec4:
-                                mat->setParameter(paramName, readVec4(data));
-                                break;
+            BinaryReader& data = *reader;
 
-                            case MaterialParameter::Mat4:
-                                mat->setParameter(paramName, readMatrix4(data));
-                                break;
-                        }
-                    }
+            // Texture Section
+            // Only valid in version 15+
+            std::vector<TexturePtr> textures;
+            if (version >= 15)
+            {
+                textures = readTextureSection(data);
+            }
 
-                    model->addMaterial(matName, mat);
-                }
+            // Material Section
+            // Only valid in version 4+
+            if (version >= 4)
+            {
+                readMaterialSection(data, model, version, textures);
             }
 
             // Model Section
             // Valid in all versions
-            uint32 meshCount = readUInt32(data);
-            for (uint32 m = 0; m < meshCount; ++m)
-            {
-                int32 materialIndex = readInt32(data);
-
-                std::vector<Vertex> vertices;
-                uint32 vertexCount = readUInt32(data);
-                vertices.reserve(vertexCount);
-                for (uint32 v = 0; v < vertexCount; ++v)
-                {
-                    Vertex vertex;
-                    vertex.position = readVec3(data);
-                    vertex.normal = readVec3(data);
-                    vertex.texCoords = readVec2(data);
-
-                    vertices.push_back(vertex);
-                }
-
-                std::vector<GLuint> indices;
-                uint32 indexCount = readUInt32(data);
-                indices.reserve(indexCount);
-                for (uint32 i = 0; i < indexCount; ++i)
-                {
-                    indices.push_back(readUInt32(data));
-                }
-
-                MeshPtr mesh = MeshPtr(new Mesh(vertices, indices));
-                model->addMesh(mesh, materialIndex);
+            if (lazyPayload)
+                readLazyMeshTable(data, model, version, flags, lazyPayload, path);
+            else
+                readMeshSection(data, model, version, flags);
 
-                ModelMetadata metadata;
-                metadata.source = ModelMetadata::WMDL;
-                metadata.version = version;
-                metadata.path = path;
+            ModelMetadata metadata;
+            metadata.source = ModelMetadata::WMDL;
+            metadata.version = version;
+            metadata.path = path;
 
-                model->setMetadata(metadata);
-            }
+            model->setMetadata(metadata);
         }
         catch (std::exception& e)
         {
-            if (f.is_open())
-            {
-                f.close();
-            }
-
             if (strlen(e.what()) > 0)
             {
                 std::cout << e.what() << std::endl;